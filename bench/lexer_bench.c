@@ -0,0 +1,109 @@
+// lexes a large generated source, or the file given, a few times over on
+// one thread and on one per core, and prints how many tokens a second the
+// lexer gets through. run with make bench.
+#define _POSIX_C_SOURCE 199309L
+
+#include "lexer.h"
+#include "module.h"
+#include "os.h"
+#include "scan.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <iso646.h>
+
+#define BENCH_FNS 200000
+#define BENCH_RUNS 5
+
+// one fn with a bit of everything the lexer tells apart: keywords,
+// identifiers, numbers, strings, comments and operators
+static const char* BENCH_FN =
+    "// fn %zu, doc comment long enough to be worth skipping in bulk\n"
+    "#[inline]\n"
+    "pub fn item_%zu(left: i32, right: *mut u8) -> i32 {\n"
+    "    let total: i32 = left * %zu + 42;\n"
+    "    if total > 1000 and not (total == 7) {\n"
+    "        puts(\"a string literal of middling length %zu\");\n"
+    "    } else {\n"
+    "        loop { total = total - 1; if total < 0 { break; } }\n"
+    "    }\n"
+    "    total as i32\n"
+    "}\n\n";
+
+static char* generate_source(usize fn_count, usize* length) {
+    usize capacity = fn_count * (strlen(BENCH_FN) + 64);
+    char* source = malloc(capacity);
+    usize len = 0;
+    for (usize i = 0; i < fn_count; i += 1) {
+        len += (usize)snprintf(source + len, capacity - len, BENCH_FN, i, i, i, i);
+    }
+
+    *length = len;
+    return source;
+}
+
+static double seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+// the best of a few runs, the others lose time to the rest of the machine
+static void bench(String source, usize thread_count, const char* label) {
+    double best = 0.0;
+    usize token_count = 0;
+    for (usize run = 0; run < BENCH_RUNS; run += 1) {
+        Module module;
+        module_init(&module, str_from_lit("bench.sil"), source);
+
+        double start = seconds();
+        lexer_lex(&module, thread_count);
+        double elapsed = seconds() - start;
+
+        token_count = token_list_len(&module.tokens);
+        if (module.has_errors) {
+            fprintf(stderr, "the source doesn't lex\n");
+            exit(EXIT_FAILURE);
+        }
+        module_deinit(&module);
+
+        if (run == 0 or elapsed < best) { best = elapsed; }
+    }
+
+    printf(
+        "%-12s %10zu tokens in %7.2f ms, %6.1f M tokens/s, %7.1f MB/s\n",
+        label, token_count, best * 1e3, (double)token_count / best * 1e-6, (double)source.len / best * 1e-6
+    );
+}
+
+int main(int argc, char** argv) {
+    scan_init();
+
+    FileView file = {0};
+    char* generated = null;
+    String source;
+    if (argc > 1) {
+        if (not file_open(argv[1], &file)) {
+            fprintf(stderr, "failed to read %s\n", argv[1]);
+            return EXIT_FAILURE;
+        }
+        source = file.contents;
+    } else {
+        usize length;
+        generated = generate_source(BENCH_FNS, &length);
+        source = str_slice(generated, length);
+    }
+
+    printf("lexing %.1f MB, best of %d runs\n", (double)source.len * 1e-6, BENCH_RUNS);
+    bench(source, 1, "1 thread");
+    bench(source, 0, "all cores");
+
+    if (generated != null) {
+        free(generated);
+    } else {
+        file_close(&file);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,112 @@
+// ------------- //
+// C(IR) PRELUDE //
+// ------------- //
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef uint8_t u8;
+typedef int32_t i32;
+typedef int64_t i64;
+typedef char c_char;
+typedef size_t usize;
+typedef ssize_t isize;
+
+// instructions
+static void wri32(i32* a, i32 b) {
+    *a = b;
+}
+
+static i32 addi32(i32 a, i32 b) {
+    return a + b;
+}
+
+static i32 subi32(i32 a, i32 b) {
+    return a - b;
+}
+
+static i32 muli32(i32 a, i32 b) {
+    return a * b;
+}
+
+static i32 divi32(i32 a, i32 b) {
+    return a / b;
+}
+
+static bool eqi32(i32 a, i32 b) {
+    return a == b;
+}
+
+static bool neqi32(i32 a, i32 b) {
+    return a != b;
+}
+
+static bool gti32(i32 a, i32 b) {
+    return a > b;
+}
+
+static bool lti32(i32 a, i32 b) {
+    return a < b;
+}
+
+static bool and(bool a, bool b) {
+    return a && b;
+}
+
+static bool or(bool a, bool b) {
+    return a || b;
+}
+
+
+// ------------ //
+// PROGRAM CODE //
+// ------------ //
+i32 printf(u8 const* const format, i32 const value);
+static i32 fib(i32 const n);
+static i32 forever(i32 const n);
+static i32 ping(i32 const n);
+static i32 pong(i32 const n);
+static i32 square(i32 const n);
+static i32 fib_squared(i32 const n);
+i32 main(void);
+
+
+static i32 fib(i32 const n) {
+    if (lti32(n, 2)) {
+        return n;
+    }
+    return addi32(fib(subi32(n, 1)), fib(subi32(n, 2)));
+}
+
+static i32 forever(i32 const n) {
+    return forever(addi32(n, 1));
+}
+
+static i32 ping(i32 const n) {
+    if (eqi32(n, 0)) {
+        return 0;
+    }
+    return addi32(pong(subi32(n, 1)), 1);
+}
+
+static i32 pong(i32 const n) {
+    return addi32(ping(n), 1);
+}
+
+static i32 square(i32 const n) {
+    return muli32(n, n);
+}
+
+static i32 fib_squared(i32 const n) {
+    return square(fib(n));
+}
+
+i32 main(void) {
+    if (lti32(fib(3), 0)) {
+        forever(0);
+    }
+    printf("%d\n",fib_squared(9));
+    printf("%d\n",ping(4));
+    return square(3);
+}
+
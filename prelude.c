@@ -1,6 +1,7 @@
 // ------------- //
 // C(IR) PRELUDE //
 // ------------- //
+#include <stdbool.h>
 #include <stdint.h>
 #include <sys/types.h>
 
@@ -10,7 +11,6 @@ typedef int64_t i64;
 typedef char c_char;
 typedef size_t usize;
 typedef ssize_t isize;
-typedef _Bool bool;
 
 // instructions
 static void wri32(i32* a, i32 b) {
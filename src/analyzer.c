@@ -1,39 +1,55 @@
 #include "analyzer.h"
 
 #include "ast.h"
+#include "callgraph.h"
+#include "consteval.h"
+#include "parser.h"
 #include "typetable.h"
+#include "threadpool.h"
+#include "util.h"
 #include <chnlib/logger.h>
 #include <chnlib/maybe.h>
 #include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <iso646.h>
 
-static bool analyze_statement(Module*, Stmt*);
-static type_id analyze_expression(Module*, Expr*);
+// waves with fewer fns than this per thread are analyzed on the calling thread
+#define ANALYZER_MIN_CHUNK_FNS 64
+
+static bool analyze_statement(Module*, stmt_id);
+static type_id analyze_expression(Module*, expr_id);
+static type_id lookup_type(Module*, ast_type_id);
+
+static void register_type(Module* module, const char* name, type_id type) {
+    symbol_id symbol = intern_string(&module->names, str_from_lit(name));
+    module_set_type(module, symbol, type);
+}
 
 static void setup_primitive_types(Module* module) {
 
     // void
     module->primitives.entry_void = typetable_new_type(&module->type_table, TypeEntryKind_Void, 0);
-    map_insert(module->types, str_from_lit("void"), &module->primitives.entry_void);
+    register_type(module, "void", module->primitives.entry_void);
 
     // never
     module->primitives.entry_never = typetable_new_type(&module->type_table, TypeEntryKind_Never, 0);
 
     // char
     module->primitives.entry_c_char = typetable_new_int(&module->type_table, 8, false);
-    map_insert(module->types, str_from_lit("c_char"), &module->primitives.entry_c_char);
+    register_type(module, "c_char", module->primitives.entry_c_char);
 
     // bool
     module->primitives.entry_bool = typetable_new_type(&module->type_table, TypeEntryKind_Bool, 8);
-    map_insert(module->types, str_from_lit("bool"), &module->primitives.entry_bool);
+    register_type(module, "bool", module->primitives.entry_bool);
 
     // usize
     module->primitives.entry_usize = typetable_new_size(&module->type_table, false);
-    map_insert(module->types, str_from_lit("usize"), &module->primitives.entry_usize);
+    register_type(module, "usize", module->primitives.entry_usize);
 
     // isize
     module->primitives.entry_isize = typetable_new_size(&module->type_table, true);
-    map_insert(module->types, str_from_lit("isize"), &module->primitives.entry_isize);
+    register_type(module, "isize", module->primitives.entry_isize);
 
     // unsigned int
     module->primitives.entry_u8 = typetable_new_int(&module->type_table, 8, false);
@@ -41,10 +57,10 @@ static void setup_primitive_types(Module* module) {
     module->primitives.entry_u32 = typetable_new_int(&module->type_table, 32, false);
     module->primitives.entry_u64 = typetable_new_int(&module->type_table, 64, false);
 
-    map_insert(module->types, str_from_lit("u8"), &module->primitives.entry_u8);
-    map_insert(module->types, str_from_lit("u16"), &module->primitives.entry_u16);
-    map_insert(module->types, str_from_lit("u32"), &module->primitives.entry_u32);
-    map_insert(module->types, str_from_lit("u64"), &module->primitives.entry_u64);
+    register_type(module, "u8", module->primitives.entry_u8);
+    register_type(module, "u16", module->primitives.entry_u16);
+    register_type(module, "u32", module->primitives.entry_u32);
+    register_type(module, "u64", module->primitives.entry_u64);
 
     // c str
     module->primitives.entry_c_str = typetable_new_ptr(
@@ -59,53 +75,123 @@ static void setup_primitive_types(Module* module) {
     module->primitives.entry_i32 = typetable_new_int(&module->type_table, 32, true);
     module->primitives.entry_i64 = typetable_new_int(&module->type_table, 64, true);
 
-    map_insert(module->types, str_from_lit("i8"), &module->primitives.entry_i8);
-    map_insert(module->types, str_from_lit("i16"), &module->primitives.entry_i16);
-    map_insert(module->types, str_from_lit("i32"), &module->primitives.entry_i32);
-    map_insert(module->types, str_from_lit("i64"), &module->primitives.entry_i64);
+    register_type(module, "i8", module->primitives.entry_i8);
+    register_type(module, "i16", module->primitives.entry_i16);
+    register_type(module, "i32", module->primitives.entry_i32);
+    register_type(module, "i64", module->primitives.entry_i64);
+}
+
+// lines a fn up to be analyzed, once. only done between waves, see
+// analyze_pending, fns being analyzed add to called_fns instead.
+static void queue_fn(Module* module, item_id id) {
+    FnDef* fn_definition = &ast_item(&module->ast, id)->fn_definition;
+    if (fn_definition->queued) { return; }
+
+    fn_definition->queued = true;
+    dynarray_push(module->pending_fns, &id);
 }
 
-static type_id resolve_type(Module* module, Ast_Type* type) {
-    if (type == null) { return 0; }
+static type_id resolve_type(Module* module, ast_type_id type_node) {
+    if (type_node == 0) { return 0; }
+    Ast_Type* type = ast_type(&module->ast, type_node);
     switch (type->kind) {
         case TypeKind_Void: return module->primitives.entry_void;
         case TypeKind_Never: return module->primitives.entry_never;
 
         case TypeKind_Symbol: {
-            Maybe(type_id) entry = map_get(module->types, type->symbol);
-            if (entry == None) {
+            type_id entry = module_get_type(module, type->symbol);
+            if (entry == 0) {
                 sil_panic("Codegen Error: unhandled type");
             }
-            return unwrap(entry);
+            return entry;
         }
 
         case TypeKind_Ptr: {
             type_id child = resolve_type(module, type->ptr.to);
-            TypeEntry* child_entry = &module->type_table.types[child];
-            type_id existing = type->ptr.is_mut ? child_entry->parent_ptr_mut : child_entry->parent_ptr;
-            if (existing != 0) {
-                return existing;
-            }
+            return typetable_new_ptr(&module->type_table, child, type->ptr.is_mut);
+        }
 
-            type_id new = typetable_new_ptr(&module->type_table, child, type->ptr.is_mut);
-            return new;
+        case TypeKind_Fn: {
+            type_id entry = lookup_type(module, type_node);
+            if (entry == 0) {
+                sil_panic("Codegen Error: unhandled type");
+            }
+            return entry;
         }
 
         default: sil_panic("cannot resolve type %d", type->kind);
     }
 }
 
-static type_id analyze_bin_op(Module* module, BinOp* bin_op) {
-    switch (bin_op->kind) {
-        case BinOpKind_Assign: return module->primitives.entry_void;
+// the parameter types are gathered in the arena, params holds count
+// ast_type_ids spaced stride words apart
+static type_id lookup_fn_type(Module* module, u32* params, usize count, usize stride, ast_type_id returns) {
+    ArenaMark mark = arena_mark(&module->arena);
+    type_id* parameters = arena_alloc(&module->arena, sizeof(type_id) * count);
+
+    type_id type = lookup_type(module, returns);
+    for (usize i = 0; i < count and type != 0; i += 1) {
+        parameters[i] = lookup_type(module, params[i * stride]);
+        if (parameters[i] == 0) { type = 0; }
+    }
+    if (type != 0) {
+        type = typetable_new_fn(&module->type_table, parameters, count, type);
+    }
+
+    arena_release(&module->arena, mark);
+    return type;
+}
+
+// resolve_type without the panics, 0 when a name in it isn't a type
+static type_id lookup_type(Module* module, ast_type_id type_node) {
+    Ast_Type* type = ast_type(&module->ast, type_node);
+    switch (type->kind) {
+        case TypeKind_Void: return module->primitives.entry_void;
+        case TypeKind_Never: return module->primitives.entry_never;
+        case TypeKind_Symbol: return module_get_type(module, type->symbol);
+        case TypeKind_Ptr: {
+            type_id child = lookup_type(module, type->ptr.to);
+            if (child == 0) { return 0; }
+            return typetable_new_ptr(&module->type_table, child, type->ptr.is_mut);
+        }
+        case TypeKind_Fn: {
+            u32* parameters = ast_list(&module->ast, type->fn.parameters, u32);
+            return lookup_fn_type(module, parameters, type->fn.parameters.len, 1, type->fn.return_type);
+        }
+        default: return 0;
+    }
+}
+
+// the type a fn has when it's used as a value, 0 when a name in its
+// signature isn't a type
+static type_id lookup_signature_type(Module* module, FnSig* signature) {
+    u32* parameters = &ast_list(&module->ast, signature->parameters, FnParam)->type;
+    usize stride = sizeof(FnParam) / sizeof(u32);
+    return lookup_fn_type(module, parameters, signature->parameters.len, stride, signature->return_type);
+}
+
+static FnSig* signature_of(Item* item) {
+    return item->kind == ItemKind_FnDef ? &item->fn_definition.signature : &item->extern_fn.signature;
+}
+
+// pointers and fns are the only types resolve_type adds to the type table.
+// the ones spelled out in the ast from first on are added up front, so
+// analyzing fns on other threads only has to look types up.
+static void intern_compound_types(Module* module, ast_type_id first) {
+    for (ast_type_id id = first; id < module->ast.len.types; id += 1) {
+        Ast_TypeKind kind = ast_type(&module->ast, id)->kind;
+        if (kind == TypeKind_Ptr or kind == TypeKind_Fn) {
+            lookup_type(module, id);
+        }
+    }
+}
 
+static type_id bin_op_type(Module* module, BinOpKind kind, type_id left_type, type_id right_type) {
+    switch (kind) {
         case BinOpKind_Add:
         case BinOpKind_Sub:
         case BinOpKind_Mul:
         case BinOpKind_Div: {
-	    type_id left_type = analyze_expression(module, bin_op->left);
-	    type_id right_type = analyze_expression(module, bin_op->right);
-
             if (left_type != right_type) {
                 sil_panic("binop: incompatable types");
             }
@@ -115,11 +201,8 @@ static type_id analyze_bin_op(Module* module, BinOp* bin_op) {
 
         case BinOpKind_And:
         case BinOpKind_Or: {
-            type_id left_type = analyze_expression(module, bin_op->left);
-            type_id right_type = analyze_expression(module, bin_op->right);
-
-            TypeEntry* left_type_entry = &module->type_table.types[left_type];
-            TypeEntry* right_type_entry = &module->type_table.types[right_type];
+            TypeEntry* left_type_entry = typetable_get(&module->type_table, left_type);
+            TypeEntry* right_type_entry = typetable_get(&module->type_table, right_type);
     
             if (left_type_entry->kind != TypeEntryKind_Bool or right_type_entry->kind != TypeEntryKind_Bool) {
                 sil_panic("and/or can only compare boolean expressions");
@@ -132,9 +215,6 @@ static type_id analyze_bin_op(Module* module, BinOp* bin_op) {
         case BinOpKind_CmpLt:
         case BinOpKind_CmpEq:
         case BinOpKind_CmpNotEq: {
-	    type_id left_type = analyze_expression(module, bin_op->left);
-	    type_id right_type = analyze_expression(module, bin_op->right);
-
             if (left_type != right_type) {
                 sil_panic("binop: incomparable types");
             }
@@ -145,37 +225,148 @@ static type_id analyze_bin_op(Module* module, BinOp* bin_op) {
     }
 }
 
-static type_id analyze_expression(Module* module, Expr* expression) {
+// left-deep chains (a + b + c ...) are walked down to their first operand
+// and analyzed on the way back up, only the right operands recurse
+static type_id analyze_bin_op(Module* module, expr_id expression_id) {
+    Ast* ast = &module->ast;
+
+    ExprStack chain;
+    expr_stack_init(&chain);
+
+    expr_id left = expression_id;
+    while (ast_expr(ast, left)->kind == ExprKind_BinOp and ast_expr(ast, left)->binary_operator.kind != BinOpKind_Assign) {
+        expr_stack_push(&chain, left);
+        left = ast_expr(ast, left)->binary_operator.left;
+    }
+
+    type_id left_type = analyze_expression(module, left);
+    while (chain.len > 0) {
+        expr_id id = expr_stack_pop(&chain);
+        type_id right_type = analyze_expression(module, ast_expr(ast, id)->binary_operator.right);
+
+        Expr* expression = ast_expr(ast, id);
+        expression->codegen.type = bin_op_type(module, expression->binary_operator.kind, left_type, right_type);
+        left_type = expression->codegen.type;
+    }
+
+    expr_stack_deinit(&chain);
+    return left_type;
+}
+
+// else if ladders are walked in a loop. every if has the type of its then
+// branch, which has to match the type of the if (or block) it has as else.
+static type_id analyze_if(Module* module, expr_id expression_id) {
+    Ast* ast = &module->ast;
+
+    ExprStack ladder;
+    expr_stack_init(&ladder);
+
+    expr_id current = expression_id;
+    type_id otherwise_type = 0;
+    while (true) {
+        type_id condition_type = analyze_expression(module, ast_expr(ast, current)->if_expr.condition);
+        TypeEntry* condition_type_entry = typetable_get(&module->type_table, condition_type);
+        if (condition_type_entry->kind != TypeEntryKind_Bool) {
+            sil_panic("if condition must be a bool");
+        }
+
+        ast_expr(ast, current)->codegen.type = analyze_expression(module, ast_expr(ast, current)->if_expr.then);
+        expr_stack_push(&ladder, current);
+
+        expr_id otherwise = ast_expr(ast, current)->if_expr.otherwise;
+        if (otherwise == 0) { break; }
+        if (ast_expr(ast, otherwise)->kind == ExprKind_If) {
+            current = otherwise;
+            continue;
+        }
+
+        otherwise_type = analyze_expression(module, otherwise);
+        break;
+    }
+
+    // the innermost if is checked first
+    bool has_otherwise = ast_expr(ast, current)->if_expr.otherwise != 0;
+    while (ladder.len > 0) {
+        type_id eval_type = ast_expr(ast, expr_stack_pop(&ladder))->codegen.type;
+        if (has_otherwise and otherwise_type != eval_type) {
+            sil_panic("branches must return the same type");
+        }
+
+        has_otherwise = true;
+        otherwise_type = eval_type;
+    }
+
+    expr_stack_deinit(&ladder);
+    return otherwise_type;
+}
+
+// calls through constants are lined up to be made direct, see
+// devirtualize_calls
+static type_id analyze_indirect_call(Module* module, expr_id expression_id, SymEntry holder) {
+    Ast* ast = &module->ast;
+    Expr* expression = ast_expr(ast, expression_id);
+    expression->kind = ExprKind_IndirectCall;
+    if (holder.expression != 0) {
+        dynarray_push(module->const_calls, &expression_id);
+    }
+
+    TypeFn fn_type = typetable_get(&module->type_table, holder.type)->fn;
+    FnCall* fn_call = &expression->fn_call;
+    expr_id* arguments = ast_list(ast, fn_call->arguments, expr_id);
+
+    type_id parameter = fn_type.parameters;
+    for (usize i = 0; i < fn_call->arguments.len; i += 1) {
+        type_id arg_type = analyze_expression(module, arguments[i]);
+        if (parameter == 0) {
+            sil_panic("function call with invalid arguments");
+        }
+
+        TypeFnParam param = typetable_get(&module->type_table, parameter)->fn_param;
+        if (arg_type != param.type) {
+            sil_panic("function call with invalid arguments");
+        }
+        parameter = param.next;
+    }
+    if (parameter != 0) {
+        sil_panic("function call with invalid arguments");
+    }
+
+    return fn_type.returns;
+}
+
+static type_id analyze_expression(Module* module, expr_id expression_id) {
+    Ast* ast = &module->ast;
+    Expr* expression = ast_expr(ast, expression_id);
     switch (expression->kind) {
         case ExprKind_Block: {
 	    symtable_enter_scope(&module->symbol_table);
-	    Block* block = expression->block;
-	    block->scope = module->symbol_table.current_scope;
+	    Block* block = &expression->block;
+	    stmt_id* statements = ast_list(ast, block->statements, stmt_id);
 
-	    for (size_t i = 0; i < dynarray_len(block->statements); i++) {
-		Stmt* statement = block->statements[i];
-		analyze_statement(module, statement);
+	    for (size_t i = 0; i < block->statements.len; i++) {
+		analyze_statement(module, statements[i]);
 	    }
 
 	    symtable_exit_scope(&module->symbol_table);
 
-            Stmt* last_stmt = block->statements[dynarray_len(block->statements) - 1];
+            Stmt* last_stmt = ast_stmt(ast, statements[block->statements.len - 1]);
+            Expr* last_expression = ast_expr(ast, last_stmt->expression);
 
             type_id ret_type = module->primitives.entry_void;
             if (last_stmt->kind == StmtKind_NakedExpr or
-                (last_stmt->kind == StmtKind_Expr and should_remove_statement_semi(last_stmt->expression))
+                (last_stmt->kind == StmtKind_Expr and should_remove_statement_semi(last_expression))
             ) {
-                ret_type = last_stmt->expression->codegen.type;
+                ret_type = last_expression->codegen.type;
             }
 
             expression->codegen.type = ret_type;
             break;
 	}
 	case ExprKind_Let: {
-	    Let* let = expression->let;
+	    Let* let = &expression->let;
 	    SymEntry* existing = symtable_get_local(&module->symbol_table, let->name);
 	    if (existing != null) {
-		sil_panic("Redeclaration of variable %.*s", str_format(let->name));
+		sil_panic("Redeclaration of variable %.*s", str_format(intern_get(&module->names, let->name)));
 	    }
 
             type_id explicit_type = resolve_type(module, let->type);
@@ -185,48 +376,90 @@ static type_id analyze_expression(Module* module, Expr* expression) {
 
 	    if (explicit_type != 0 and explicit_type != implicit_type) {
 		sil_panic(
-                    "Sem Analysis Error: Implicit type conversion not allowed %zu %zu",
+                    "Sem Analysis Error: Implicit type conversion not allowed %u %u",
                     explicit_type,
                     implicit_type
                 );
 	    }
 
-            SymEntry entry;
-            entry.type = implicit_type;
+            SymEntry entry = { .type = implicit_type };
 	    symtable_insert(&module->symbol_table, let->name, &entry);
 
             expression->codegen.type = implicit_type;
             break;
 	}
         case ExprKind_Symbol: {
-	    String symbol = expression->symbol;
+	    symbol_id symbol = expression->symbol;
 	    SymEntry* existing = symtable_get(&module->symbol_table, symbol);
-	    if (existing == null) {
-		sil_panic("Use of undeclared variable %.*s", str_format(symbol));
+	    if (existing != null) {
+                expression->codegen.type = existing->type;
+                break;
 	    }
 
-            expression->codegen.type = existing->type;
+            // a fn used as a value, its type was added with the items
+            item_id item = module_get_item(module, symbol);
+            if (item == 0 or ast_item(ast, item)->kind == ItemKind_Const) {
+		sil_panic("Use of undeclared variable %.*s", str_format(intern_get(&module->names, symbol)));
+            }
+
+            expression->codegen.type = lookup_signature_type(module, signature_of(ast_item(ast, item)));
+            if (expression->codegen.type == 0) {
+                sil_panic("Codegen Error: unhandled type");
+            }
+
+            if (ast_item(ast, item)->kind == ItemKind_FnDef) {
+                if (not ast_item(ast, item)->fn_definition.queued) {
+                    dynarray_push(module->called_fns, &item);
+                }
+                dynarray_push(module->taken_fns, &item);
+            }
             break;
 	}
         case ExprKind_BinOp: { 
-            expression->codegen.type = analyze_bin_op(module, expression->binary_operator);
+            // assignments aren't type checked yet, but the constant
+            // evaluator needs the types of their operands
+            if (expression->binary_operator.kind == BinOpKind_Assign) {
+                analyze_expression(module, expression->binary_operator.left);
+                analyze_expression(module, expression->binary_operator.right);
+                ast_expr(ast, expression_id)->codegen.type = module->primitives.entry_void;
+                break;
+            }
+
+            type_id type = analyze_bin_op(module, expression_id);
+            ast_expr(ast, expression_id)->codegen.type = type;
             break;
         }
-        case ExprKind_FnCall: {
-	    FnCall* fn_call = expression->fn_call;
+        case ExprKind_FnCall:
+        case ExprKind_IndirectCall: {
+	    FnCall* fn_call = &expression->fn_call;
+
+            // a local, parameter or constant holding a fn hides the fn of
+            // the same name
+            SymEntry* holder = symtable_get(&module->symbol_table, fn_call->name);
+            if (holder != null and typetable_get(&module->type_table, holder->type)->kind == TypeEntryKind_Fn) {
+                expression->codegen.type = analyze_indirect_call(module, expression_id, *holder);
+                break;
+            }
+            expression->kind = ExprKind_FnCall;
 
-	    Maybe(Item*) item = map_get(module->items, fn_call->name);
-            if (item == None) {
-                sil_panic("Call to undeclared function %.*s", str_format(fn_call->name));
+	    item_id item = module_get_item(module, fn_call->name);
+            if (item == 0) {
+                sil_panic("Call to undeclared function %.*s", str_format(intern_get(&module->names, fn_call->name)));
             }
 
-	    FnDef* fn_definition = unwrap(item)->fn_definition;
+	    if (ast_item(ast, item)->kind == ItemKind_FnDef and not ast_item(ast, item)->fn_definition.queued) {
+	        dynarray_push(module->called_fns, &item);
+	    }
+
+	    FnSig* signature = &ast_item(ast, item)->fn_definition.signature;
+	    expr_id* arguments = ast_list(ast, fn_call->arguments, expr_id);
+	    FnParam* parameters = ast_list(ast, signature->parameters, FnParam);
 
             // analyze arguments
-	    for (size_t i = 0; i < dynarray_len(fn_call->arguments); i += 1) {
-	        type_id arg_type = analyze_expression(module, fn_call->arguments[i]);
+	    for (size_t i = 0; i < fn_call->arguments.len; i += 1) {
+	        type_id arg_type = analyze_expression(module, arguments[i]);
 
-                FnParam* param = fn_definition->signature->parameters[i];
+                FnParam* param = &parameters[i];
                 type_id param_type = resolve_type(module, param->type);
 
                 if (arg_type != param_type) {
@@ -234,32 +467,16 @@ static type_id analyze_expression(Module* module, Expr* expression) {
                 }
 	    }
 
-            expression->codegen.type = resolve_type(module, fn_definition->signature->return_type);
+            expression->codegen.type = resolve_type(module, signature->return_type);
             break;
 	}
         case ExprKind_If: {
-            If* if_expr = expression->if_expr;
-
-            type_id condition_type = analyze_expression(module, if_expr->condition);
-            TypeEntry* condition_type_entry = &module->type_table.types[condition_type];
-            if (condition_type_entry->kind != TypeEntryKind_Bool) {
-                sil_panic("if condition must be a bool");
-            }
-
-            type_id eval_type = analyze_expression(module, if_expr->then);
-
-            if (if_expr->otherwise != null) {
-                type_id otherwise_type = analyze_expression(module, if_expr->otherwise);
-                if (otherwise_type != eval_type) {
-                    sil_panic("branches must return the same type");
-                }
-            }
-
-            expression->codegen.type = eval_type;
+            type_id type = analyze_if(module, expression_id);
+            ast_expr(ast, expression_id)->codegen.type = type;
             break;
         }
         case ExprKind_Loop: {
-            analyze_expression(module, expression->loop->body);
+            analyze_expression(module, expression->loop.body);
             expression->codegen.type = module->primitives.entry_void;
             break;
         }
@@ -294,8 +511,8 @@ static type_id analyze_expression(Module* module, Expr* expression) {
         }
         case ExprKind_Cast: {
             // TODO: actual make sure cast is legit
-            analyze_expression(module, expression->cast->expr);
-            expression->codegen.type = resolve_type(module, expression->cast->to);
+            analyze_expression(module, expression->cast.expr);
+            expression->codegen.type = resolve_type(module, expression->cast.to);
             break;
         }
         default: sil_panic("Analyzer Error: unhandled expression %d", expression->kind);
@@ -304,7 +521,8 @@ static type_id analyze_expression(Module* module, Expr* expression) {
     return expression->codegen.type;
 }
 
-static bool analyze_statement(Module* module, Stmt* statement) {
+static bool analyze_statement(Module* module, stmt_id statement_id) {
+    Stmt* statement = ast_stmt(&module->ast, statement_id);
     switch (statement->kind) {
         case StmtKind_NakedExpr:
         case StmtKind_Expr: analyze_expression(module, statement->expression); break;
@@ -314,32 +532,40 @@ static bool analyze_statement(Module* module, Stmt* statement) {
     return true;
 }
 
-static bool analyze_fn_definition(Module* module, FnDef* fn_definition) {
+static bool analyze_fn_definition(Module* module, item_id id) {
+    Ast* ast = &module->ast;
+
+    // the body is parsed by the caller, it's missing when that failed
+    FnDef* fn_definition = &ast_item(ast, id)->fn_definition;
+    if (fn_definition->body == 0) { return false; }
+
     symtable_enter_scope(&module->symbol_table);
 
     // add paramaters to symtable
-    for (size_t i = 0; i < dynarray_len(fn_definition->signature->parameters); i += 1) {
-        FnParam* param = fn_definition->signature->parameters[i];
+    FnParam* parameters = ast_list(ast, fn_definition->signature.parameters, FnParam);
+    for (size_t i = 0; i < fn_definition->signature.parameters.len; i += 1) {
+        FnParam* param = &parameters[i];
         type_id param_type = resolve_type(module, param->type);
         SymEntry entry = (SymEntry){
             .type = param_type,
-            .expression = null,
+            .expression = 0,
         };
         symtable_insert(&module->symbol_table, param->name, &entry);
     }
 
-    Expr* block = fn_definition->body;
-    analyze_expression(module, block);
+    analyze_expression(module, fn_definition->body);
 
-    Stmt* last_stmt = block->block->statements[dynarray_len(block->block->statements) - 1];
+    Block* block = &ast_expr(ast, fn_definition->body)->block;
+    Stmt* last_stmt = ast_stmt(ast, ast_list(ast, block->statements, stmt_id)[block->statements.len - 1]);
+    Expr* last_expression = ast_expr(ast, last_stmt->expression);
 
     if (last_stmt->kind != StmtKind_NakedExpr and last_stmt->kind != StmtKind_Expr) {
         chn_error("last statement in a block must be an expression",);
     }
-    if (last_stmt->expression->codegen.type != resolve_type(module, fn_definition->signature->return_type)) {
-        type_id last = last_stmt->expression->codegen.type;
-        type_id sig = resolve_type(module, fn_definition->signature->return_type);
-        sil_panic("return value doesn't match signature %zu %zu %.*s", last, sig, str_format(fn_definition->signature->return_type->symbol));
+    if (last_expression->codegen.type != resolve_type(module, fn_definition->signature.return_type)) {
+        type_id last = last_expression->codegen.type;
+        type_id sig = resolve_type(module, fn_definition->signature.return_type);
+        sil_panic("return value doesn't match signature %u %u", last, sig);
     }
 
     symtable_exit_scope(&module->symbol_table);
@@ -347,23 +573,36 @@ static bool analyze_fn_definition(Module* module, FnDef* fn_definition) {
     return true;
 }
 
-static bool analyze_ast(Module* module, AstRoot* root) {
-    for (size_t i = 0; i < dynarray_len(root->items); i += 1) {
+static void register_items(Module* module, Ast* ast) {
+    for (item_id id = 1; id <= ast_item_count(ast); id += 1) {
 	// add item to top level
-	Item* item = root->items[i];
+	Item* item = ast_item(ast, id);
         switch (item->kind) {
             case ItemKind_ExternFn: // make these part of an import table
-            case ItemKind_FnDef:
-                map_insert(module->items, item->name, &item); break;
+                module_set_item(module, item->name, id);
+                lookup_signature_type(module, &item->extern_fn.signature);
+                break;
+            case ItemKind_FnDef: {
+                module_set_item(module, item->name, id);
+                // the type the fn has as a value, bodies on other threads
+                // can only look it up
+                lookup_signature_type(module, &item->fn_definition.signature);
+
+                // fns whose bodies weren't parsed are left until something calls them
+                if (item->fn_definition.body != 0 or callgraph_is_root(module, item)) {
+                    queue_fn(module, id);
+                }
+                break;
+            }
             case ItemKind_Const: {
-                type_id explicit_type = resolve_type(module, item->constant->type);
-                type_id implicit_type = analyze_expression(module, item->constant->value);
+                type_id explicit_type = resolve_type(module, item->constant.type);
+                type_id implicit_type = analyze_expression(module, item->constant.value);
                 if (explicit_type != 0 and explicit_type != implicit_type) {
                     sil_panic("constant type doesn't match expression");
                 }
                 SymEntry entry = {
                     .type = implicit_type,
-                    .expression = item->constant->value,
+                    .expression = item->constant.value,
                 };
                 symtable_insert(&module->symbol_table, item->name, &entry);
                 break;
@@ -372,21 +611,256 @@ static bool analyze_ast(Module* module, AstRoot* root) {
                 sil_panic("Analyzer Error: unhandled top level item");
         }
     }
+}
 
-    for (size_t i = 0; i < dynarray_len(root->items); i += 1) {
-	Item* item = root->items[i];
-        switch (item->kind) {
-            case ItemKind_FnDef: analyze_fn_definition(module, item->fn_definition); break;
-            default: break;
+// lines up the fns other called, in the order they were found, and moves
+// over the calls through constants
+static void take_calls(Module* module, Module* other) {
+    for (usize i = 0; i < dynarray_len(other->called_fns); i += 1) {
+        queue_fn(module, other->called_fns[i]);
+    }
+    dynarray_deinit(other->called_fns);
+    other->called_fns = dynarray_init();
+
+    for (usize i = 0; i < dynarray_len(other->taken_fns); i += 1) {
+        ast_item(&module->ast, other->taken_fns[i])->fn_definition.address_taken = true;
+    }
+    dynarray_deinit(other->taken_fns);
+    other->taken_fns = dynarray_init();
+
+    if (other != module) {
+        for (usize i = 0; i < dynarray_len(other->const_calls); i += 1) {
+            dynarray_push(module->const_calls, &other->const_calls[i]);
         }
+        dynarray_deinit(other->const_calls);
+        other->const_calls = dynarray_init();
+    }
+}
+
+// calls through a constant become direct calls to the fn it holds, which
+// gcc can inline. the constants have to be evaluated, and no scope open.
+// the ones that couldn't be are called through at runtime.
+static void devirtualize_calls(Module* module) {
+    Ast* ast = &module->ast;
+    for (usize i = 0; i < dynarray_len(module->const_calls); i += 1) {
+        Expr* expression = ast_expr(ast, module->const_calls[i]);
+        SymEntry* constant = symtable_get(&module->symbol_table, expression->fn_call.name);
+        ConstValue* value = consteval_get(module, constant->value);
+        if (value->kind != ConstValueKind_Fn) { continue; }
+
+        expression->kind = ExprKind_FnCall;
+        expression->fn_call.name = ast_item(ast, value->fn)->name;
     }
+    dynarray_deinit(module->const_calls);
+    module->const_calls = dynarray_init();
+}
 
-    return true;
+static void analyze_fns(Module* module, item_id* fns, usize count) {
+    for (usize i = 0; i < count; i += 1) {
+        analyze_fn_definition(module, fns[i]);
+    }
+}
+
+
+// ----------------- //
+// Parallel Analysis //
+// ----------------- //
+typedef struct AnalyzerChunk {
+    item_id* fns;
+    usize count;
+
+    // a copy of the module with scopes, errors and called fns of its own.
+    // every fn only writes the types of its own nodes, the rest of the ast
+    // and the (frozen) type table are only read.
+    Module module;
+    PanicCatch catch;
+} AnalyzerChunk;
+
+static void analyze_chunk(void* data, usize index) {
+    AnalyzerChunk* chunk = &((AnalyzerChunk*)data)[index];
+
+    // a panic drops the rest of the chunk, it's reported once all are done
+    if (setjmp(chunk->catch.jump) != 0) { return; }
+    sil_catch_panics(&chunk->catch);
+
+    analyze_fns(&chunk->module, chunk->fns, chunk->count);
+
+    sil_catch_panics(null);
+}
+
+// the fns are split into contiguous chunks, one per thread at most. the
+// chunks are then gone through in order: the first one that panicked has the
+// panic a sequential run would have stopped at, it's reported the same way.
+static void analyze_parallel(Module* module, item_id* fns, usize count, usize thread_count, usize chunk_count) {
+    AnalyzerChunk* chunks = malloc(sizeof(AnalyzerChunk) * chunk_count);
+    SymTable* root = &module->symbol_table;
+
+    for (usize i = 0; i < chunk_count; i += 1) {
+        AnalyzerChunk* chunk = &chunks[i];
+        usize start = count * i / chunk_count;
+        chunk->fns = &fns[start];
+        chunk->count = count * (i + 1) / chunk_count - start;
+        chunk->catch.message = null;
+
+        chunk->module = *module;
+        arena_init(&chunk->module.arena);
+        chunk->module.errors = dynarray_init();
+        chunk->module.has_errors = false;
+        chunk->module.called_fns = dynarray_init();
+        chunk->module.taken_fns = dynarray_init();
+        chunk->module.const_calls = dynarray_init();
+        chunk->module.type_table.frozen = true;
+
+        // every scope starts out with the constants
+        symtable_init(&chunk->module.symbol_table);
+        for (u32 j = 0; j < root->binding_count; j += 1) {
+            symtable_insert(&chunk->module.symbol_table, root->bindings[j].name, &root->bindings[j].entry);
+        }
+    }
+
+    threadpool_run(thread_count, chunk_count, analyze_chunk, chunks);
+
+    for (usize i = 0; i < chunk_count; i += 1) {
+        AnalyzerChunk* chunk = &chunks[i];
+        if (chunk->catch.message != null) {
+            fprintf(stderr, "%s\n", chunk->catch.message);
+            exit(EXIT_FAILURE);
+        }
+
+        module_take_errors(module, &chunk->module);
+        take_calls(module, &chunk->module);
+    }
+
+    for (usize i = 0; i < chunk_count; i += 1) {
+        dynarray_deinit(chunks[i].module.errors);
+        dynarray_deinit(chunks[i].module.called_fns);
+        dynarray_deinit(chunks[i].module.taken_fns);
+        dynarray_deinit(chunks[i].module.const_calls);
+        symtable_deinit(&chunks[i].module.symbol_table);
+        arena_deinit(&chunks[i].module.arena);
+    }
+    free(chunks);
 }
 
+// fns are analyzed in waves: the ones lined up so far, then the ones those
+// call and so on. a wave's bodies are parsed before any of it is analyzed,
+// so it can be analyzed on the thread pool. the fns come out in the same
+// order a fn by fn run would line them up in.
+static void analyze_pending(Module* module, usize thread_count) {
+    // calls from constants
+    take_calls(module, module);
+
+    ast_type_id interned = 1;
+    usize start = 0;
+    while (start < dynarray_len(module->pending_fns)) {
+        usize end = dynarray_len(module->pending_fns);
+
+        // lazily parsed bodies are parsed the first time they're needed
+        for (usize i = start; i < end; i += 1) {
+            parser_parse_body(module, module->pending_fns[i]);
+        }
+        intern_compound_types(module, interned);
+        interned = module->ast.len.types;
+
+        usize count = end - start;
+        usize chunk_count = count / ANALYZER_MIN_CHUNK_FNS;
+        if (chunk_count > thread_count) { chunk_count = thread_count; }
+
+        if (chunk_count > 1) {
+            analyze_parallel(module, &module->pending_fns[start], count, thread_count, chunk_count);
+        } else {
+            analyze_fns(module, &module->pending_fns[start], count);
+            take_calls(module, module);
+        }
+
+        start = end;
+    }
+}
+
+
+void analyzer_analyze(Module* module, usize thread_count) {
+    if (thread_count == 0) {
+        thread_count = threadpool_default_count();
+    }
 
-void analyzer_analyze(Module* module) {
     setup_primitive_types(module);
+    register_items(module, &module->ast);
+    analyze_pending(module, thread_count);
+
+    // fns constants call might not have parsed
+    if (not module->has_errors) {
+        consteval_constants(module, null);
+        devirtualize_calls(module);
+    }
+}
+
+static int compare_item_ids(const void* a, const void* b) {
+    item_id left = *(const item_id*)a;
+    item_id right = *(const item_id*)b;
+    return (left > right) - (left < right);
+}
+
+// no body is parsed yet. the bodies of the fns the constants call are
+// parsed and analyzed as the evaluation runs into them, a round at a time,
+// each round from a stream of its own since the source is only read
+// forward. they're kept for the caller.
+static void evaluate_streamed_constants(Module* module) {
+    DynArray(item_id) unparsed = dynarray_init();
+    while (true) {
+        consteval_constants(module, &unparsed);
+        usize count = dynarray_len(unparsed);
+        if (count == 0 or module->has_errors) { break; }
+
+        qsort(unparsed, count, sizeof(item_id), compare_item_ids);
+        usize unique = 0;
+        for (usize i = 0; i < count; i += 1) {
+            if (unique == 0 or unparsed[unique - 1] != unparsed[i]) {
+                unparsed[unique++] = unparsed[i];
+            }
+        }
+
+        TokenStream tokens;
+        token_stream_init(&tokens, module);
+        for (usize i = 0; i < unique; i += 1) {
+            parser_parse_body_from(module, &tokens, unparsed[i]);
+        }
+        token_stream_report_errors(&tokens);
+        token_stream_deinit(&tokens);
+        analyze_fns(module, unparsed, unique);
+        take_calls(module, module);
+
+        // the constants that ran into them are evaluated again
+        dynarray_deinit(unparsed);
+        unparsed = dynarray_init();
+        SymTable* symbol_table = &module->symbol_table;
+        for (usize i = 0; i < symbol_table->binding_count; i += 1) {
+            SymEntry* entry = &symbol_table->bindings[i].entry;
+            if (consteval_get(module, entry->value)->kind == ConstValueKind_Void) { entry->value = 0; }
+        }
+    }
+    dynarray_deinit(unparsed);
+}
+
+void analyzer_register_items(Module* module) {
+    setup_primitive_types(module);
+
+    register_items(module, &module->ast);
+
+    evaluate_streamed_constants(module);
+    devirtualize_calls(module);
+
+    // the caller goes through every fn, calls don't need to line any up
+    for (item_id id = 1; id <= ast_item_count(&module->ast); id += 1) {
+        Item* item = ast_item(&module->ast, id);
+        if (item->kind == ItemKind_FnDef) {
+            item->fn_definition.queued = true;
+        }
+    }
+}
 
-    analyze_ast(module, module->ast);
+bool analyzer_analyze_fn(Module* module, item_id item) {
+    bool analyzed = analyze_fn_definition(module, item);
+    take_calls(module, module);
+    devirtualize_calls(module);
+    return analyzed;
 }
@@ -3,6 +3,15 @@
 
 #include "module.h"
 
-void analyzer_analyze(Module* module);
+// fn bodies are analyzed on up to thread_count threads (0 = one per core)
+void analyzer_analyze(Module* module, usize thread_count);
+
+// for analyzing one fn at a time. analyzer_register_items makes every item
+// known from its signature and evaluates the constants, parsing and
+// analyzing the bodies of the fns they call. analyzer_analyze_fn then checks
+// a fn whose body has been parsed. fns lined up by calls are left to the
+// caller.
+void analyzer_register_items(Module* module);
+bool analyzer_analyze_fn(Module* module, item_id item);
 
 #endif //!ANALYZER_H
@@ -0,0 +1,157 @@
+#include "arena.h"
+
+#include "util.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ARRAY_INITIAL_CAPACITY 8
+
+
+struct ArenaChunk {
+    ArenaChunk* previous;
+    usize capacity;
+    usize used;
+    _Alignas(ARENA_ALIGNMENT) u8 data[];
+};
+
+static usize align_size(usize size) {
+    return (size + ARENA_ALIGNMENT - 1) & ~(usize)(ARENA_ALIGNMENT - 1);
+}
+
+static ArenaChunk* new_chunk(usize capacity) {
+    ArenaChunk* chunk = calloc(1, sizeof(ArenaChunk) + capacity);
+    if (chunk == null) {
+        sil_panic("out of memory");
+    }
+    chunk->capacity = capacity;
+    return chunk;
+}
+
+void arena_init(Arena* arena) {
+    arena->chunk = null;
+}
+
+void arena_deinit(Arena* arena) {
+    ArenaChunk* chunk = arena->chunk;
+    while (chunk != null) {
+        ArenaChunk* previous = chunk->previous;
+        free(chunk);
+        chunk = previous;
+    }
+    arena->chunk = null;
+}
+
+void* arena_alloc(Arena* arena, usize size) {
+    size = align_size(size);
+    ArenaChunk* chunk = arena->chunk;
+
+    if (chunk == null or chunk->capacity - chunk->used < size) {
+        // big allocations get a chunk of their own, slotted in behind the
+        // current one so the space left in it isn't thrown away
+        if (chunk != null and size > ARENA_CHUNK_SIZE / 4) {
+            ArenaChunk* own = new_chunk(size);
+            own->used = size;
+            own->previous = chunk->previous;
+            chunk->previous = own;
+            return own->data;
+        }
+
+        chunk = new_chunk(size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE);
+        chunk->previous = arena->chunk;
+        arena->chunk = chunk;
+    }
+
+    void* ptr = chunk->data + chunk->used;
+    chunk->used += size;
+    return ptr;
+}
+
+String arena_format(Arena* arena, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(null, 0, format, args);
+    va_end(args);
+
+    char* ptr = arena_alloc(arena, (usize)len + 1);
+
+    va_start(args, format);
+    vsnprintf(ptr, (usize)len + 1, format, args);
+    va_end(args);
+
+    return (String){ ptr, (usize)len };
+}
+
+ArenaMark arena_mark(Arena* arena) {
+    ArenaChunk* chunk = arena->chunk;
+    if (chunk == null) {
+        return (ArenaMark){ null, null, 0 };
+    }
+    return (ArenaMark){ chunk, chunk->previous, chunk->used };
+}
+
+void arena_release(Arena* arena, ArenaMark mark) {
+    // chunks started since the mark, along with the big allocations slotted
+    // in behind them
+    ArenaChunk* chunk = arena->chunk;
+    while (chunk != mark.chunk) {
+        ArenaChunk* previous = chunk->previous;
+        free(chunk);
+        chunk = previous;
+    }
+
+    arena->chunk = chunk;
+    if (chunk == null) { return; }
+
+    // big allocations made while the marked chunk was still being filled
+    ArenaChunk* own = chunk->previous;
+    while (own != mark.previous) {
+        ArenaChunk* previous = own->previous;
+        free(own);
+        own = previous;
+    }
+    chunk->previous = mark.previous;
+
+    // memory is handed out zeroed
+    memset(chunk->data + mark.used, 0, chunk->used - mark.used);
+    chunk->used = mark.used;
+}
+
+
+// ----------- //
+// Arena Array //
+// ----------- //
+void* arena_array_init(Arena* arena) {
+    ArenaArrayHeader* header = arena_alloc(arena, sizeof(ArenaArrayHeader));
+    header->len = 0;
+    header->capacity = 0;
+    return header + 1;
+}
+
+void* arena_array_grow(Arena* arena, void* array, usize item_size) {
+    ArenaArrayHeader* header = arena_array_header(array);
+    if (header->len < header->capacity) { return array; }
+
+    usize capacity = header->capacity == 0 ? ARENA_ARRAY_INITIAL_CAPACITY : header->capacity * 2;
+    usize old_size = align_size(sizeof(ArenaArrayHeader) + header->capacity * item_size);
+    usize new_size = align_size(sizeof(ArenaArrayHeader) + capacity * item_size);
+
+    // the last allocation in the chunk can grow where it is
+    ArenaChunk* chunk = arena->chunk;
+    if (
+        chunk != null and
+        (u8*)header + old_size == chunk->data + chunk->used and
+        chunk->capacity - chunk->used >= new_size - old_size
+    ) {
+        chunk->used += new_size - old_size;
+        header->capacity = capacity;
+        return array;
+    }
+
+    ArenaArrayHeader* grown = arena_alloc(arena, new_size);
+    memcpy(grown, header, sizeof(ArenaArrayHeader) + header->len * item_size);
+    grown->capacity = capacity;
+    return grown + 1;
+}
@@ -0,0 +1,66 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <chnlib/chntype.h>
+#include <chnlib/str.h>
+
+
+// bump allocator. everything allocated from an arena lives until the arena
+// is deinitialized, there is no way to free a single allocation. memory is
+// handed out zeroed and aligned to ARENA_ALIGNMENT.
+#define ARENA_ALIGNMENT 16
+#define ARENA_CHUNK_SIZE (64 * 1024)
+
+typedef struct ArenaChunk ArenaChunk;
+
+typedef struct Arena {
+    // the chunk being filled, earlier chunks are linked behind it
+    ArenaChunk* chunk;
+} Arena;
+
+// where an arena was at some point, see arena_release
+typedef struct ArenaMark {
+    ArenaChunk* chunk;
+    ArenaChunk* previous;
+    usize used;
+} ArenaMark;
+
+
+void arena_init(Arena* arena);
+void arena_deinit(Arena* arena);
+
+void* arena_alloc(Arena* arena, usize size);
+#define arena_new(arena, T) ((T*)arena_alloc((arena), sizeof(T)))
+
+__attribute__((format(printf, 2, 3)))
+String arena_format(Arena* arena, const char* format, ...);
+
+// frees everything allocated since the mark at once, the memory is handed
+// out again from there. nothing allocated after the mark may still be used.
+ArenaMark arena_mark(Arena* arena);
+void arena_release(Arena* arena, ArenaMark mark);
+
+
+// ----------- //
+// Arena Array //
+// ----------- //
+// growable arrays that live in an arena, used the same way as a DynArray.
+// the length sits in a header just before the first item. growing an array
+// that isn't the last allocation leaves the old items behind in the arena.
+#define ArenaArray(T) T*
+
+typedef struct ArenaArrayHeader {
+    usize len;
+    usize capacity;
+} ArenaArrayHeader;
+
+void* arena_array_init(Arena* arena);
+void* arena_array_grow(Arena* arena, void* array, usize item_size);
+
+#define arena_array_header(array) ((ArenaArrayHeader*)(array) - 1)
+#define arena_array_len(array) (arena_array_header(array)->len)
+#define arena_array_add(arena, array) \
+    ((array) = arena_array_grow((arena), (array), sizeof(*(array))), &(array)[arena_array_header(array)->len++])
+#define arena_array_push(arena, array, item) (*arena_array_add((arena), (array)) = *(item))
+
+#endif // !ARENA_H
@@ -1,5 +1,261 @@
 #include "ast.h"
 
+#include <stdlib.h>
+#include <string.h>
+
+
+#define AST_POOL_INITIAL_CAPACITY 64
+
+
+void ast_init(Ast* ast, String source) {
+    memset(ast, 0, sizeof(Ast));
+    ast->source = source;
+
+    // reserve id 0
+    ((Expr*)ast_extend(ast, exprs, 1))->kind = ExprKind_Unreachable;
+    ((Stmt*)ast_extend(ast, stmts, 1))->kind = StmtKind_Expr;
+    ((Ast_Type*)ast_extend(ast, types, 1))->kind = TypeKind_Void;
+    ((Item*)ast_extend(ast, items, 1))->kind = ItemKind_Const;
+    ast_extend(ast, asms, 1);
+}
+
+void ast_deinit(Ast* ast) {
+    free(ast->exprs);
+    free(ast->stmts);
+    free(ast->types);
+    free(ast->items);
+    free(ast->asms);
+    free(ast->extra);
+}
+
+void* ast_extend_pool(void** pool, u32* len, u32* capacity, usize size, usize count) {
+    if (*len + count > *capacity) {
+        usize new_capacity = *capacity == 0 ? AST_POOL_INITIAL_CAPACITY : *capacity;
+        while (new_capacity < *len + count) { new_capacity *= 2; }
+
+        *pool = realloc(*pool, new_capacity * size);
+        if (*pool == null) {
+            sil_panic("out of memory");
+        }
+        *capacity = new_capacity;
+    }
+
+    void* first = (u8*)*pool + *len * size;
+    *len += count;
+    return first;
+}
+
+void ast_release(Ast* ast, AstCounts mark) {
+    if (mark.items != ast->len.items) {
+        sil_panic("items were added to the ast after the mark");
+    }
+
+    ast->len = mark;
+}
+
+expr_id ast_add_expr(Ast* ast, Expr* expression) {
+    *(Expr*)ast_extend(ast, exprs, 1) = *expression;
+    return ast->len.exprs - 1;
+}
+
+stmt_id ast_add_stmt(Ast* ast, Stmt* statement) {
+    *(Stmt*)ast_extend(ast, stmts, 1) = *statement;
+    return ast->len.stmts - 1;
+}
+
+ast_type_id ast_add_type(Ast* ast, Ast_Type* type) {
+    *(Ast_Type*)ast_extend(ast, types, 1) = *type;
+    return ast->len.types - 1;
+}
+
+item_id ast_add_item(Ast* ast, Item* item) {
+    *(Item*)ast_extend(ast, items, 1) = *item;
+    return ast->len.items - 1;
+}
+
+asm_id ast_add_asm(Ast* ast, Asm* asm) {
+    *(Asm*)ast_extend(ast, asms, 1) = *asm;
+    return ast->len.asms - 1;
+}
+
+AstRange ast_add_extra(Ast* ast, const void* items, usize count, usize size) {
+    AstRange range = { ast->len.extra, count };
+
+    usize words = count * (size / sizeof(u32));
+    if (words > 0) {
+        memcpy(ast_extend(ast, extra, words), items, words * sizeof(u32));
+    }
+
+    return range;
+}
+
+// ---------- //
+// Append Ast //
+// ---------- //
+typedef struct AstOffsets {
+    u32 expr;
+    u32 stmt;
+    u32 type;
+    u32 asm;
+    u32 extra;
+} AstOffsets;
+
+// id 0 stays 0, everything else moves past the nodes already in the pool
+static u32 shift(u32 id, u32 offset) {
+    return id == 0 ? 0 : id + offset;
+}
+
+static u32* shift_range(Ast* ast, AstRange* range, AstOffsets* offsets) {
+    range->start += offsets->extra;
+    return &ast->extra[range->start];
+}
+
+static void shift_signature(Ast* ast, FnSig* signature, AstOffsets* offsets) {
+    FnParam* parameters = (FnParam*)shift_range(ast, &signature->parameters, offsets);
+    for (usize i = 0; i < signature->parameters.len; i += 1) {
+        parameters[i].type = shift(parameters[i].type, offsets->type);
+    }
+    signature->return_type = shift(signature->return_type, offsets->type);
+}
+
+static void shift_expr(Ast* ast, Expr* expression, AstOffsets* offsets) {
+    switch (expression->kind) {
+        case ExprKind_Block: {
+            stmt_id* statements = shift_range(ast, &expression->block.statements, offsets);
+            for (usize i = 0; i < expression->block.statements.len; i += 1) {
+                statements[i] = shift(statements[i], offsets->stmt);
+            }
+            break;
+        }
+        case ExprKind_If: {
+            expression->if_expr.condition = shift(expression->if_expr.condition, offsets->expr);
+            expression->if_expr.then = shift(expression->if_expr.then, offsets->expr);
+            expression->if_expr.otherwise = shift(expression->if_expr.otherwise, offsets->expr);
+            break;
+        }
+        case ExprKind_Match: {
+            expression->match.condition = shift(expression->match.condition, offsets->expr);
+            MatchArm* arms = (MatchArm*)shift_range(ast, &expression->match.arms, offsets);
+            for (usize i = 0; i < expression->match.arms.len; i += 1) {
+                arms[i].then = shift(arms[i].then, offsets->expr);
+            }
+            break;
+        }
+        case ExprKind_BinOp: {
+            expression->binary_operator.left = shift(expression->binary_operator.left, offsets->expr);
+            expression->binary_operator.right = shift(expression->binary_operator.right, offsets->expr);
+            break;
+        }
+        case ExprKind_Let: {
+            expression->let.type = shift(expression->let.type, offsets->type);
+            expression->let.value = shift(expression->let.value, offsets->expr);
+            break;
+        }
+        case ExprKind_Ret: expression->ret = shift(expression->ret, offsets->expr); break;
+        case ExprKind_FnCall:
+        case ExprKind_IndirectCall: {
+            expr_id* arguments = shift_range(ast, &expression->fn_call.arguments, offsets);
+            for (usize i = 0; i < expression->fn_call.arguments.len; i += 1) {
+                arguments[i] = shift(arguments[i], offsets->expr);
+            }
+            break;
+        }
+        case ExprKind_Loop: expression->loop.body = shift(expression->loop.body, offsets->expr); break;
+        case ExprKind_Asm: expression->asm = shift(expression->asm, offsets->asm); break;
+        case ExprKind_Cast: {
+            expression->cast.expr = shift(expression->cast.expr, offsets->expr);
+            expression->cast.to = shift(expression->cast.to, offsets->type);
+            break;
+        }
+        default: break;
+    }
+}
+
+static void shift_item(Ast* ast, Item* item, AstOffsets* offsets) {
+    switch (item->kind) {
+        case ItemKind_FnDef: {
+            shift_signature(ast, &item->fn_definition.signature, offsets);
+            item->fn_definition.body = shift(item->fn_definition.body, offsets->expr);
+            break;
+        }
+        case ItemKind_ExternFn: shift_signature(ast, &item->extern_fn.signature, offsets); break;
+        case ItemKind_StructDef: {
+            StructField* fields = (StructField*)shift_range(ast, &item->struct_definition.fields, offsets);
+            for (usize i = 0; i < item->struct_definition.fields.len; i += 1) {
+                fields[i].type = shift(fields[i].type, offsets->type);
+            }
+            break;
+        }
+        case ItemKind_Const: {
+            item->constant.type = shift(item->constant.type, offsets->type);
+            item->constant.value = shift(item->constant.value, offsets->expr);
+            break;
+        }
+    }
+}
+
+void ast_append(Ast* ast, Ast* other) {
+    AstOffsets offsets = {
+        .expr = ast->len.exprs - 1,
+        .stmt = ast->len.stmts - 1,
+        .type = ast->len.types - 1,
+        .asm = ast->len.asms - 1,
+        .extra = ast->len.extra,
+    };
+
+    // the extra lists are copied as is, their contents are shifted by the
+    // node that owns them
+    ast_add_extra(ast, other->extra, other->len.extra, sizeof(u32));
+
+    for (usize i = 1; i < other->len.exprs; i += 1) {
+        Expr* expression = ast_extend(ast, exprs, 1);
+        *expression = other->exprs[i];
+        shift_expr(ast, expression, &offsets);
+    }
+
+    for (usize i = 1; i < other->len.stmts; i += 1) {
+        Stmt* statement = ast_extend(ast, stmts, 1);
+        *statement = other->stmts[i];
+        statement->expression = shift(statement->expression, offsets.expr);
+    }
+
+    for (usize i = 1; i < other->len.types; i += 1) {
+        Ast_Type* type = ast_extend(ast, types, 1);
+        *type = other->types[i];
+        if (type->kind == TypeKind_Ptr) {
+            type->ptr.to = shift(type->ptr.to, offsets.type);
+        } else if (type->kind == TypeKind_Fn) {
+            ast_type_id* parameters = shift_range(ast, &type->fn.parameters, &offsets);
+            for (usize j = 0; j < type->fn.parameters.len; j += 1) {
+                parameters[j] = shift(parameters[j], offsets.type);
+            }
+            type->fn.return_type = shift(type->fn.return_type, offsets.type);
+        }
+    }
+
+    for (usize i = 1; i < other->len.asms; i += 1) {
+        Asm* asm = ast_extend(ast, asms, 1);
+        *asm = other->asms[i];
+        AsmInput* inputs = (AsmInput*)shift_range(ast, &asm->inputs, &offsets);
+        for (usize j = 0; j < asm->inputs.len; j += 1) {
+            inputs[j].val = shift(inputs[j].val, offsets.expr);
+        }
+        shift_range(ast, &asm->clobbers, &offsets);
+        shift_range(ast, &asm->outputs, &offsets);
+        shift_range(ast, &asm->source, &offsets);
+    }
+
+    for (usize i = 1; i < other->len.items; i += 1) {
+        Item* item = ast_extend(ast, items, 1);
+        *item = other->items[i];
+        shift_item(ast, item, &offsets);
+    }
+
+    String source = other->source;
+    ast_deinit(other);
+    ast_init(other, source);
+}
+
 bool should_remove_statement_semi(Expr* expression) {
     return (
 	expression->kind == ExprKind_If ||
@@ -9,3 +265,34 @@ bool should_remove_statement_semi(Expr* expression) {
         expression->kind == ExprKind_Asm
     );
 }
+
+
+// ---------- //
+// Expr Stack //
+// ---------- //
+void expr_stack_init(ExprStack* stack) {
+    stack->items = stack->inline_items;
+    stack->len = 0;
+    stack->capacity = EXPR_STACK_INLINE;
+}
+
+void expr_stack_deinit(ExprStack* stack) {
+    if (stack->items != stack->inline_items) {
+        free(stack->items);
+    }
+}
+
+void expr_stack_push(ExprStack* stack, expr_id id) {
+    if (stack->len == stack->capacity) {
+        stack->capacity *= 2;
+        if (stack->items == stack->inline_items) {
+            stack->items = malloc(stack->capacity * sizeof(expr_id));
+            memcpy(stack->items, stack->inline_items, sizeof(stack->inline_items));
+        } else {
+            stack->items = realloc(stack->items, stack->capacity * sizeof(expr_id));
+        }
+    }
+
+    stack->items[stack->len] = id;
+    stack->len += 1;
+}
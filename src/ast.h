@@ -3,14 +3,38 @@
 
 #include "util.h"
 #include "typetable.h"
+#include "intern.h"
+#include "arena.h"
 #include <chnlib/str.h>
-#include <chnlib/map.h>
 #include <chnlib/dynarray.h>
 
 typedef struct Item Item;
 typedef struct Let Let;
 typedef struct Stmt Stmt;
 typedef struct Expr Expr;
+typedef struct ConstValue ConstValue;
+
+// nodes live in typed pools in an Ast and refer to each other by index.
+// index 0 of every pool is reserved so 0 can mean "none".
+typedef u32 expr_id;
+typedef u32 stmt_id;
+typedef u32 item_id;
+typedef u32 ast_type_id;
+typedef u32 asm_id;
+// a value worked out at compile time, see consteval.h
+typedef u32 const_id;
+
+// a list of children, len items starting at start in Ast.extra
+typedef struct AstRange {
+    u32 start;
+    u32 len;
+} AstRange;
+
+// a slice of the source text
+typedef struct AstSpan {
+    u32 start;
+    u32 len;
+} AstSpan;
 
 
 // ------------ //
@@ -20,18 +44,41 @@ typedef struct Expr Expr;
 //       so they can be references later. don't...
 typedef struct SymEntry {
     type_id type;
-    Expr* expression;
+    expr_id expression;
+    // constants only, the value of expression once it's been evaluated
+    const_id value;
+    // constants only, a reachable fn uses it
+    bool reachable;
 } SymEntry;
 
-typedef struct Scope {
-    struct Scope* parent;
-    DynArray(struct Scope) children;
-    Map(SymEntry) symbols;
-} Scope;
+// one name bound in one scope. the bindings of every open scope are kept on
+// a single stack, innermost scope last.
+typedef struct SymBinding {
+    symbol_id name;
+    // number of scopes open when it was bound, 0 for the root scope
+    u32 depth;
+    // the binding of the same name this one hides, + 1, or 0
+    u32 shadowed;
+    SymEntry entry;
+} SymBinding;
 
 typedef struct SymTable {
-    Scope root_scope;
-    Scope* current_scope;
+    // with no scope open this holds exactly the root scope's symbols, in
+    // the order they were inserted
+    SymBinding* bindings;
+    u32 binding_count;
+    u32 binding_capacity;
+
+    // where the bindings of each open scope start
+    u32* scope_starts;
+    u32 depth;
+    u32 scope_capacity;
+
+    // open addressing over names, each slot holds the innermost binding of
+    // a name + 1, or 0
+    u32* slots;
+    usize name_count;
+    usize capacity;
 } SymTable;
 
 
@@ -47,29 +94,27 @@ typedef enum Ast_TypeKind {
     TypeKind_Array,
     TypeKind_Never,
     TypeKind_Type,
+    TypeKind_Fn,
 } Ast_TypeKind;
 
-typedef struct Ast_Integral {
-    bool is_signed;
-    uint64_t value;
-} Ast_Integer;
-
-typedef struct Ast_Decimal {
-    double value;
-} Ast_Decimal;
-
 typedef struct Ast_Ptr {
-    Ast_Type* to;
+    ast_type_id to;
     bool is_mut;
 } Ast_Ptr;
 
+// fn(P, ...) -> R, void when the arrow is left out
+typedef struct Ast_FnType {
+    // ast_type_ids
+    AstRange parameters;
+    ast_type_id return_type;
+} Ast_FnType;
+
 typedef struct Ast_Type {
     Ast_TypeKind kind;
     union {
-	String symbol;
+	symbol_id symbol;
 	Ast_Ptr ptr;
-	Ast_Integer integer;
-	Ast_Decimal decimal;
+	Ast_FnType fn;
     };
 } Ast_Type;
 
@@ -98,39 +143,44 @@ typedef enum ExprKind {
     ExprKind_Field,
     ExprKind_Index,
     ExprKind_Cast,
+    // a call through a local, parameter or constant of fn type, the
+    // payload is fn_call with the name of what holds the fn
+    ExprKind_IndirectCall,
 } ExprKind;
 
 typedef struct StringLit {
-    String span;
+    AstSpan span;
 } StringLit;
 
 typedef struct NumberLit {
-    String span;
+    AstSpan span;
 } NumberLit;
 
 typedef struct Block {
-    Scope* scope;
-    DynArray(Stmt*) statements;
+    // stmt_ids
+    AstRange statements;
 } Block;
 
 typedef struct If {
-    Expr* condition;
-    Expr* then;
-    Expr* otherwise;
+    expr_id condition;
+    expr_id then;
+    expr_id otherwise;
 } If;
 
+// stored in Ast.extra
 typedef struct MatchArm {
-    NumberLit* pattern;
-    Expr* then;
+    NumberLit pattern;
+    expr_id then;
 } MatchArm;
 
 typedef struct Match {
-    Expr* condition;
-    DynArray(MatchArm*) arms;
+    expr_id condition;
+    // MatchArms
+    AstRange arms;
 } Match;
 
 typedef struct Loop {
-    Expr* body;
+    expr_id body;
 } Loop;
 
 typedef enum BinOpKind {
@@ -149,8 +199,8 @@ typedef enum BinOpKind {
 
 typedef struct BinOp {
     BinOpKind kind;
-    Expr* left;
-    Expr* right;
+    expr_id left;
+    expr_id right;
 } BinOp;
 
 typedef enum OpPrec {
@@ -175,50 +225,55 @@ typedef enum OpPrec {
 } OpPrec;
 
 typedef struct Let {
-    String name;
-    Ast_Type* type;
-    Expr* value;
+    symbol_id name;
+    ast_type_id type;
+    expr_id value;
 } Let;
 
 typedef struct FnCall {
-    String name;
-    DynArray(Expr*) arguments;
+    symbol_id name;
+    // expr_ids
+    AstRange arguments;
 } FnCall;
 
+// stored in Ast.extra
 typedef struct AsmInput {
-    String reg;
-    Expr* val;
+    AstSpan reg;
+    expr_id val;
 } AsmInput;
 
+// asm blocks are too big to go inline in an Expr, they get a pool of their own
 typedef struct Asm {
-    DynArray(AsmInput) inputs;
-    DynArray(String) clobbers;
-    DynArray(String) outputs;
-    DynArray(StringLit) source;
+    // AsmInputs
+    AstRange inputs;
+    // AstSpans
+    AstRange clobbers;
+    AstRange outputs;
+    AstRange source;
 } Asm;
 
 typedef struct Cast {
-    Expr* expr;
-    Ast_Type* to;
+    expr_id expr;
+    ast_type_id to;
 } Cast;
 
 typedef struct Expr {
     ExprKind kind;
     union {
 	StringLit string_literal;
-	NumberLit* number_literal;
-	Block* block;
-	If* if_expr;
-	Match* match;
-	BinOp* binary_operator;
-	Let* let;
-	Expr* ret;
-	String symbol;
-	FnCall* fn_call;
+	NumberLit number_literal;
+	Block block;
+	If if_expr;
+	Match match;
+	BinOp binary_operator;
+	Let let;
+	expr_id ret;
+	symbol_id symbol;
+	FnCall fn_call;
         bool boolean;
-        Loop* loop;
-        Asm* asm;
-        Cast* cast;
+        Loop loop;
+        asm_id asm;
+        Cast cast;
     };
 
     struct {
@@ -238,7 +293,7 @@ typedef enum StmtKind {
 typedef struct Stmt {
     StmtKind kind;
     union {
-	Expr* expression;
+	expr_id expression;
     };
 } Stmt;
 
@@ -257,56 +312,206 @@ typedef struct Visibilty {
     bool is_pub;
 } Visibility;
 
+// what's known about the memory a pointer parameter points to, the ones
+// that are known not to overlap get C's restrict
+typedef enum ParamAlias {
+    // may be what other pointers point to as well
+    ParamAlias_Maybe,
+    // declared noalias
+    ParamAlias_Declared,
+    // see callgraph_infer_noalias
+    ParamAlias_Inferred,
+} ParamAlias;
+
+// stored in Ast.extra
 typedef struct FnParam {
-    String name;
-    Ast_Type* type;
+    symbol_id name;
+    ast_type_id type;
+    // a ParamAlias, extra only holds u32s
+    u32 alias;
 } FnParam;
 
 typedef struct FnSig {
-    DynArray(FnParam*) parameters;
-    Ast_Type* return_type;
+    // FnParams
+    AstRange parameters;
+    ast_type_id return_type;
 } FnSig;
 
+// what the C backend tells gcc about inlining a fn
+typedef enum FnInline {
+    // gcc's own heuristics decide
+    FnInline_Auto,
+    FnInline_Always,
+    FnInline_Never,
+} FnInline;
+
+// what a fn does besides returning, from most to least. a caller is no
+// purer than the least pure fn it calls.
+typedef enum FnPurity {
+    // may change memory, do io or never return
+    FnPurity_Impure,
+    // may read memory but changes nothing, gcc's pure
+    FnPurity_Pure,
+    // only looks at its arguments, gcc's const
+    FnPurity_Const,
+} FnPurity;
+
 typedef struct FnDef {
-    FnSig* signature;
-    Expr* body;
+    FnSig signature;
+    // 0 while the body hasn't been parsed, see parser_parse_body
+    expr_id body;
+    // token index of the body's '{'
+    u32 body_start;
+    // the analyzer has it lined up
+    bool queued;
+    // from #[inline] or #[noinline], the rest is filled in by
+    // callgraph_plan_inlining
+    FnInline inlining;
+    // impure until callgraph_infer_purity
+    FnPurity purity;
+    // the fn with the same body that's written out in its place, see
+    // callgraph_fold_duplicates. 0 when it's written out itself.
+    item_id folded_into;
+    // analyzed code uses it as a value, so it may be called through a
+    // pointer and has to keep an address of its own
+    bool address_taken;
 } FnDef;
 
 typedef struct ExternFn {
-    FnSig* signature;
+    FnSig signature;
+    // from #[pure] or #[const], there's no body to tell
+    FnPurity purity;
 } ExternFn;
 
+// stored in Ast.extra
 typedef struct StructField {
     Visibility visibility;
-    String name;
-    Ast_Type* type;
+    symbol_id name;
+    ast_type_id type;
 } StructField;
 
 typedef struct StructDef {
-    DynArray(StructField*) fields;
+    // StructFields
+    AstRange fields;
 } StructDef;
 
 typedef struct Constant {
-    Ast_Type* type;
-    Expr* value;
+    ast_type_id type;
+    expr_id value;
 } Constant;
 
 typedef struct Item {
     Visibility visibility;
+    // something main, _start or a pub item leads to uses it, see callgraph.h
+    bool reachable;
     ItemKind kind;
-    String name;
+    symbol_id name;
     union {
-	FnDef* fn_definition;
-	ExternFn* extern_fn;
-	StructDef* struct_definition;
-	Constant* constant;
+	FnDef fn_definition;
+	ExternFn extern_fn;
+	StructDef struct_definition;
+	Constant constant;
     };
 } Item;
 
-typedef struct AstRoot {
-    DynArray(Item*) items;
-} AstRoot;
+
+// --- //
+// Ast //
+// --- //
+// every pool is a plain array of plain structs, so an ast can be copied
+// with one memcpy per pool. child lists are ranges of u32s in extra that
+// hold ids or small structs made of u32s (FnParam, MatchArm, ...). items
+// are stored in source order.
+typedef struct AstCounts {
+    u32 exprs;
+    u32 stmts;
+    u32 types;
+    u32 items;
+    u32 asms;
+    u32 extra;
+} AstCounts;
+
+typedef struct Ast {
+    String source;
+
+    Expr* exprs;
+    Stmt* stmts;
+    Ast_Type* types;
+    Item* items;
+    Asm* asms;
+    u32* extra;
+
+    // entries in use in each pool (reserved ones included) and room for
+    // them. the pools are grown by hand so they can shrink, see ast_release.
+    AstCounts len;
+    AstCounts capacity;
+} Ast;
+
+void ast_init(Ast* ast, String source);
+void ast_deinit(Ast* ast);
+
+expr_id ast_add_expr(Ast* ast, Expr* expression);
+stmt_id ast_add_stmt(Ast* ast, Stmt* statement);
+ast_type_id ast_add_type(Ast* ast, Ast_Type* type);
+item_id ast_add_item(Ast* ast, Item* item);
+asm_id ast_add_asm(Ast* ast, Asm* asm);
+// copies count items of size bytes (a multiple of 4) into extra
+AstRange ast_add_extra(Ast* ast, const void* items, usize count, usize size);
+// moves every node of other onto the end of ast, in order. ids in the moved
+// nodes are shifted to match, other is left empty.
+void ast_append(Ast* ast, Ast* other);
+
+// adds count entries to the end of a pool and returns the first, they're
+// left for the caller to fill in. used as ast_extend(ast, exprs, count).
+void* ast_extend_pool(void** pool, u32* len, u32* capacity, usize size, usize count);
+#define ast_extend(ast, pool, count) ast_extend_pool( \
+        (void**)&(ast)->pool, &(ast)->len.pool, &(ast)->capacity.pool, sizeof(*(ast)->pool), (count))
+
+// everything added after ast_mark is dropped by ast_release, ids past the
+// mark are free to be handed out again. items can't be released.
+static inline AstCounts ast_mark(Ast* ast) { return ast->len; }
+void ast_release(Ast* ast, AstCounts mark);
+
+// pointers into a pool are only good until something is added to it
+static inline Expr* ast_expr(Ast* ast, expr_id id) { return &ast->exprs[id]; }
+static inline Stmt* ast_stmt(Ast* ast, stmt_id id) { return &ast->stmts[id]; }
+static inline Ast_Type* ast_type(Ast* ast, ast_type_id id) { return &ast->types[id]; }
+static inline Item* ast_item(Ast* ast, item_id id) { return &ast->items[id]; }
+static inline Asm* ast_asm(Ast* ast, asm_id id) { return &ast->asms[id]; }
+
+// items run from 1 to ast_item_count(ast) inclusive
+static inline usize ast_item_count(Ast* ast) { return ast->len.items - 1; }
+
+#define ast_list(ast, range, T) ((T*)&(ast)->extra[(range).start])
+
+static inline String ast_span(Ast* ast, AstSpan span) {
+    return str_slice(ast->source.ptr + span.start, span.len);
+}
 
 bool should_remove_statement_semi(Expr* expression);
 
+
+// ---------- //
+// Expr Stack //
+// ---------- //
+// for walking long chains of nodes (a + b + c ..., else if ladders) without
+// recursing once per node. short stacks don't touch the heap.
+#define EXPR_STACK_INLINE 32
+
+typedef struct ExprStack {
+    expr_id* items;
+    usize len;
+    usize capacity;
+    expr_id inline_items[EXPR_STACK_INLINE];
+} ExprStack;
+
+void expr_stack_init(ExprStack* stack);
+void expr_stack_deinit(ExprStack* stack);
+void expr_stack_push(ExprStack* stack, expr_id id);
+
+static inline expr_id expr_stack_pop(ExprStack* stack) {
+    stack->len -= 1;
+    return stack->items[stack->len];
+}
+
 #endif // !AST_H
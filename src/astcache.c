@@ -0,0 +1,540 @@
+#include "astcache.h"
+
+#include "compiler.h"
+#include "os.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// bump whenever the layout of the file or of any ast node changes
+#define ASTCACHE_FORMAT 9
+#define ASTCACHE_MAGIC "silast\0\0"
+#define ASTCACHE_ALIGNMENT 8
+
+
+// the file is the header followed by one section per table, each padded to
+// ASTCACHE_ALIGNMENT: names (as AstSpans into the source, from id 1), token
+// kinds, starts, lengths and symbols, then the expr, stmt, type, item and asm
+// pools (from id 1) and extra. everything is stored as it is in memory.
+typedef struct AstCacheHeader {
+    char magic[8];
+    u32 version[3];
+    u32 format;
+    u64 key;
+    u64 source_len;
+    // of everything after the header
+    u64 checksum;
+    u32 lazy_bodies;
+
+    u32 names;
+    u32 tokens;
+    u32 exprs;
+    u32 stmts;
+    u32 types;
+    u32 items;
+    u32 asms;
+    u32 extra;
+} AstCacheHeader;
+
+static u64 hash_bytes(u64 hash, const void* data, usize length) {
+    const u8* bytes = data;
+    for (usize i = 0; i < length; i += 1) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static void fill_header(AstCacheHeader* header, Module* module, AstCache* cache) {
+    memset(header, 0, sizeof(AstCacheHeader));
+    memcpy(header->magic, ASTCACHE_MAGIC, sizeof(header->magic));
+    header->version[0] = VERSION_MAJOR;
+    header->version[1] = VERSION_MINOR;
+    header->version[2] = VERSION_PATCH;
+    header->format = ASTCACHE_FORMAT;
+    header->source_len = module->source.len;
+    header->lazy_bodies = cache->lazy_bodies;
+
+    u64 key = hash_bytes(14695981039346656037ull, module->source.ptr, module->source.len);
+    key = hash_bytes(key, header->version, sizeof(header->version));
+    key = hash_bytes(key, &header->format, sizeof(header->format));
+    key = hash_bytes(key, &header->lazy_bodies, sizeof(header->lazy_bodies));
+    header->key = key;
+}
+
+// the sections are padded to whole words, so the payload is hashed a word
+// at a time, on four lanes that don't wait on each other
+static u64 mix_word(u64 hash, const u8* data) {
+    u64 word;
+    memcpy(&word, data, sizeof(u64));
+    hash = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+    return hash ^ (hash >> 32);
+}
+
+static u64 hash_payload(const u8* data, usize length) {
+    u64 lanes[4] = { 14695981039346656037ull, 1, 2, 3 };
+    usize words = length / sizeof(u64);
+    usize i = 0;
+    for (; i + 4 <= words; i += 4) {
+        const u8* at = data + i * sizeof(u64);
+        lanes[0] = mix_word(lanes[0], at);
+        lanes[1] = mix_word(lanes[1], at + 8);
+        lanes[2] = mix_word(lanes[2], at + 16);
+        lanes[3] = mix_word(lanes[3], at + 24);
+    }
+    for (; i < words; i += 1) {
+        lanes[0] = mix_word(lanes[0], data + i * sizeof(u64));
+    }
+
+    u64 hash = words;
+    for (usize lane = 0; lane < 4; lane += 1) {
+        hash = mix_word(hash, (const u8*)&lanes[lane]);
+    }
+    return hash;
+}
+
+static bool cache_path(char* path, usize size, AstCache* cache, u64 key) {
+    int length = snprintf(path, size, "%s/%016llx.ast", cache->directory, (unsigned long long)key);
+    return length >= 0 and (usize)length < size;
+}
+
+
+// ------- //
+// Storing //
+// ------- //
+typedef struct CacheWriter {
+    u8* data;
+    usize len;
+    usize capacity;
+} CacheWriter;
+
+static void write_section(CacheWriter* writer, const void* data, usize size) {
+    usize padded = (size + ASTCACHE_ALIGNMENT - 1) & ~(usize)(ASTCACHE_ALIGNMENT - 1);
+    if (writer->len + padded > writer->capacity) {
+        while (writer->len + padded > writer->capacity) { writer->capacity *= 2; }
+        writer->data = realloc(writer->data, writer->capacity);
+    }
+
+    if (size > 0) {
+        memcpy(writer->data + writer->len, data, size);
+    }
+    memset(writer->data + writer->len + size, 0, padded - size);
+    writer->len += padded;
+}
+
+// pools keep their reserved entry 0 out of the file
+#define write_pool(writer, ast, pool) \
+    write_section((writer), &(ast)->pool[1], ((ast)->len.pool - 1) * sizeof(*(ast)->pool))
+
+void astcache_store(Module* module, AstCache* cache) {
+    Ast* ast = &module->ast;
+    TokenList* tokens = &module->tokens;
+
+    AstCacheHeader header;
+    fill_header(&header, module, cache);
+
+    // names are stored as positions in the source, which they all are
+    // straight after parsing
+    usize name_count = intern_count(&module->names) - 1;
+    AstSpan* names = malloc(sizeof(AstSpan) * (name_count + 1));
+    for (usize i = 0; i < name_count; i += 1) {
+        String name = intern_get(&module->names, i + 1);
+        if (name.ptr < module->source.ptr or name.ptr + name.len > module->source.ptr + module->source.len) {
+            free(names);
+            return;
+        }
+        names[i] = (AstSpan){ (u32)(name.ptr - module->source.ptr), (u32)name.len };
+    }
+
+    // tokens are only needed to parse the bodies that were skipped
+    usize token_count = cache->lazy_bodies ? token_list_len(tokens) : 0;
+
+    header.names = name_count;
+    header.tokens = token_count;
+    header.exprs = ast->len.exprs - 1;
+    header.stmts = ast->len.stmts - 1;
+    header.types = ast->len.types - 1;
+    header.items = ast->len.items - 1;
+    header.asms = ast->len.asms - 1;
+    header.extra = ast->len.extra;
+
+    // the header goes in again once the checksum is known
+    CacheWriter writer = { malloc(64 * 1024), 0, 64 * 1024 };
+    write_section(&writer, &header, sizeof(header));
+    usize payload_start = writer.len;
+    write_section(&writer, names, sizeof(AstSpan) * name_count);
+    if (token_count > 0) {
+        write_section(&writer, tokens->kinds, sizeof(u8) * token_count);
+        write_section(&writer, tokens->starts, sizeof(u32) * token_count);
+        write_section(&writer, tokens->lengths, sizeof(u32) * token_count);
+        write_section(&writer, tokens->symbols, sizeof(symbol_id) * token_count);
+    }
+    write_pool(&writer, ast, exprs);
+    write_pool(&writer, ast, stmts);
+    write_pool(&writer, ast, types);
+    write_pool(&writer, ast, items);
+    write_pool(&writer, ast, asms);
+    write_section(&writer, ast->extra, sizeof(u32) * header.extra);
+
+    header.checksum = hash_payload(writer.data + payload_start, writer.len - payload_start);
+    memcpy(writer.data, &header, sizeof(header));
+
+    char path[4096];
+    if (dir_create(cache->directory) and cache_path(path, sizeof(path), cache, header.key)) {
+        // a cache that can't be written is only slower
+        file_write(path, writer.data, writer.len);
+    }
+
+    free(writer.data);
+    free(names);
+}
+
+
+// -------- //
+// Checking //
+// -------- //
+// the checksum catches a file that was cut short or damaged, not one that
+// was written wrong. every id, range and span the loaded nodes hold is
+// checked against what was loaded before anything follows them. the parser
+// adds exprs and types after their children, so a child with a higher id
+// than its parent (a cycle, for one) is rejected as well.
+static bool check_id(u32 id, u32 len) {
+    return id < len;
+}
+
+// anything but 0 or 1 in a bool is undefined
+static bool check_bool(const bool* value) {
+    u8 byte;
+    memcpy(&byte, value, 1);
+    return byte <= 1;
+}
+
+// width is how many u32s each entry of the list takes
+static bool check_range(Ast* ast, AstRange range, usize width) {
+    return (u64)range.start + (u64)range.len * width <= ast->len.extra;
+}
+
+static bool check_span(Ast* ast, AstSpan span) {
+    return (u64)span.start + span.len <= ast->source.len;
+}
+
+static bool check_signature(Ast* ast, FnSig* signature, usize name_count) {
+    if (not check_range(ast, signature->parameters, sizeof(FnParam) / sizeof(u32))) { return false; }
+    if (not check_id(signature->return_type, ast->len.types)) { return false; }
+
+    FnParam* parameters = ast_list(ast, signature->parameters, FnParam);
+    for (usize i = 0; i < signature->parameters.len; i += 1) {
+        if (
+            parameters[i].name > name_count or
+            not check_id(parameters[i].type, ast->len.types) or
+            parameters[i].alias > ParamAlias_Inferred
+        ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool check_ids(Ast* ast, AstRange range, u32 len) {
+    if (not check_range(ast, range, 1)) { return false; }
+
+    u32* ids = ast_list(ast, range, u32);
+    for (usize i = 0; i < range.len; i += 1) {
+        if (not check_id(ids[i], len)) { return false; }
+    }
+    return true;
+}
+
+static bool check_expr(Ast* ast, expr_id id, usize name_count) {
+    Expr* expression = ast_expr(ast, id);
+    switch (expression->kind) {
+        case ExprKind_StringLit: return check_span(ast, expression->string_literal.span);
+        case ExprKind_NumberLit: return check_span(ast, expression->number_literal.span);
+        // the analyzer needs a last statement
+        case ExprKind_Block: {
+            AstRange statements = expression->block.statements;
+            if (statements.len == 0 or not check_ids(ast, statements, ast->len.stmts)) { return false; }
+
+            stmt_id* ids = ast_list(ast, statements, stmt_id);
+            for (usize i = 0; i < statements.len; i += 1) {
+                if (not check_id(ast_stmt(ast, ids[i])->expression, id)) { return false; }
+            }
+            return true;
+        }
+        case ExprKind_If: {
+            return (
+                check_id(expression->if_expr.condition, id) and
+                check_id(expression->if_expr.then, id) and
+                check_id(expression->if_expr.otherwise, id)
+            );
+        }
+        case ExprKind_Match: {
+            Match* match = &expression->match;
+            if (not check_id(match->condition, id)) { return false; }
+            if (not check_range(ast, match->arms, sizeof(MatchArm) / sizeof(u32))) { return false; }
+
+            MatchArm* arms = ast_list(ast, match->arms, MatchArm);
+            for (usize i = 0; i < match->arms.len; i += 1) {
+                if (not check_span(ast, arms[i].pattern.span) or not check_id(arms[i].then, id)) { return false; }
+            }
+            return true;
+        }
+        case ExprKind_BinOp: {
+            return (
+                expression->binary_operator.kind <= BinOpKind_Div and
+                check_id(expression->binary_operator.left, id) and
+                check_id(expression->binary_operator.right, id)
+            );
+        }
+        case ExprKind_Let: {
+            return (
+                expression->let.name <= name_count and
+                check_id(expression->let.type, ast->len.types) and
+                check_id(expression->let.value, id)
+            );
+        }
+        case ExprKind_BoolLit: return check_bool(&expression->boolean);
+        case ExprKind_Ret: return check_id(expression->ret, id);
+        case ExprKind_Symbol: return expression->symbol <= name_count;
+        case ExprKind_FnCall:
+        case ExprKind_IndirectCall: {
+            return expression->fn_call.name <= name_count and check_ids(ast, expression->fn_call.arguments, id);
+        }
+        case ExprKind_Loop: return check_id(expression->loop.body, id);
+        case ExprKind_Asm: {
+            if (not check_id(expression->asm, ast->len.asms)) { return false; }
+
+            Asm* asm = ast_asm(ast, expression->asm);
+            AsmInput* inputs = ast_list(ast, asm->inputs, AsmInput);
+            for (usize i = 0; i < asm->inputs.len; i += 1) {
+                if (not check_id(inputs[i].val, id)) { return false; }
+            }
+            return true;
+        }
+        case ExprKind_Cast: return check_id(expression->cast.expr, id) and check_id(expression->cast.to, ast->len.types);
+        default: return expression->kind <= ExprKind_IndirectCall;
+    }
+}
+
+static bool check_asm(Ast* ast, Asm* asm) {
+    if (not check_range(ast, asm->inputs, sizeof(AsmInput) / sizeof(u32))) { return false; }
+
+    AsmInput* inputs = ast_list(ast, asm->inputs, AsmInput);
+    for (usize i = 0; i < asm->inputs.len; i += 1) {
+        if (not check_span(ast, inputs[i].reg) or not check_id(inputs[i].val, ast->len.exprs)) { return false; }
+    }
+
+    AstRange spans[] = { asm->clobbers, asm->outputs, asm->source };
+    for (usize i = 0; i < sizeof(spans) / sizeof(spans[0]); i += 1) {
+        if (not check_range(ast, spans[i], sizeof(AstSpan) / sizeof(u32))) { return false; }
+
+        AstSpan* list = ast_list(ast, spans[i], AstSpan);
+        for (usize j = 0; j < spans[i].len; j += 1) {
+            if (not check_span(ast, list[j])) { return false; }
+        }
+    }
+    return true;
+}
+
+static bool check_item(Ast* ast, Item* item, usize name_count, usize token_count) {
+    if (item->name > name_count or not check_bool(&item->visibility.is_pub) or not check_bool(&item->reachable)) { return false; }
+
+    switch (item->kind) {
+        case ItemKind_FnDef: {
+            // a body is a block
+            FnDef* fn_definition = &item->fn_definition;
+            expr_id body = fn_definition->body;
+            return (
+                check_signature(ast, &fn_definition->signature, name_count) and
+                check_id(body, ast->len.exprs) and
+                (body == 0 ? fn_definition->body_start < token_count : ast_expr(ast, body)->kind == ExprKind_Block) and
+                check_bool(&fn_definition->queued) and
+                check_bool(&fn_definition->address_taken) and
+                fn_definition->inlining <= FnInline_Never and
+                fn_definition->purity <= FnPurity_Const and
+                check_id(fn_definition->folded_into, ast->len.items)
+            );
+        }
+        case ItemKind_ExternFn: {
+            return check_signature(ast, &item->extern_fn.signature, name_count) and item->extern_fn.purity <= FnPurity_Const;
+        }
+        case ItemKind_StructDef: {
+            AstRange range = item->struct_definition.fields;
+            if (not check_range(ast, range, sizeof(StructField) / sizeof(u32))) { return false; }
+
+            StructField* fields = ast_list(ast, range, StructField);
+            for (usize i = 0; i < range.len; i += 1) {
+                if (
+                    fields[i].name > name_count or
+                    not check_id(fields[i].type, ast->len.types) or
+                    not check_bool(&fields[i].visibility.is_pub)
+                ) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        case ItemKind_Const: {
+            return check_id(item->constant.type, ast->len.types) and check_id(item->constant.value, ast->len.exprs);
+        }
+        default: return false;
+    }
+}
+
+static bool check_ast(Module* module) {
+    Ast* ast = &module->ast;
+    usize name_count = intern_count(&module->names) - 1;
+    usize token_count = token_list_len(&module->tokens);
+
+    // the Eof token is given a length past the end
+    TokenList* tokens = &module->tokens;
+    for (usize i = 0; i < token_count; i += 1) {
+        u32 length = tokens->kinds[i] == TokenKind_Eof ? 0 : tokens->lengths[i];
+        if (
+            tokens->kinds[i] > TokenKind_KeywordAs or
+            (u64)tokens->starts[i] + length > module->source.len or
+            tokens->symbols[i] > name_count
+        ) {
+            return false;
+        }
+    }
+
+    // blocks and asm look into statements and asm inputs, those go first
+    for (stmt_id id = 1; id < ast->len.stmts; id += 1) {
+        Stmt* statement = ast_stmt(ast, id);
+        if (statement->kind > StmtKind_NakedExpr or not check_id(statement->expression, ast->len.exprs)) { return false; }
+    }
+    for (asm_id id = 1; id < ast->len.asms; id += 1) {
+        if (not check_asm(ast, ast_asm(ast, id))) { return false; }
+    }
+    for (expr_id id = 1; id < ast->len.exprs; id += 1) {
+        if (not check_expr(ast, id, name_count)) { return false; }
+    }
+    for (ast_type_id id = 1; id < ast->len.types; id += 1) {
+        Ast_Type* type = ast_type(ast, id);
+        switch (type->kind) {
+            case TypeKind_Symbol: if (type->symbol > name_count) { return false; } break;
+            case TypeKind_Ptr: if (not check_id(type->ptr.to, id) or not check_bool(&type->ptr.is_mut)) { return false; } break;
+            case TypeKind_Fn: {
+                if (not check_ids(ast, type->fn.parameters, id)) { return false; }
+                if (not check_id(type->fn.return_type, id)) { return false; }
+                break;
+            }
+            default: if (type->kind > TypeKind_Fn) { return false; } break;
+        }
+    }
+    for (item_id id = 1; id < ast->len.items; id += 1) {
+        if (not check_item(ast, ast_item(ast, id), name_count, token_count)) { return false; }
+    }
+    return true;
+}
+
+
+// ------- //
+// Loading //
+// ------- //
+typedef struct CacheReader {
+    const u8* data;
+    usize remaining;
+} CacheReader;
+
+// null when the file is too short
+static const void* read_section(CacheReader* reader, usize size) {
+    usize padded = (size + ASTCACHE_ALIGNMENT - 1) & ~(usize)(ASTCACHE_ALIGNMENT - 1);
+    if (padded > reader->remaining) { return null; }
+
+    const void* section = reader->data;
+    reader->data += padded;
+    reader->remaining -= padded;
+    return section;
+}
+
+#define read_pool(reader, ast, pool, count) do { \
+        const void* section = read_section((reader), sizeof(*(ast)->pool) * (count)); \
+        if (section == null) { return false; } \
+        if ((count) > 0) { \
+            memcpy(ast_extend((ast), pool, (count)), section, sizeof(*(ast)->pool) * (count)); \
+        } \
+    } while (0)
+
+static bool load_file(Module* module, AstCacheHeader* expected, String contents) {
+    CacheReader reader = { (const u8*)contents.ptr, contents.len };
+
+    const AstCacheHeader* header = read_section(&reader, sizeof(AstCacheHeader));
+    if (header == null) { return false; }
+
+    AstCacheHeader found = *header;
+    if (
+        memcmp(found.magic, expected->magic, sizeof(found.magic)) != 0 or
+        memcmp(found.version, expected->version, sizeof(found.version)) != 0 or
+        found.format != expected->format or
+        found.key != expected->key or
+        found.source_len != expected->source_len or
+        found.lazy_bodies != expected->lazy_bodies or
+        found.checksum != hash_payload(reader.data, reader.remaining)
+    ) {
+        return false;
+    }
+
+    // interning the names in the same order hands out the same ids
+    const AstSpan* names = read_section(&reader, sizeof(AstSpan) * found.names);
+    if (names == null) { return false; }
+    for (usize i = 0; i < found.names; i += 1) {
+        AstSpan span = names[i];
+        if ((u64)span.start + span.len > module->source.len) { return false; }
+
+        String name = str_slice(module->source.ptr + span.start, span.len);
+        if (intern_string(&module->names, name) != i + 1) { return false; }
+    }
+
+    if (found.tokens > 0) {
+        const u8* kinds = read_section(&reader, sizeof(u8) * found.tokens);
+        const u32* starts = read_section(&reader, sizeof(u32) * found.tokens);
+        const u32* lengths = read_section(&reader, sizeof(u32) * found.tokens);
+        const symbol_id* symbols = read_section(&reader, sizeof(symbol_id) * found.tokens);
+        if (kinds == null or starts == null or lengths == null or symbols == null) { return false; }
+
+        TokenList* tokens = &module->tokens;
+        for (usize i = 0; i < found.tokens; i += 1) {
+            usize index = token_list_push(tokens, kinds[i], starts[i]);
+            tokens->lengths[index] = lengths[i];
+            tokens->symbols[index] = symbols[i];
+        }
+    }
+
+    Ast* ast = &module->ast;
+    read_pool(&reader, ast, exprs, found.exprs);
+    read_pool(&reader, ast, stmts, found.stmts);
+    read_pool(&reader, ast, types, found.types);
+    read_pool(&reader, ast, items, found.items);
+    read_pool(&reader, ast, asms, found.asms);
+    read_pool(&reader, ast, extra, found.extra);
+
+    return check_ast(module);
+}
+
+bool astcache_load(Module* module, AstCache* cache) {
+    AstCacheHeader expected;
+    fill_header(&expected, module, cache);
+
+    char path[4096];
+    if (not cache_path(path, sizeof(path), cache, expected.key)) { return false; }
+
+    FileView file;
+    if (not file_open(path, &file)) { return false; }
+
+    bool loaded = load_file(module, &expected, file.contents);
+    file_close(&file);
+
+    // a file that doesn't match leaves a half filled module behind, start
+    // over with a clean one
+    if (not loaded) {
+        String path = module->path;
+        String source = module->source;
+        module_deinit(module);
+        module_init(module, path, source);
+    }
+
+    return loaded;
+}
@@ -0,0 +1,20 @@
+#ifndef ASTCACHE_H
+#define ASTCACHE_H
+
+#include "module.h"
+
+
+// parsed asts are kept on disk, keyed by a hash of the source, the compiler
+// version and the parse options that change the ast. a hit fills in the
+// module's names and ast (and tokens, when fn bodies are left to be parsed
+// later) so lexing and parsing can be skipped.
+typedef struct AstCache {
+    const char* directory;
+    bool lazy_bodies;
+} AstCache;
+
+bool astcache_load(Module* module, AstCache* cache);
+// the module has to be freshly parsed, without errors
+void astcache_store(Module* module, AstCache* cache);
+
+#endif // !ASTCACHE_H
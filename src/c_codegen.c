@@ -1,23 +1,18 @@
 #include "c_codegen.h"
 
 #include "ast.h"
+#include "callgraph.h"
+#include "consteval.h"
 #include "parser.h"
 #include "os.h"
 
 #include <chnlib/strbuffer.h>
 #include <chnlib/str.h>
 #include <chnlib/logger.h>
-#include <chnlib/map.h>
+#include <stdint.h>
 #include <stdio.h>
 
 
-typedef struct CodegenContext {
-    StrBuffer strbuf;
-    Module* module;
-    usize indent_level;
-} CodegenContext;
-
-
 void write_indent(CodegenContext* context) {
     for (usize i = 0; i < context->indent_level; i++) {
 	strbuf_print_lit(&context->strbuf, "    ");
@@ -30,21 +25,24 @@ void write_newline(CodegenContext* context) {
 }
 
 // TODO: this feels hacky
-static String new_tmp_var(void) {
-    static usize tmp_var_counter = 0;
+static String new_tmp_var(CodegenContext* context) {
+    return arena_format(&context->module->arena, "__sil__tmp_var_%zu", context->tmp_var_counter++);
+}
 
-    StrBuffer buf = strbuf_init();
-    strbuf_printf(&buf, "__sil__tmp_var_%zu", tmp_var_counter++);
+static String name_of(CodegenContext* context, symbol_id name) {
+    return intern_get(&context->module->names, name);
+}
 
-    return strbuf_to_string(&buf);
+static String span_of(CodegenContext* context, AstSpan span) {
+    return ast_span(context->ast, span);
 }
 
-static void generate_statement(CodegenContext* context, Stmt* statement);
-static void generate_expression(CodegenContext* context, Expr* expression);
-static void generate_expression_with_block(CodegenContext* context, Expr* expression, String* bind);
+static void generate_statement(CodegenContext* context, stmt_id statement);
+static void generate_expression(CodegenContext* context, expr_id expression);
+static void generate_expression_with_block(CodegenContext* context, expr_id expression, String* bind);
 
 static void generate_type(CodegenContext* context, type_id type) {
-    TypeEntry* type_entry = &context->module->type_table.types[type];
+    TypeEntry* type_entry = typetable_get(&context->module->type_table, type);
     switch (type_entry->kind) {
         case TypeEntryKind_Invalid: { sil_panic("generating invalid type"); }
         case TypeEntryKind_Void: { strbuf_print_lit(&context->strbuf, "void"); break; }
@@ -56,17 +54,37 @@ static void generate_type(CodegenContext* context, type_id type) {
         }
         case TypeEntryKind_Bool: { strbuf_print_lit(&context->strbuf, "bool"); break; }
         case TypeEntryKind_Int: {
-            strbuf_printf(&context->strbuf, "%c%zu", type_entry->integral.is_signed ? 'i' : 'u', type_entry->bits);
+            strbuf_printf(&context->strbuf, "%c%u", type_entry->integral.is_signed ? 'i' : 'u', (unsigned)type_entry->bits);
             break;
         }
         case TypeEntryKind_Size: {
             strbuf_printf(&context->strbuf, "%csize", type_entry->integral.is_signed ? 'i' : 'u');
             break;
         }
+        // typeof keeps the declarator in one piece, the name goes after it
+        case TypeEntryKind_Fn: {
+            TypeFn fn = type_entry->fn;
+            strbuf_print_lit(&context->strbuf, "__typeof__(");
+            generate_type(context, fn.returns);
+            strbuf_print_lit(&context->strbuf, " (*)(");
+            if (fn.parameters == 0) {
+                strbuf_print_lit(&context->strbuf, "void");
+            }
+            for (type_id parameter = fn.parameters; parameter != 0;) {
+                TypeFnParam param = typetable_get(&context->module->type_table, parameter)->fn_param;
+                generate_type(context, param.type);
+                if (param.next != 0) { strbuf_print_lit(&context->strbuf, ", "); }
+                parameter = param.next;
+            }
+            strbuf_print_lit(&context->strbuf, "))");
+            break;
+        }
+        case TypeEntryKind_FnParam: { sil_panic("generating a fn parameter as a type"); }
     }
 }
 
-static void generate_type_old(CodegenContext* context, Ast_Type* type) {
+static void generate_type_old(CodegenContext* context, ast_type_id type_node) {
+    Ast_Type* type = ast_type(context->ast, type_node);
     switch (type->kind) {
         case TypeKind_Void: {
             strbuf_print_lit(&context->strbuf, "void");
@@ -79,7 +97,7 @@ static void generate_type_old(CodegenContext* context, Ast_Type* type) {
         }
 
         case TypeKind_Symbol: {
-            strbuf_print_str(&context->strbuf, type->symbol);
+            strbuf_print_str(&context->strbuf, name_of(context, type->symbol));
             break;
         }
 
@@ -89,25 +107,46 @@ static void generate_type_old(CodegenContext* context, Ast_Type* type) {
             break;
         }
 
+        case TypeKind_Fn: {
+            ast_type_id* parameters = ast_list(context->ast, type->fn.parameters, ast_type_id);
+            strbuf_print_lit(&context->strbuf, "__typeof__(");
+            generate_type_old(context, type->fn.return_type);
+            strbuf_print_lit(&context->strbuf, " (*)(");
+            if (type->fn.parameters.len == 0) {
+                strbuf_print_lit(&context->strbuf, "void");
+            }
+            for (usize i = 0; i < type->fn.parameters.len; i += 1) {
+                if (i > 0) { strbuf_print_lit(&context->strbuf, ", "); }
+                generate_type_old(context, parameters[i]);
+            }
+            strbuf_print_lit(&context->strbuf, "))");
+            break;
+        }
+
         default: sil_panic("Unhandled silic->c type");
     }
 }
 
-static void generate_block(CodegenContext* context, Expr* block_expr, String* bind) {
-    Block* block = block_expr->block;
+static void generate_block(CodegenContext* context, expr_id block_id, String* bind) {
+    Expr* block_expr = ast_expr(context->ast, block_id);
+    Block* block = &block_expr->block;
+    stmt_id* statements = ast_list(context->ast, block->statements, stmt_id);
 
     strbuf_print_lit(&context->strbuf, "{\n");
     context->indent_level += 1;
 
-    for (usize i = 0; i < dynarray_len(block->statements) - 1; i++) {
-        Stmt* statement = block->statements[i];
+    for (usize i = 0; i < block->statements.len - 1; i++) {
         write_indent(context);
-        generate_statement(context, statement);
+        generate_statement(context, statements[i]);
     }
 
-    Stmt* last_stmt = block->statements[dynarray_len(block->statements) - 1];
-    if (block_expr->codegen.type != TypeEntryKind_Void) {
-        write_indent(context);
+    stmt_id last_id = statements[block->statements.len - 1];
+    Stmt* last_stmt = ast_stmt(context->ast, last_id);
+    write_indent(context);
+    if (block_expr->codegen.type == context->module->primitives.entry_void) {
+        // nothing to hand out
+        generate_statement(context, last_id);
+    } else {
         if (last_stmt->kind == StmtKind_NakedExpr) {
             // naked expressions don't have blocks
             if (bind == null) {
@@ -120,9 +159,9 @@ static void generate_block(CodegenContext* context, Expr* block_expr, String* bi
                 strbuf_print_lit(&context->strbuf, ";\n");
             }
 
-        } else if (should_remove_statement_semi(last_stmt->expression)) {
+        } else if (should_remove_statement_semi(ast_expr(context->ast, last_stmt->expression))) {
             // block expression
-            String tmp_eval = new_tmp_var();
+            String tmp_eval = new_tmp_var(context);
             generate_type(context, block_expr->codegen.type);
             strbuf_printf(&context->strbuf, " %.*s;", str_format(tmp_eval));
             write_newline(context);
@@ -135,11 +174,9 @@ static void generate_block(CodegenContext* context, Expr* block_expr, String* bi
                 strbuf_printf(&context->strbuf, "return %.*s;\n", str_format(tmp_eval));
             }
 
-            str_deinit(tmp_eval);
-
         } else {
             // plain statement
-            generate_statement(context, last_stmt);
+            generate_statement(context, last_id);
         }
     }
 
@@ -149,10 +186,10 @@ static void generate_block(CodegenContext* context, Expr* block_expr, String* bi
 }
 
 static void generate_number_literal(CodegenContext* context, NumberLit* number_literal) {
-    strbuf_print_str(&context->strbuf, number_literal->span);
+    strbuf_print_str(&context->strbuf, span_of(context, number_literal->span));
 }
 
-static void generate_binop(CodegenContext* context, BinOp* binop) {
+static void generate_binop_prefix(CodegenContext* context, BinOp* binop) {
     switch (binop->kind) {
         case BinOpKind_CmpEq: strbuf_print_lit(&context->strbuf, "eqi32("); break;
         case BinOpKind_CmpNotEq: strbuf_print_lit(&context->strbuf, "neqi32("); break;
@@ -167,43 +204,68 @@ static void generate_binop(CodegenContext* context, BinOp* binop) {
 	case BinOpKind_Div: strbuf_print_lit(&context->strbuf, "divi32("); break;
         default: sil_panic("Codegen error: Unhandled binary operator %d", binop->kind);
     }
+}
 
-    generate_expression(context, binop->left);
-    strbuf_print_lit(&context->strbuf, ", ");
-    generate_expression(context, binop->right);
-    strbuf_print_lit(&context->strbuf, ")");
+// left-deep chains (a + b + c ...) are opened from the outside in, then the
+// right operands are closed off from the inside out
+static void generate_binop(CodegenContext* context, expr_id expression) {
+    ExprStack chain;
+    expr_stack_init(&chain);
+
+    expr_id left = expression;
+    while (ast_expr(context->ast, left)->kind == ExprKind_BinOp) {
+        BinOp* binop = &ast_expr(context->ast, left)->binary_operator;
+        generate_binop_prefix(context, binop);
+        expr_stack_push(&chain, left);
+        left = binop->left;
+    }
+
+    generate_expression(context, left);
+    while (chain.len > 0) {
+        BinOp* binop = &ast_expr(context->ast, expr_stack_pop(&chain))->binary_operator;
+        strbuf_print_lit(&context->strbuf, ", ");
+        generate_expression(context, binop->right);
+        strbuf_print_lit(&context->strbuf, ")");
+    }
+
+    expr_stack_deinit(&chain);
 }
 
 static void generate_asm(CodegenContext* context, Asm* asm, String* output) {
-    String tmp_output = new_tmp_var();
-    for (usize i = 0; i < dynarray_len(asm->outputs); i += 1) {
+    AstSpan* outputs = ast_list(context->ast, asm->outputs, AstSpan);
+    AstSpan* source = ast_list(context->ast, asm->source, AstSpan);
+    AsmInput* inputs = ast_list(context->ast, asm->inputs, AsmInput);
+    AstSpan* clobbers = ast_list(context->ast, asm->clobbers, AstSpan);
+
+    String tmp_output = new_tmp_var(context);
+    for (usize i = 0; i < asm->outputs.len; i += 1) {
         strbuf_printf(&context->strbuf, "isize %.*s;\n", str_format(tmp_output));
     }
 
     write_indent(context);
     strbuf_print_lit(&context->strbuf, "__asm__ volatile (");
-    for (usize i = 0; i < dynarray_len(asm->source); i += 1) {
-        strbuf_print_str(&context->strbuf, asm->source[i].span);
+    for (usize i = 0; i < asm->source.len; i += 1) {
+        strbuf_print_str(&context->strbuf, span_of(context, source[i]));
     }
 
     strbuf_print_lit(&context->strbuf, ":");
 
     // HACK: only one output rn
-    strbuf_printf(&context->strbuf, "\"=%.*s\"(%.*s):", str_format(asm->outputs[0]), str_format(tmp_output));
+    strbuf_printf(&context->strbuf, "\"=%.*s\"(%.*s):", str_format(span_of(context, outputs[0])), str_format(tmp_output));
 
-    for (usize i = 0; i < dynarray_len(asm->inputs); i += 1) {
+    for (usize i = 0; i < asm->inputs.len; i += 1) {
         if (i > 0) { strbuf_print_lit(&context->strbuf, ","); }
 
-        strbuf_printf(&context->strbuf, "\"%.*s\"(", str_format(asm->inputs[i].reg));
-        generate_expression(context, asm->inputs[i].val);
+        strbuf_printf(&context->strbuf, "\"%.*s\"(", str_format(span_of(context, inputs[i].reg)));
+        generate_expression(context, inputs[i].val);
         strbuf_print_lit(&context->strbuf, ")");
     }
 
     strbuf_print_lit(&context->strbuf, ":");
 
-    for (usize i = 0; i < dynarray_len(asm->clobbers); i += 1) {
+    for (usize i = 0; i < asm->clobbers.len; i += 1) {
         if (i > 0) { strbuf_print_lit(&context->strbuf, ","); }
-        strbuf_printf(&context->strbuf, "\"%.*s\"", str_format(asm->clobbers[i]));
+        strbuf_printf(&context->strbuf, "\"%.*s\"", str_format(span_of(context, clobbers[i])));
     }
 
     strbuf_print_lit(&context->strbuf, ");");
@@ -215,15 +277,17 @@ static void generate_asm(CodegenContext* context, Asm* asm, String* output) {
     }
 }
 
-static void generate_expression_with_block(CodegenContext* context, Expr* expression, String* bind) {
+static void generate_expression_with_block(CodegenContext* context, expr_id expression_id, String* bind) {
+    Ast* ast = context->ast;
+    Expr* expression = ast_expr(ast, expression_id);
     switch (expression->kind) {
 	case ExprKind_NumberLit: {
-	    generate_number_literal(context, expression->number_literal);
+	    generate_number_literal(context, &expression->number_literal);
 	    break;
 	}
 
 	case ExprKind_StringLit: {
-	    strbuf_print_str(&context->strbuf, expression->string_literal.span);
+	    strbuf_print_str(&context->strbuf, span_of(context, expression->string_literal.span));
 	    break;
 	}
 
@@ -233,20 +297,32 @@ static void generate_expression_with_block(CodegenContext* context, Expr* expres
         }
 
 	case ExprKind_Symbol: {
-            strbuf_printf(&context->strbuf, "%.*s", str_format(expression->symbol));
+            strbuf_print_str(&context->strbuf, name_of(context, expression->symbol));
 	    break;
 	}
 
-	case ExprKind_FnCall: {
-	    FnCall* call = expression->fn_call;
-
-	    strbuf_printf(&context->strbuf, "%.*s(", str_format(call->name));
+	// an indirect call is written the same, through the local holding
+	// the pointer
+	case ExprKind_FnCall:
+	case ExprKind_IndirectCall: {
+	    FnCall* call = &expression->fn_call;
+	    expr_id* arguments = ast_list(ast, call->arguments, expr_id);
+
+	    symbol_id callee = call->name;
+	    item_id callee_item = module_get_item(context->module, callee);
+	    if (
+		expression->kind == ExprKind_FnCall and
+		callee_item != 0 and ast_item(ast, callee_item)->kind == ItemKind_FnDef
+	    ) {
+		item_id folded_into = ast_item(ast, callee_item)->fn_definition.folded_into;
+		if (folded_into != 0) { callee = ast_item(ast, folded_into)->name; }
+	    }
+	    strbuf_printf(&context->strbuf, "%.*s(", str_format(name_of(context, callee)));
 
-	    for (usize i = 0; i < dynarray_len(call->arguments); i++) {
+	    for (usize i = 0; i < call->arguments.len; i++) {
                 if (i > 0) { strbuf_print_lit(&context->strbuf, ","); }
 
-		Expr* arg = call->arguments[i];
-		generate_expression(context, arg);
+		generate_expression(context, arguments[i]);
 	    }
 
 	    strbuf_print_lit(&context->strbuf, ")");
@@ -255,18 +331,19 @@ static void generate_expression_with_block(CodegenContext* context, Expr* expres
 	}
 
 	case ExprKind_Let: {
+            String name = name_of(context, expression->let.name);
             generate_type(context, expression->codegen.type);
 
-            if (should_remove_statement_semi(expression->let->value)) {
-                strbuf_printf(&context->strbuf, " %.*s;\n", str_format(expression->let->name));
+            if (should_remove_statement_semi(ast_expr(ast, expression->let.value))) {
+                strbuf_printf(&context->strbuf, " %.*s;\n", str_format(name));
                 write_indent(context);
-                generate_expression_with_block(context, expression->let->value, &expression->let->name);
+                generate_expression_with_block(context, expression->let.value, &name);
 
                 break;
             }
 
-	    strbuf_printf(&context->strbuf, " %.*s = ", str_format(expression->let->name));
-	    generate_expression(context, expression->let->value);
+	    strbuf_printf(&context->strbuf, " %.*s = ", str_format(name));
+	    generate_expression(context, expression->let.value);
 
 	    break;
 	}
@@ -279,42 +356,53 @@ static void generate_expression_with_block(CodegenContext* context, Expr* expres
 	}
 
 	case ExprKind_Block: {
-	    generate_block(context, expression, bind);
+	    generate_block(context, expression_id, bind);
 	    break;
 	}
 
         case ExprKind_BinOp: {
-            generate_binop(context, expression->binary_operator);
+            generate_binop(context, expression_id);
             break;
         }
 
 	case ExprKind_If: {
-	    strbuf_print_lit(&context->strbuf, "if (");
-	    generate_expression(context, expression->if_expr->condition);
-	    strbuf_print_lit(&context->strbuf, ") ");
-	    generate_expression_with_block(context, expression->if_expr->then, bind);
-	    if (expression->if_expr->otherwise != null) {
+	    // else if ladders are written out in a loop
+	    If* if_expr = &expression->if_expr;
+	    while (true) {
+		strbuf_print_lit(&context->strbuf, "if (");
+		generate_expression(context, if_expr->condition);
+		strbuf_print_lit(&context->strbuf, ") ");
+		generate_expression_with_block(context, if_expr->then, bind);
+		if (if_expr->otherwise == 0) { break; }
+
 		strbuf_print_lit(&context->strbuf, " else ");
-		generate_expression_with_block(context, expression->if_expr->otherwise, bind);
+		Expr* otherwise = ast_expr(ast, if_expr->otherwise);
+		if (otherwise->kind != ExprKind_If) {
+		    generate_expression_with_block(context, if_expr->otherwise, bind);
+		    break;
+		}
+
+		if_expr = &otherwise->if_expr;
 	    }
 
 	    break;
 	}
 
 	case ExprKind_Match: {
-	    Match* match = expression->match;
+	    Match* match = &expression->match;
+	    MatchArm* arms = ast_list(ast, match->arms, MatchArm);
 	    strbuf_print_lit(&context->strbuf, "switch (");
-	    generate_expression_with_block(context, expression->match->condition, bind);
+	    generate_expression_with_block(context, expression->match.condition, bind);
 	    strbuf_print_lit(&context->strbuf, ") {\n");
 	    context->indent_level += 1;
-	    for (usize i = 0; i < dynarray_len(match->arms); i++) {
-		MatchArm* arm = match->arms[i];
+	    for (usize i = 0; i < match->arms.len; i++) {
+		MatchArm* arm = &arms[i];
 		write_indent(context);
 		strbuf_print_lit(&context->strbuf, "case ");
-		generate_number_literal(context, arm->pattern);
+		generate_number_literal(context, &arm->pattern);
 		strbuf_print_lit(&context->strbuf, ": ");
 		generate_expression_with_block(context, arm->then, bind);
-		if (arm->then->kind != ExprKind_Block) {
+		if (ast_expr(ast, arm->then)->kind != ExprKind_Block) {
 		    strbuf_print_lit(&context->strbuf, "; break;");
 		} else {
 		    strbuf_print_lit(&context->strbuf, " break;");
@@ -329,7 +417,7 @@ static void generate_expression_with_block(CodegenContext* context, Expr* expres
 
         case ExprKind_Loop: {
             strbuf_print_lit(&context->strbuf, "while (true) ");
-            generate_expression_with_block(context, expression->loop->body, bind);
+            generate_expression_with_block(context, expression->loop.body, bind);
             break;
         }
 
@@ -338,15 +426,15 @@ static void generate_expression_with_block(CodegenContext* context, Expr* expres
         case ExprKind_Unreachable: { strbuf_print_lit(&context->strbuf, "/* unreachable */"); break; }
 
         case ExprKind_Asm: {
-            generate_asm(context, expression->asm, bind);
+            generate_asm(context, ast_asm(ast, expression->asm), bind);
             break;
         }
 
         case ExprKind_Cast: {
             strbuf_print_lit(&context->strbuf, "(");
-            generate_type_old(context, expression->cast->to);
+            generate_type_old(context, expression->cast.to);
             strbuf_print_lit(&context->strbuf, ")");
-            generate_expression(context, expression->cast->expr);
+            generate_expression(context, expression->cast.expr);
             break;
         }
 
@@ -354,56 +442,139 @@ static void generate_expression_with_block(CodegenContext* context, Expr* expres
     }
 }
 
-static void generate_expression(CodegenContext* context, Expr* expression) {
+static void generate_expression(CodegenContext* context, expr_id expression) {
     generate_expression_with_block(context, expression, null);
 }
 
-static void generate_statement(CodegenContext* context, Stmt* statement) {
+static void generate_statement(CodegenContext* context, stmt_id statement_id) {
+    Stmt* statement = ast_stmt(context->ast, statement_id);
     switch (statement->kind) {
         case StmtKind_Expr:
         case StmtKind_NakedExpr:
             generate_expression(context, statement->expression);
-            strbuf_printf(&context->strbuf, "%s\n", should_remove_statement_semi(statement->expression) ? "" : ";");
+            strbuf_printf(&context->strbuf, "%s\n", should_remove_statement_semi(ast_expr(context->ast, statement->expression)) ? "" : ";");
     }
 }
 
 static void generate_fn_signature(CodegenContext* context, Item* item) {
     FnSig* signature;
+    FnPurity purity;
     if (item->kind == ItemKind_FnDef) {
-	signature = item->fn_definition->signature;
+	signature = &item->fn_definition.signature;
+	purity = item->fn_definition.purity;
     } else if (item->kind == ItemKind_ExternFn) {
-	signature = item->extern_fn->signature;
+	signature = &item->extern_fn.signature;
+	purity = item->extern_fn.purity;
     } else {
 	sil_panic("Cannot generate signature for item type %d", item->kind);
     }
 
+    // lets gcc merge repeated calls and hoist them out of loops. a call
+    // that returns nothing is only there for its side effects.
+    Ast_TypeKind return_kind = ast_type(context->ast, signature->return_type)->kind;
+    if (return_kind != TypeKind_Void and return_kind != TypeKind_Never) {
+	switch (purity) {
+	    case FnPurity_Const: strbuf_print_lit(&context->strbuf, "__attribute__((const)) "); break;
+	    case FnPurity_Pure: strbuf_print_lit(&context->strbuf, "__attribute__((pure)) "); break;
+	    default: break;
+	}
+    }
+
     generate_type_old(context, signature->return_type);
 
-    strbuf_printf(&context->strbuf, " %.*s(", str_format(item->name));
+    strbuf_printf(&context->strbuf, " %.*s(", str_format(name_of(context, item->name)));
 
     // void as empty parameters
-    if (dynarray_len(signature->parameters) == 0) {
+    if (signature->parameters.len == 0) {
         strbuf_print_lit(&context->strbuf, "void");
     }
-    for (usize i = 0; i < dynarray_len(signature->parameters); i++) {
+    FnParam* parameters = ast_list(context->ast, signature->parameters, FnParam);
+    for (usize i = 0; i < signature->parameters.len; i++) {
         if (i > 0) { strbuf_print_lit(&context->strbuf, ", "); }
-	FnParam* parameter = signature->parameters[i];
+	FnParam* parameter = &parameters[i];
 	generate_type_old(context, parameter->type);
-	strbuf_printf(&context->strbuf, " const %.*s", str_format(parameter->name));
+	if (parameter->alias != ParamAlias_Maybe) {
+	    strbuf_print_lit(&context->strbuf, " restrict");
+	}
+	strbuf_printf(&context->strbuf, " const %.*s", str_format(name_of(context, parameter->name)));
     }
 
     strbuf_print_lit(&context->strbuf, ")");
 }
 
+static void generate_const_value(CodegenContext* context, type_id type, ConstValue* value) {
+    switch (value->kind) {
+        case ConstValueKind_Int: {
+            TypeEntry* type_entry = typetable_get(&context->module->type_table, type);
+            if (type_entry->integral.is_signed) {
+                i64 integer = (i64)value->integer;
+                // the literal would be too big to negate
+                if (integer == INT64_MIN) {
+                    strbuf_print_lit(&context->strbuf, "(-9223372036854775807 - 1)");
+                } else {
+                    strbuf_printf(&context->strbuf, "%lld", (long long)integer);
+                }
+            } else {
+                strbuf_printf(&context->strbuf, "%llu", (unsigned long long)value->integer);
+                if (value->integer > INT64_MAX) {
+                    strbuf_print_lit(&context->strbuf, "u");
+                }
+            }
+            break;
+        }
+        case ConstValueKind_Bool: {
+            strbuf_printf(&context->strbuf, "%s", value->boolean ? "true" : "false");
+            break;
+        }
+        case ConstValueKind_Str: {
+            strbuf_print_str(&context->strbuf, span_of(context, value->string));
+            break;
+        }
+        // fns used as values are never folded away
+        case ConstValueKind_Fn: {
+            strbuf_print_str(&context->strbuf, name_of(context, ast_item(context->ast, value->fn)->name));
+            break;
+        }
+        default: sil_panic("Codegen Error: constant without a value");
+    }
+}
+
 static void generate_definition(CodegenContext* context, Item* item) {
+    if (not item->reachable) { return; }
+
     switch (item->kind) {
 	case ItemKind_FnDef:
+	    if (item->fn_definition.body == 0) { return; }
+	    if (item->fn_definition.folded_into != 0 and not callgraph_is_root(context->module, item)) { return; }
 	    if (!item->visibility.is_pub) {
 		strbuf_print_lit(&context->strbuf, "static ");
 	    }
+
+	    // an entry point keeps its symbol, as another name for the fn it
+	    // was folded into
+	    if (item->fn_definition.folded_into != 0) {
+		generate_fn_signature(context, item);
+		strbuf_printf(
+		    &context->strbuf,
+		    " __attribute__((alias(\"%.*s\")));\n\n",
+		    str_format(name_of(context, ast_item(context->ast, item->fn_definition.folded_into)->name))
+		);
+		break;
+	    }
+	    // the declaration before it isn't inline, so a pub fn still gets
+	    // its external definition
+	    switch (item->fn_definition.inlining) {
+		case FnInline_Always:
+		    strbuf_print_lit(&context->strbuf, "inline __attribute__((always_inline)) ");
+		    break;
+		case FnInline_Never:
+		    strbuf_print_lit(&context->strbuf, "__attribute__((noinline)) ");
+		    break;
+		default: break;
+	    }
 	    generate_fn_signature(context, item);
 	    strbuf_print_lit(&context->strbuf, " ");
-	    generate_block(context, item->fn_definition->body, null);
+	    generate_block(context, item->fn_definition.body, null);
 	    strbuf_print_lit(&context->strbuf, "\n\n");
 	    break;
 	
@@ -413,9 +584,25 @@ static void generate_definition(CodegenContext* context, Item* item) {
 
 static void generate_forward_declarations(CodegenContext* context) {
     {
-        MapIter iter = map_iter(context->module->items);
-        while (map_next(context->module->items, iter)) {
-            Item* item = map_iter_val(context->module->items, iter);
+        for (usize i = 0; i < dynarray_len(context->module->items); i += 1) {
+            if (context->module->items[i] == 0) { continue; }
+            Item* item = ast_item(context->ast, context->module->items[i]);
+            if (not item->reachable) { continue; }
+
+            // never called, so never parsed
+            if (
+                item->kind == ItemKind_FnDef and item->fn_definition.body == 0 and
+                not context->declare_unparsed
+            ) {
+                continue;
+            }
+            // calls go to what it was folded into
+            if (
+                item->kind == ItemKind_FnDef and item->fn_definition.folded_into != 0 and
+                not callgraph_is_root(context->module, item)
+            ) {
+                continue;
+            }
 
             if (item->kind != ItemKind_ExternFn and !item->visibility.is_pub) {
                 strbuf_print_lit(&context->strbuf, "static ");
@@ -428,39 +615,73 @@ static void generate_forward_declarations(CodegenContext* context) {
     strbuf_print_lit(&context->strbuf, "\n");
 
     {
-        Map(SymEntry) root_syms = context->module->symbol_table.root_scope.symbols;
-        MapIter iter = map_iter(root_syms);
-        while (map_next(root_syms, iter)) {
-            String key = map_iter_key(iter);
-            SymEntry* entry = map_iter_val_ref(root_syms, iter);
-
+        // no scope is open, so these are all in the root scope. they were
+        // evaluated by the analyzer and go in rodata as literals, the ones
+        // it couldn't evaluate are left to gcc.
+        SymTable* symbol_table = &context->module->symbol_table;
+        for (usize i = 0; i < symbol_table->binding_count; i += 1) {
+            String key = name_of(context, symbol_table->bindings[i].name);
+            SymEntry* entry = &symbol_table->bindings[i].entry;
+            if (not entry->reachable) { continue; }
+
+            strbuf_print_lit(&context->strbuf, "static ");
             generate_type(context, entry->type);
-            strbuf_printf(&context->strbuf, " %.*s = ", str_format(key));
-            generate_expression(context, entry->expression);
+            strbuf_printf(&context->strbuf, " const %.*s = ", str_format(key));
+            ConstValue* value = consteval_get(context->module, entry->value);
+            if (value->kind == ConstValueKind_Void) {
+                generate_expression(context, entry->expression);
+            } else {
+                generate_const_value(context, entry->type, value);
+            }
             strbuf_print_lit(&context->strbuf, ";\n");
         }
     }
 }
 
-static void generate_ast(CodegenContext* context, AstRoot* ast) {
+static void generate_ast(CodegenContext* context, Ast* ast) {
     generate_forward_declarations(context);
 
     strbuf_print_lit(&context->strbuf, "\n");
 
-    for (usize i = 0; i < dynarray_len(ast->items); i++) {
-	Item* item = ast->items[i];
-	generate_definition(context, item);
+    for (item_id id = 1; id <= ast_item_count(ast); id++) {
+	generate_definition(context, ast_item(ast, id));
     }
 }
 
+// hands over what has been generated so far and starts a new buffer
+static String take_output(CodegenContext* context) {
+    String output = strbuf_to_string(&context->strbuf);
+    context->strbuf = strbuf_init();
+    return output;
+}
+
+void c_codegen_init(CodegenContext* context, Module* module) {
+    context->indent_level = 0;
+    context->tmp_var_counter = 0;
+    context->module = module;
+    context->ast = &module->ast;
+    context->strbuf = strbuf_init();
+    context->declare_unparsed = false;
+}
+
 String c_codegen_generate(Module* module) {
     CodegenContext context;
-    context.indent_level = 0;
-    context.module = module;
-    context.strbuf = strbuf_init();
+    c_codegen_init(&context, module);
 
-    generate_ast(&context, module->ast);
+    generate_ast(&context, &module->ast);
 
     return strbuf_to_string(&context.strbuf);
 }
 
+String c_codegen_declarations(CodegenContext* context) {
+    generate_forward_declarations(context);
+    strbuf_print_lit(&context->strbuf, "\n");
+
+    return take_output(context);
+}
+
+String c_codegen_definition(CodegenContext* context, item_id item) {
+    generate_definition(context, ast_item(context->ast, item));
+
+    return take_output(context);
+}
@@ -3,7 +3,25 @@
 
 #include "module.h"
 #include <chnlib/str.h>
+#include <chnlib/strbuffer.h>
+
+typedef struct CodegenContext {
+    StrBuffer strbuf;
+    Module* module;
+    Ast* ast;
+    usize indent_level;
+    usize tmp_var_counter;
+    // every fn gets declared, parsed or not, its body will be by the time
+    // its definition is generated
+    bool declare_unparsed;
+} CodegenContext;
 
 String c_codegen_generate(Module* module);
 
+// for generating one item at a time. the declarations come first, then the
+// definitions in item order. each call hands back the text it generated.
+void c_codegen_init(CodegenContext* context, Module* module);
+String c_codegen_declarations(CodegenContext* context);
+String c_codegen_definition(CodegenContext* context, item_id item);
+
 #endif
@@ -0,0 +1,1785 @@
+#include "callgraph.h"
+
+#include "ast.h"
+#include "consteval.h"
+#include "os.h"
+#include <chnlib/dynarray.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iso646.h>
+
+
+static bool is_named(Module* module, symbol_id name, const char* text) {
+    String string = intern_get(&module->names, name);
+    usize len = strlen(text);
+    return string.len == len and memcmp(string.ptr, text, len) == 0;
+}
+
+bool callgraph_is_root(Module* module, Item* item) {
+    return (
+        item->visibility.is_pub or
+        is_named(module, item->name, "main") or
+        is_named(module, item->name, "_start")
+    );
+}
+
+// a fn whose body is written out
+static bool is_emitted_fn(Item* item) {
+    return item->kind == ItemKind_FnDef and item->reachable and item->fn_definition.body != 0;
+}
+
+
+// ---------- //
+// Body Walks //
+// ---------- //
+// bodies are walked with an explicit stack, they can nest deeper than the C
+// stack goes. the walk keeps track of the loops it's in and whether each one
+// can be left.
+typedef struct BodyWalk {
+    Ast* ast;
+    ExprStack exprs;
+    // the stack height under each loop being walked, everything above it is
+    // in that loop's body
+    usize* loops;
+    // the loop has a break or a return in it
+    bool* loop_exits;
+    usize loop_count;
+    usize loop_capacity;
+    // a loop was walked that has no way out
+    bool endless_loop;
+} BodyWalk;
+
+static void body_walk_init(BodyWalk* walk, Ast* ast) {
+    walk->ast = ast;
+    expr_stack_init(&walk->exprs);
+    walk->loops = null;
+    walk->loop_exits = null;
+    walk->loop_count = 0;
+    walk->loop_capacity = 0;
+    walk->endless_loop = false;
+}
+
+static void body_walk_deinit(BodyWalk* walk) {
+    free(walk->loops);
+    free(walk->loop_exits);
+    expr_stack_deinit(&walk->exprs);
+}
+
+static void body_walk_begin(BodyWalk* walk, expr_id body) {
+    walk->loop_count = 0;
+    walk->endless_loop = false;
+    expr_stack_push(&walk->exprs, body);
+}
+
+static bool body_walk_in_loop(BodyWalk* walk) {
+    return walk->loop_count > 0;
+}
+
+static void push_children(BodyWalk* walk, Expr* expression) {
+    Ast* ast = walk->ast;
+    ExprStack* exprs = &walk->exprs;
+
+    switch (expression->kind) {
+        case ExprKind_FnCall:
+        case ExprKind_IndirectCall: {
+            FnCall* call = &expression->fn_call;
+            expr_id* arguments = ast_list(ast, call->arguments, expr_id);
+            for (usize i = 0; i < call->arguments.len; i += 1) {
+                expr_stack_push(exprs, arguments[i]);
+            }
+            break;
+        }
+
+        case ExprKind_Block: {
+            Block* block = &expression->block;
+            stmt_id* statements = ast_list(ast, block->statements, stmt_id);
+            for (usize i = 0; i < block->statements.len; i += 1) {
+                expr_stack_push(exprs, ast_stmt(ast, statements[i])->expression);
+            }
+            break;
+        }
+
+        case ExprKind_If: {
+            If* if_expr = &expression->if_expr;
+            expr_stack_push(exprs, if_expr->condition);
+            expr_stack_push(exprs, if_expr->then);
+            if (if_expr->otherwise != 0) {
+                expr_stack_push(exprs, if_expr->otherwise);
+            }
+            break;
+        }
+
+        case ExprKind_Match: {
+            Match* match = &expression->match;
+            MatchArm* arms = ast_list(ast, match->arms, MatchArm);
+            expr_stack_push(exprs, match->condition);
+            for (usize i = 0; i < match->arms.len; i += 1) {
+                expr_stack_push(exprs, arms[i].then);
+            }
+            break;
+        }
+
+        case ExprKind_Asm: {
+            Asm* asm = ast_asm(ast, expression->asm);
+            AsmInput* inputs = ast_list(ast, asm->inputs, AsmInput);
+            for (usize i = 0; i < asm->inputs.len; i += 1) {
+                expr_stack_push(exprs, inputs[i].val);
+            }
+            break;
+        }
+
+        case ExprKind_BinOp: {
+            expr_stack_push(exprs, expression->binary_operator.left);
+            expr_stack_push(exprs, expression->binary_operator.right);
+            break;
+        }
+
+        case ExprKind_Let: expr_stack_push(exprs, expression->let.value); break;
+        case ExprKind_Loop: expr_stack_push(exprs, expression->loop.body); break;
+        case ExprKind_Ret: expr_stack_push(exprs, expression->ret); break;
+        case ExprKind_Cast: expr_stack_push(exprs, expression->cast.expr); break;
+
+        default: break;
+    }
+}
+
+// the next expression of the body, null once it's all been walked. its
+// children are walked after it.
+static Expr* body_walk_next(BodyWalk* walk) {
+    ExprStack* exprs = &walk->exprs;
+
+    while (walk->loop_count > 0 and exprs->len <= walk->loops[walk->loop_count - 1]) {
+        walk->loop_count -= 1;
+        walk->endless_loop |= not walk->loop_exits[walk->loop_count];
+    }
+    if (exprs->len == 0) { return null; }
+
+    Expr* expression = ast_expr(walk->ast, expr_stack_pop(exprs));
+    switch (expression->kind) {
+        case ExprKind_Loop: {
+            if (walk->loop_count == walk->loop_capacity) {
+                walk->loop_capacity = walk->loop_capacity * 2 + 8;
+                walk->loops = realloc(walk->loops, sizeof(usize) * walk->loop_capacity);
+                walk->loop_exits = realloc(walk->loop_exits, sizeof(bool) * walk->loop_capacity);
+            }
+            walk->loops[walk->loop_count] = exprs->len;
+            walk->loop_exits[walk->loop_count] = false;
+            walk->loop_count += 1;
+            break;
+        }
+
+        case ExprKind_Break: {
+            if (walk->loop_count > 0) { walk->loop_exits[walk->loop_count - 1] = true; }
+            break;
+        }
+
+        case ExprKind_Ret: {
+            for (usize i = 0; i < walk->loop_count; i += 1) {
+                walk->loop_exits[i] = true;
+            }
+            break;
+        }
+
+        default: break;
+    }
+
+    push_children(walk, expression);
+    return expression;
+}
+
+
+// ------------ //
+// Reachability //
+// ------------ //
+typedef struct CallGraphWalk {
+    Module* module;
+    // bodies of reachable fns and expressions of reachable constants left
+    // to gcc, that haven't been walked yet
+    DynArray(expr_id) bodies;
+    BodyWalk body;
+} CallGraphWalk;
+
+static void reach_item(CallGraphWalk* walk, item_id id) {
+    Item* item = ast_item(&walk->module->ast, id);
+    if (item->reachable) { return; }
+
+    item->reachable = true;
+    if (item->kind == ItemKind_FnDef and item->fn_definition.body != 0) {
+        dynarray_push(walk->bodies, &item->fn_definition.body);
+    }
+}
+
+// a constant and the fn it holds, or a fn used as a value. a local of the
+// same name might hide it, then it's kept for nothing.
+static void reach_symbol(CallGraphWalk* walk, symbol_id name) {
+    SymEntry* entry = symtable_get(&walk->module->symbol_table, name);
+    if (entry == null) {
+        item_id item = module_get_item(walk->module, name);
+        if (item != 0) { reach_item(walk, item); }
+        return;
+    }
+
+    if (entry->reachable) { return; }
+
+    entry->reachable = true;
+    ConstValue* value = consteval_get(walk->module, entry->value);
+    if (value->kind == ConstValueKind_Fn) { reach_item(walk, value->fn); }
+    if (value->kind == ConstValueKind_Void) { dynarray_push(walk->bodies, &entry->expression); }
+}
+
+static void walk_body(CallGraphWalk* walk, expr_id body) {
+    body_walk_begin(&walk->body, body);
+
+    Expr* expression;
+    while ((expression = body_walk_next(&walk->body)) != null) {
+        switch (expression->kind) {
+            case ExprKind_Symbol: reach_symbol(walk, expression->symbol); break;
+            case ExprKind_IndirectCall: reach_symbol(walk, expression->fn_call.name); break;
+
+            case ExprKind_FnCall: {
+                item_id item = module_get_item(walk->module, expression->fn_call.name);
+                if (item != 0) { reach_item(walk, item); }
+                break;
+            }
+
+            default: break;
+        }
+    }
+}
+
+void callgraph_mark_reachable(Module* module) {
+    CallGraphWalk walk;
+    walk.module = module;
+    walk.bodies = dynarray_init();
+    body_walk_init(&walk.body, &module->ast);
+
+    Ast* ast = &module->ast;
+    for (item_id id = 1; id <= ast_item_count(ast); id += 1) {
+        Item* item = ast_item(ast, id);
+        if (item->kind != ItemKind_Const and callgraph_is_root(module, item)) {
+            reach_item(&walk, id);
+        }
+    }
+
+    for (usize i = 0; i < dynarray_len(walk.bodies); i += 1) {
+        walk_body(&walk, walk.bodies[i]);
+    }
+
+    body_walk_deinit(&walk.body);
+    dynarray_deinit(walk.bodies);
+}
+
+void callgraph_mark_all(Module* module) {
+    Ast* ast = &module->ast;
+    for (item_id id = 1; id <= ast_item_count(ast); id += 1) {
+        ast_item(ast, id)->reachable = true;
+    }
+
+    // no scope is open, so these are all in the root scope
+    SymTable* symbol_table = &module->symbol_table;
+    for (usize i = 0; i < symbol_table->binding_count; i += 1) {
+        symbol_table->bindings[i].entry.reachable = true;
+    }
+}
+
+
+// ---------- //
+// Call Edges //
+// ---------- //
+typedef struct CallEdge {
+    item_id caller;
+    item_id callee;
+} CallEdge;
+
+// the edges grouped by one of their ends, the other ends of the edges at
+// id are ends[first[id]] up to ends[first[id + 1]]
+typedef struct EdgeIndex {
+    u32* first;
+    item_id* ends;
+} EdgeIndex;
+
+static void edge_index_init(EdgeIndex* index, CallEdge* edges, usize edge_count, usize item_count, bool by_callee) {
+    u32* first = calloc(item_count + 2, sizeof(u32));
+    item_id* ends = malloc(sizeof(item_id) * (edge_count + 1));
+    for (usize i = 0; i < edge_count; i += 1) {
+        first[(by_callee ? edges[i].callee : edges[i].caller) + 1] += 1;
+    }
+    for (usize id = 1; id <= item_count + 1; id += 1) {
+        first[id] += first[id - 1];
+    }
+    u32* filled = calloc(item_count + 1, sizeof(u32));
+    for (usize i = 0; i < edge_count; i += 1) {
+        item_id at = by_callee ? edges[i].callee : edges[i].caller;
+        ends[first[at] + filled[at]] = by_callee ? edges[i].caller : edges[i].callee;
+        filled[at] += 1;
+    }
+    free(filled);
+
+    index->first = first;
+    index->ends = ends;
+}
+
+static void edge_index_deinit(EdgeIndex* index) {
+    free(index->ends);
+    free(index->first);
+}
+
+// the call graph is split into its strongly connected components with
+// tarjan's algorithm, walked with a stack of its own like bodies are
+typedef void (*FinishComponent)(void* data, item_id* members, usize count);
+
+typedef struct TarjanState {
+    u32* order;
+    u32* low;
+    bool* on_stack;
+    // the position in the fn's edges the walk is at
+    u32* next_edge;
+    item_id* walk;
+    usize walk_len;
+    item_id* members;
+    usize member_len;
+    u32 visited;
+} TarjanState;
+
+static void tarjan_visit(TarjanState* state, item_id fn) {
+    state->visited += 1;
+    state->order[fn] = state->visited;
+    state->low[fn] = state->visited;
+    state->on_stack[fn] = true;
+    state->walk[state->walk_len++] = fn;
+    state->members[state->member_len++] = fn;
+}
+
+// hands each component of the fns to finish, after every component it
+// calls. fns is where the walk starts from, callees may lead out of it.
+static void find_components(EdgeIndex* callees, item_id* fns, usize fn_count, usize item_count, FinishComponent finish, void* data) {
+    TarjanState state = {
+        .order = calloc(item_count + 1, sizeof(u32)),
+        .low = calloc(item_count + 1, sizeof(u32)),
+        .on_stack = calloc(item_count + 1, sizeof(bool)),
+        .next_edge = calloc(item_count + 1, sizeof(u32)),
+        .walk = malloc(sizeof(item_id) * (item_count + 1)),
+        .members = malloc(sizeof(item_id) * (item_count + 1)),
+    };
+
+    for (usize i = 0; i < fn_count; i += 1) {
+        if (state.order[fns[i]] != 0) { continue; }
+
+        tarjan_visit(&state, fns[i]);
+        while (state.walk_len > 0) {
+            item_id fn = state.walk[state.walk_len - 1];
+            u32 edge = callees->first[fn] + state.next_edge[fn];
+            if (edge < callees->first[fn + 1]) {
+                state.next_edge[fn] += 1;
+                item_id callee = callees->ends[edge];
+                if (state.order[callee] == 0) {
+                    tarjan_visit(&state, callee);
+                } else if (state.on_stack[callee] and state.order[callee] < state.low[fn]) {
+                    state.low[fn] = state.order[callee];
+                }
+                continue;
+            }
+
+            state.walk_len -= 1;
+            if (state.walk_len > 0) {
+                item_id caller = state.walk[state.walk_len - 1];
+                if (state.low[fn] < state.low[caller]) { state.low[caller] = state.low[fn]; }
+            }
+            if (state.low[fn] != state.order[fn]) { continue; }
+
+            // fn's component is everything pushed since fn
+            usize first_member = state.member_len;
+            do {
+                first_member -= 1;
+                state.on_stack[state.members[first_member]] = false;
+            } while (state.members[first_member] != fn);
+            finish(data, &state.members[first_member], state.member_len - first_member);
+            state.member_len = first_member;
+        }
+    }
+
+    free(state.members);
+    free(state.walk);
+    free(state.next_edge);
+    free(state.on_stack);
+    free(state.low);
+    free(state.order);
+}
+
+// a component with more than one fn, or a fn that calls itself
+static bool is_recursive(EdgeIndex* callees, item_id* members, usize count) {
+    if (count > 1) { return true; }
+    for (u32 j = callees->first[members[0]]; j < callees->first[members[0] + 1]; j += 1) {
+        if (callees->ends[j] == members[0]) { return true; }
+    }
+    return false;
+}
+
+
+// ------ //
+// Purity //
+// ------ //
+// what the body does itself, apart from the fns it calls. calls between
+// fns with bodies are added to edges.
+static FnPurity body_purity(Module* module, BodyWalk* walk, item_id fn, DynArray(CallEdge)* edges) {
+    Ast* ast = &module->ast;
+    FnPurity purity = FnPurity_Const;
+
+    body_walk_begin(walk, ast_item(ast, fn)->fn_definition.body);
+    Expr* expression;
+    while ((expression = body_walk_next(walk)) != null) {
+        switch (expression->kind) {
+            // every asm block is volatile, and the fn called through a
+            // pointer could be anything
+            case ExprKind_Asm:
+            case ExprKind_IndirectCall: purity = FnPurity_Impure; break;
+
+            case ExprKind_FnCall: {
+                item_id callee = module_get_item(module, expression->fn_call.name);
+                if (callee == 0) { break; }
+
+                Item* item = ast_item(ast, callee);
+                if (item->kind == ItemKind_ExternFn) {
+                    if (item->extern_fn.purity < purity) { purity = item->extern_fn.purity; }
+                } else if (item->kind == ItemKind_FnDef) {
+                    CallEdge edge = { fn, callee };
+                    dynarray_push(*edges, &edge);
+                }
+                break;
+            }
+
+            default: break;
+        }
+    }
+
+    // gcc may drop a call to a pure fn whose result isn't used, which
+    // would turn a hang into a return
+    if (walk->endless_loop) { purity = FnPurity_Impure; }
+
+    return purity;
+}
+
+typedef struct PurityGraph {
+    Ast* ast;
+    EdgeIndex* callees;
+} PurityGraph;
+
+// recursion may not end either, for the same reason as an endless loop
+static void finish_purity_component(void* data, item_id* members, usize count) {
+    PurityGraph* graph = data;
+    if (not is_recursive(graph->callees, members, count)) { return; }
+
+    for (usize i = 0; i < count; i += 1) {
+        ast_item(graph->ast, members[i])->fn_definition.purity = FnPurity_Impure;
+    }
+}
+
+void callgraph_infer_purity(Module* module) {
+    Ast* ast = &module->ast;
+    usize item_count = ast_item_count(ast);
+
+    BodyWalk walk;
+    body_walk_init(&walk, ast);
+    DynArray(CallEdge) edges = dynarray_init();
+    DynArray(item_id) fns = dynarray_init();
+
+    // every fn starts out as what its own body allows, fns that aren't
+    // written out can't be relied on. main and _start are entry points,
+    // nothing here calls them.
+    for (item_id id = 1; id <= item_count; id += 1) {
+        Item* item = ast_item(ast, id);
+        if (item->kind != ItemKind_FnDef) { continue; }
+
+        item->fn_definition.purity = FnPurity_Impure;
+        bool entry = is_named(module, item->name, "main") or is_named(module, item->name, "_start");
+        if (is_emitted_fn(item) and not entry) {
+            item->fn_definition.purity = body_purity(module, &walk, id, &edges);
+            dynarray_push(fns, &id);
+        }
+    }
+    body_walk_deinit(&walk);
+
+    EdgeIndex callees;
+    edge_index_init(&callees, edges, dynarray_len(edges), item_count, false);
+    PurityGraph graph = { ast, &callees };
+    find_components(&callees, fns, dynarray_len(fns), item_count, finish_purity_component, &graph);
+    edge_index_deinit(&callees);
+    dynarray_deinit(fns);
+
+    EdgeIndex callers;
+    edge_index_init(&callers, edges, dynarray_len(edges), item_count, true);
+    dynarray_deinit(edges);
+
+    // a fn is no purer than what it calls. purity only goes down and has
+    // three levels, so each fn is lowered (and queued) at most twice.
+    DynArray(item_id) lowered = dynarray_init();
+    for (item_id id = 1; id <= item_count; id += 1) {
+        Item* item = ast_item(ast, id);
+        if (item->kind == ItemKind_FnDef and item->fn_definition.purity != FnPurity_Const) {
+            dynarray_push(lowered, &id);
+        }
+    }
+    for (usize i = 0; i < dynarray_len(lowered); i += 1) {
+        item_id callee = lowered[i];
+        FnPurity purity = ast_item(ast, callee)->fn_definition.purity;
+
+        for (u32 j = callers.first[callee]; j < callers.first[callee + 1]; j += 1) {
+            FnDef* caller = &ast_item(ast, callers.ends[j])->fn_definition;
+            if (caller->purity > purity) {
+                caller->purity = purity;
+                dynarray_push(lowered, &callers.ends[j]);
+            }
+        }
+    }
+
+    dynarray_deinit(lowered);
+    edge_index_deinit(&callers);
+}
+
+
+// -------- //
+// Aliasing //
+// -------- //
+// what a pointer argument is known to point to
+typedef enum ArgObject {
+    ArgObject_Unknown,
+    // not a pointer, it can't overlap anything
+    ArgObject_None,
+    // a string literal, the same text may be the same object
+    ArgObject_Literal,
+    // a pointer parameter of the caller, only known apart from the others
+    // once that parameter is noalias
+    ArgObject_Param,
+} ArgObject;
+
+typedef struct AliasArg {
+    ArgObject object;
+    AstSpan literal;
+    // index into the caller's parameters
+    u32 param;
+} AliasArg;
+
+typedef struct AliasCall {
+    item_id caller;
+    item_id callee;
+    // its arguments are args[first] up to args[first + count]
+    u32 first;
+    u32 count;
+} AliasCall;
+
+typedef struct AliasInference {
+    Module* module;
+    DynArray(AliasCall) calls;
+    DynArray(AliasArg) args;
+    // where each candidate's parameters start in blocked, 0 for the rest
+    u32* slots;
+    // the parameter was passed something that may overlap another argument
+    bool* blocked;
+} AliasInference;
+
+static FnParam* params_of(Ast* ast, Item* item) {
+    FnSig* signature = item->kind == ItemKind_FnDef ? &item->fn_definition.signature : &item->extern_fn.signature;
+    return ast_list(ast, signature->parameters, FnParam);
+}
+
+static usize param_count(Item* item) {
+    FnSig* signature = item->kind == ItemKind_FnDef ? &item->fn_definition.signature : &item->extern_fn.signature;
+    return signature->parameters.len;
+}
+
+static bool is_pointer(Ast* ast, FnParam* param) {
+    return ast_type(ast, param->type)->kind == TypeKind_Ptr;
+}
+
+// only what written out fns call is seen, so pub fns are left to what they
+// declare. calls through pointers aren't seen either.
+static bool is_alias_candidate(Module* module, Item* item) {
+    return (
+        is_emitted_fn(item) and not callgraph_is_root(module, item) and
+        not item->fn_definition.address_taken
+    );
+}
+
+static AliasArg resolve_arg(Module* module, item_id caller, FnParam* to, expr_id argument, symbol_id* lets, usize let_count) {
+    Ast* ast = &module->ast;
+    AliasArg arg = { ArgObject_Unknown, {0, 0}, 0 };
+    if (not is_pointer(ast, to)) {
+        arg.object = ArgObject_None;
+        return arg;
+    }
+
+    Expr* expression = ast_expr(ast, argument);
+    if (expression->kind == ExprKind_StringLit) {
+        arg.object = ArgObject_Literal;
+        arg.literal = expression->string_literal.span;
+    } else if (expression->kind == ExprKind_Symbol) {
+        // a let of the same name anywhere in the body may be what it means
+        for (usize i = 0; i < let_count; i += 1) {
+            if (lets[i] == expression->symbol) { return arg; }
+        }
+
+        Item* item = ast_item(ast, caller);
+        FnParam* params = params_of(ast, item);
+        for (usize i = 0; i < param_count(item); i += 1) {
+            if (params[i].name == expression->symbol and is_pointer(ast, &params[i])) {
+                arg.object = ArgObject_Param;
+                arg.param = i;
+            }
+        }
+    }
+
+    return arg;
+}
+
+// the calls to candidates, with what each argument points to
+static void collect_calls(AliasInference* inference, BodyWalk* walk, item_id caller, DynArray(symbol_id)* lets, DynArray(FnCall*)* pending) {
+    Module* module = inference->module;
+    Ast* ast = &module->ast;
+    usize let_start = dynarray_len(*lets);
+    usize pending_start = dynarray_len(*pending);
+
+    body_walk_begin(walk, ast_item(ast, caller)->fn_definition.body);
+    Expr* expression;
+    while ((expression = body_walk_next(walk)) != null) {
+        if (expression->kind == ExprKind_Let) {
+            dynarray_push(*lets, &expression->let.name);
+        } else if (expression->kind == ExprKind_FnCall) {
+            item_id callee = module_get_item(module, expression->fn_call.name);
+            if (callee != 0 and inference->slots[callee] != 0) {
+                FnCall* call = &expression->fn_call;
+                dynarray_push(*pending, &call);
+            }
+        }
+    }
+
+    // the lets have all been seen now
+    for (usize i = pending_start; i < dynarray_len(*pending); i += 1) {
+        FnCall* call = (*pending)[i];
+        AliasCall alias_call;
+        alias_call.caller = caller;
+        alias_call.callee = module_get_item(module, call->name);
+        alias_call.first = dynarray_len(inference->args);
+        alias_call.count = call->arguments.len;
+
+        FnParam* params = params_of(ast, ast_item(ast, alias_call.callee));
+        expr_id* arguments = ast_list(ast, call->arguments, expr_id);
+        for (usize j = 0; j < call->arguments.len; j += 1) {
+            AliasArg arg = resolve_arg(module, caller, &params[j], arguments[j], &(*lets)[let_start], dynarray_len(*lets) - let_start);
+            dynarray_push(inference->args, &arg);
+        }
+
+        dynarray_push(inference->calls, &alias_call);
+    }
+}
+
+static bool is_known(AliasInference* inference, AliasCall* call, AliasArg* arg) {
+    switch (arg->object) {
+        case ArgObject_Literal: return true;
+        case ArgObject_Param: {
+            Ast* ast = &inference->module->ast;
+            return params_of(ast, ast_item(ast, call->caller))[arg->param].alias != ParamAlias_Maybe;
+        }
+        default: return false;
+    }
+}
+
+static bool is_apart(AliasInference* inference, AliasCall* call, AliasArg* a, AliasArg* b) {
+    if (not is_known(inference, call, a) or not is_known(inference, call, b)) { return false; }
+
+    if (a->object == ArgObject_Param and b->object == ArgObject_Param) {
+        return a->param != b->param;
+    }
+    if (a->object == ArgObject_Literal and b->object == ArgObject_Literal) {
+        String source = inference->module->source;
+        return a->literal.len != b->literal.len or memcmp(
+            source.ptr + a->literal.start,
+            source.ptr + b->literal.start,
+            a->literal.len
+        ) != 0;
+    }
+    return true;
+}
+
+// marks every parameter that was passed something which may overlap
+// another argument, with what's noalias so far
+static void block_overlaps(AliasInference* inference, usize blocked_count) {
+    memset(inference->blocked, 0, sizeof(bool) * blocked_count);
+
+    for (usize i = 0; i < dynarray_len(inference->calls); i += 1) {
+        AliasCall* call = &inference->calls[i];
+        AliasArg* args = &inference->args[call->first];
+        bool* blocked = &inference->blocked[inference->slots[call->callee]];
+
+        for (usize j = 0; j < call->count; j += 1) {
+            if (args[j].object == ArgObject_None) { continue; }
+
+            for (usize k = 0; k < call->count and not blocked[j]; k += 1) {
+                if (k == j or args[k].object == ArgObject_None) { continue; }
+                blocked[j] = not is_apart(inference, call, &args[j], &args[k]);
+            }
+            // the only pointer, it still has to be known
+            blocked[j] |= not is_known(inference, call, &args[j]);
+        }
+    }
+}
+
+void callgraph_infer_noalias(Module* module) {
+    Ast* ast = &module->ast;
+    usize item_count = ast_item_count(ast);
+
+    AliasInference inference;
+    inference.module = module;
+    inference.calls = dynarray_init();
+    inference.args = dynarray_init();
+    inference.slots = calloc(item_count + 1, sizeof(u32));
+
+    // slot 0 means not a candidate, so the first one starts at 1
+    usize blocked_count = 1;
+    for (item_id id = 1; id <= item_count; id += 1) {
+        Item* item = ast_item(ast, id);
+        if (not is_alias_candidate(module, item)) { continue; }
+
+        FnParam* params = params_of(ast, item);
+        bool any_pointer = false;
+        for (usize i = 0; i < param_count(item); i += 1) {
+            any_pointer |= is_pointer(ast, &params[i]) and params[i].alias == ParamAlias_Maybe;
+        }
+        if (not any_pointer) { continue; }
+
+        inference.slots[id] = blocked_count;
+        blocked_count += param_count(item);
+    }
+    inference.blocked = malloc(sizeof(bool) * blocked_count);
+
+    if (blocked_count > 1) {
+        BodyWalk walk;
+        body_walk_init(&walk, ast);
+        DynArray(symbol_id) lets = dynarray_init();
+        DynArray(FnCall*) pending = dynarray_init();
+        for (item_id id = 1; id <= item_count; id += 1) {
+            if (is_emitted_fn(ast_item(ast, id))) {
+                collect_calls(&inference, &walk, id, &lets, &pending);
+            }
+        }
+        dynarray_deinit(pending);
+        dynarray_deinit(lets);
+        body_walk_deinit(&walk);
+    }
+
+    u32* call_counts = calloc(item_count + 1, sizeof(u32));
+    for (usize i = 0; i < dynarray_len(inference.calls); i += 1) {
+        call_counts[inference.calls[i].callee] += 1;
+    }
+
+    // a parameter that's marked can tell the arguments of the calls in its
+    // fn apart, so it goes again until nothing new is marked. marks are
+    // only ever added.
+    bool changed = blocked_count > 1;
+    while (changed) {
+        changed = false;
+        block_overlaps(&inference, blocked_count);
+
+        for (item_id id = 1; id <= item_count; id += 1) {
+            if (inference.slots[id] == 0 or call_counts[id] == 0) { continue; }
+
+            Item* item = ast_item(ast, id);
+            FnParam* params = params_of(ast, item);
+            bool* blocked = &inference.blocked[inference.slots[id]];
+            for (usize i = 0; i < param_count(item); i += 1) {
+                if (is_pointer(ast, &params[i]) and params[i].alias == ParamAlias_Maybe and not blocked[i]) {
+                    params[i].alias = ParamAlias_Inferred;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    free(call_counts);
+    free(inference.blocked);
+    free(inference.slots);
+    dynarray_deinit(inference.args);
+    dynarray_deinit(inference.calls);
+}
+
+
+// -------- //
+// Inlining //
+// -------- //
+// fns up to this many expression nodes that call no other fn are always
+// inlined, their bodies are about the size of the call
+#define INLINE_SMALL_NODES 32
+// fns this big that are never called from a loop are kept out of line, so
+// the cold code doesn't bloat the callers gcc would otherwise inline it into
+#define INLINE_LARGE_NODES 256
+
+typedef struct FnStats {
+    // expression nodes in the body
+    u32 size;
+    // calls to it from the bodies that are written out, and how many of
+    // those are in a loop
+    u32 call_sites;
+    u32 loop_call_sites;
+    // calls no fn that has a body
+    bool leaf;
+    // in a recursive component of the call graph, gcc can't inline it
+    // everywhere
+    bool recursive;
+} FnStats;
+
+// stats is indexed by item_id, callees' call sites are counted in it. null
+// when only one fn is looked at. the calls to fns with bodies are added to
+// edges.
+static void measure_body(Module* module, BodyWalk* walk, item_id fn, FnStats* own, FnStats* stats, DynArray(CallEdge)* edges) {
+    Ast* ast = &module->ast;
+    own->leaf = true;
+
+    body_walk_begin(walk, ast_item(ast, fn)->fn_definition.body);
+    Expr* expression;
+    while ((expression = body_walk_next(walk)) != null) {
+        own->size += 1;
+        if (expression->kind == ExprKind_IndirectCall) { own->leaf = false; }
+        if (expression->kind != ExprKind_FnCall) { continue; }
+
+        item_id callee = module_get_item(module, expression->fn_call.name);
+        if (callee == 0 or ast_item(ast, callee)->kind != ItemKind_FnDef) { continue; }
+
+        if (stats != null) {
+            stats[callee].call_sites += 1;
+            stats[callee].loop_call_sites += body_walk_in_loop(walk);
+        }
+        own->leaf = false;
+        CallEdge edge = { fn, callee };
+        dynarray_push(*edges, &edge);
+    }
+}
+
+typedef struct InlineGraph {
+    FnStats* stats;
+    EdgeIndex* callees;
+} InlineGraph;
+
+static void finish_inline_component(void* data, item_id* members, usize count) {
+    InlineGraph* graph = data;
+    bool recursive = is_recursive(graph->callees, members, count);
+    for (usize i = 0; i < count; i += 1) {
+        graph->stats[members[i]].recursive = recursive;
+    }
+}
+
+static FnInline decide_inlining(Item* item, FnStats* stats, const char** reason) {
+    FnInline inlining = item->fn_definition.inlining;
+    if (inlining == FnInline_Always and stats->recursive) {
+        *reason = "#[inline] ignored, recursive";
+        return FnInline_Auto;
+    }
+    if (inlining != FnInline_Auto) {
+        *reason = inlining == FnInline_Always ? "#[inline]" : "#[noinline]";
+        return inlining;
+    }
+
+    // nothing here calls main, _start or an unused pub fn, they're left
+    // alone
+    if (stats->call_sites == 0) {
+        *reason = "no call sites";
+        return FnInline_Auto;
+    }
+    if (stats->leaf and stats->size <= INLINE_SMALL_NODES) {
+        *reason = "small leaf";
+        return FnInline_Always;
+    }
+    if (stats->size >= INLINE_LARGE_NODES and stats->loop_call_sites == 0) {
+        *reason = "large and cold";
+        return FnInline_Never;
+    }
+
+    *reason = "left to gcc";
+    return FnInline_Auto;
+}
+
+void callgraph_plan_inlining(Module* module, DynArray(InlineDecision)* decisions) {
+    Ast* ast = &module->ast;
+    usize item_count = ast_item_count(ast);
+
+    FnStats* stats = calloc(item_count + 1, sizeof(FnStats));
+    BodyWalk walk;
+    body_walk_init(&walk, ast);
+
+    // only the fns that are written out, so only their calls count
+    DynArray(CallEdge) edges = dynarray_init();
+    DynArray(item_id) fns = dynarray_init();
+    for (item_id id = 1; id <= item_count; id += 1) {
+        if (not is_emitted_fn(ast_item(ast, id))) { continue; }
+
+        measure_body(module, &walk, id, &stats[id], stats, &edges);
+        dynarray_push(fns, &id);
+    }
+    usize fn_count = dynarray_len(fns);
+
+    // fns that call each other, however far round, can't all be inlined
+    EdgeIndex callees;
+    edge_index_init(&callees, edges, dynarray_len(edges), item_count, false);
+    InlineGraph graph = { stats, &callees };
+    find_components(&callees, fns, fn_count, item_count, finish_inline_component, &graph);
+    edge_index_deinit(&callees);
+    dynarray_deinit(edges);
+    dynarray_deinit(fns);
+
+    for (item_id id = 1; id <= item_count; id += 1) {
+        Item* item = ast_item(ast, id);
+        if (not is_emitted_fn(item)) { continue; }
+
+        const char* reason;
+        item->fn_definition.inlining = decide_inlining(item, &stats[id], &reason);
+
+        if (decisions != null) {
+            InlineDecision decision = { id, reason, stats[id].size, stats[id].call_sites, stats[id].loop_call_sites };
+            dynarray_push(*decisions, &decision);
+        }
+    }
+
+    body_walk_deinit(&walk);
+    free(stats);
+}
+
+void callgraph_inline_check_init(InlineCheck* check, Module* module) {
+    usize item_count = ast_item_count(&module->ast);
+    check->first = calloc(item_count + 1, sizeof(u32));
+    check->count = calloc(item_count + 1, sizeof(u32));
+    check->callees = dynarray_init();
+    check->seen = calloc(item_count + 1, sizeof(u32));
+    check->check = 0;
+    check->pending = malloc(sizeof(item_id) * (item_count + 1));
+}
+
+void callgraph_inline_check_deinit(InlineCheck* check) {
+    free(check->pending);
+    free(check->seen);
+    dynarray_deinit(check->callees);
+    free(check->count);
+    free(check->first);
+}
+
+// gcc only fails when every fn of a cycle is always_inline. the fns come in
+// order, so the last fn of such a cycle to come finds its way back to
+// itself through the ones before it, and is the one that loses #[inline].
+void callgraph_check_inlining(Module* module, InlineCheck* check, item_id fn) {
+    Ast* ast = &module->ast;
+    Item* item = ast_item(ast, fn);
+    if (item->fn_definition.inlining != FnInline_Always) { return; }
+
+    FnStats stats = {0};
+    DynArray(CallEdge) edges = dynarray_init();
+    BodyWalk walk;
+    body_walk_init(&walk, ast);
+    measure_body(module, &walk, fn, &stats, null, &edges);
+    body_walk_deinit(&walk);
+
+    // the calls to other fns that are inlined, kept for the fns after
+    check->check += 1;
+    usize pending = 0;
+    check->first[fn] = dynarray_len(check->callees);
+    for (usize i = 0; i < dynarray_len(edges); i += 1) {
+        item_id callee = edges[i].callee;
+        if (ast_item(ast, callee)->fn_definition.inlining != FnInline_Always) { continue; }
+
+        dynarray_push(check->callees, &callee);
+        check->count[fn] += 1;
+        if (check->seen[callee] != check->check) {
+            check->seen[callee] = check->check;
+            check->pending[pending++] = callee;
+        }
+    }
+    dynarray_deinit(edges);
+
+    bool recursive = false;
+    while (pending > 0 and not recursive) {
+        item_id at = check->pending[--pending];
+        recursive = at == fn;
+
+        item_id* callees = &check->callees[check->first[at]];
+        for (u32 i = 0; i < check->count[at]; i += 1) {
+            if (check->seen[callees[i]] == check->check) { continue; }
+            check->seen[callees[i]] = check->check;
+            check->pending[pending++] = callees[i];
+        }
+    }
+
+    if (recursive) {
+        item->fn_definition.inlining = FnInline_Auto;
+        check->count[fn] = 0;
+    }
+}
+
+
+// ------- //
+// Folding //
+// ------- //
+// each fn is written out as a list of words that's the same for two fns
+// exactly when they'd be written out the same: the signature, then every
+// node of the body in walk order. parameters and lets are numbered in the
+// order their names first come up, so their names don't matter. only the
+// hashes of the lists are kept, two fns are written out again to compare
+// them when their hashes match.
+typedef struct FoldWords {
+    u32* words;
+    usize count;
+    usize capacity;
+} FoldWords;
+
+typedef struct FoldWriter {
+    Module* module;
+    FoldWords* out;
+
+    // indexed by symbol_id, 1 + the number of the parameter or let, 0 for
+    // names the fn doesn't bind
+    u32* locals;
+    u32 local_count;
+    symbol_id* bound;
+    usize bound_count;
+    usize bound_capacity;
+    // where names were written in out, they're numbered once the whole
+    // body has been walked
+    usize* symbols;
+    usize symbol_count;
+    usize symbol_capacity;
+} FoldWriter;
+
+typedef struct FoldEntry {
+    u64 hash;
+    item_id fn;
+} FoldEntry;
+
+static void fold_write(FoldWriter* writer, u32 word) {
+    FoldWords* out = writer->out;
+    if (out->count == out->capacity) {
+        out->capacity = out->capacity * 2 + 256;
+        out->words = realloc(out->words, sizeof(u32) * out->capacity);
+    }
+    out->words[out->count++] = word;
+}
+
+// the length, then the text four bytes to a word
+static void fold_write_text(FoldWriter* writer, AstSpan span) {
+    String text = ast_span(&writer->module->ast, span);
+    fold_write(writer, text.len);
+    for (usize i = 0; i < text.len; i += 4) {
+        u32 word = 0;
+        memcpy(&word, text.ptr + i, text.len - i < 4 ? text.len - i : 4);
+        fold_write(writer, word);
+    }
+}
+
+static void fold_write_type(FoldWriter* writer, ast_type_id type) {
+    Ast* ast = &writer->module->ast;
+    while (true) {
+        Ast_Type* node = ast_type(ast, type);
+        fold_write(writer, node->kind);
+        if (node->kind == TypeKind_Symbol) { fold_write(writer, node->symbol); }
+        if (node->kind == TypeKind_Fn) {
+            ast_type_id* parameters = ast_list(ast, node->fn.parameters, ast_type_id);
+            fold_write(writer, node->fn.parameters.len);
+            for (usize i = 0; i < node->fn.parameters.len; i += 1) {
+                fold_write_type(writer, parameters[i]);
+            }
+            type = node->fn.return_type;
+            continue;
+        }
+        if (node->kind != TypeKind_Ptr) { return; }
+
+        fold_write(writer, node->ptr.is_mut);
+        type = node->ptr.to;
+    }
+}
+
+// a name the fn binds that hasn't been given its number. the walk gets to
+// the statements of a block last to first, so a let can come up after the
+// names that refer to it.
+#define FOLD_UNNUMBERED UINT32_MAX
+
+// false when the name is also the name of an item or a constant, renaming
+// it could change what the body refers to
+static bool fold_bind(FoldWriter* writer, symbol_id name) {
+    Module* module = writer->module;
+    if (module_get_item(module, name) != 0 or symtable_get(&module->symbol_table, name) != null) {
+        return false;
+    }
+    if (writer->locals[name] != 0) { return true; }
+
+    if (writer->bound_count == writer->bound_capacity) {
+        writer->bound_capacity = writer->bound_capacity * 2 + 16;
+        writer->bound = realloc(writer->bound, sizeof(symbol_id) * writer->bound_capacity);
+    }
+    writer->bound[writer->bound_count++] = name;
+    writer->locals[name] = FOLD_UNNUMBERED;
+    return true;
+}
+
+// an item or constant as its name, a parameter or let as 1 and its number
+static void fold_write_symbol(FoldWriter* writer, symbol_id name) {
+    if (writer->symbol_count == writer->symbol_capacity) {
+        writer->symbol_capacity = writer->symbol_capacity * 2 + 64;
+        writer->symbols = realloc(writer->symbols, sizeof(usize) * writer->symbol_capacity);
+    }
+    writer->symbols[writer->symbol_count++] = writer->out->count;
+    fold_write(writer, 0);
+    fold_write(writer, name);
+}
+
+static void number_locals(FoldWriter* writer) {
+    u32* words = writer->out->words;
+    for (usize i = 0; i < writer->symbol_count; i += 1) {
+        usize at = writer->symbols[i];
+        u32* local = &writer->locals[words[at + 1]];
+        if (*local == 0) { continue; }
+
+        if (*local == FOLD_UNNUMBERED) {
+            writer->local_count += 1;
+            *local = writer->local_count;
+        }
+        words[at] = 1;
+        words[at + 1] = *local;
+    }
+}
+
+static bool write_node(FoldWriter* writer, Expr* expression) {
+    Module* module = writer->module;
+    Ast* ast = &module->ast;
+
+    fold_write(writer, expression->kind);
+    fold_write(writer, expression->codegen.type);
+    switch (expression->kind) {
+        case ExprKind_StringLit: fold_write_text(writer, expression->string_literal.span); break;
+        case ExprKind_NumberLit: fold_write_text(writer, expression->number_literal.span); break;
+        case ExprKind_BoolLit: fold_write(writer, expression->boolean); break;
+        case ExprKind_If: fold_write(writer, expression->if_expr.otherwise != 0); break;
+        case ExprKind_BinOp: fold_write(writer, expression->binary_operator.kind); break;
+        case ExprKind_Cast: fold_write_type(writer, expression->cast.to); break;
+        case ExprKind_Symbol: fold_write_symbol(writer, expression->symbol); break;
+
+        case ExprKind_Block: {
+            stmt_id* statements = ast_list(ast, expression->block.statements, stmt_id);
+            fold_write(writer, expression->block.statements.len);
+            for (usize i = 0; i < expression->block.statements.len; i += 1) {
+                fold_write(writer, ast_stmt(ast, statements[i])->kind);
+            }
+            break;
+        }
+
+        case ExprKind_Match: {
+            MatchArm* arms = ast_list(ast, expression->match.arms, MatchArm);
+            fold_write(writer, expression->match.arms.len);
+            for (usize i = 0; i < expression->match.arms.len; i += 1) {
+                fold_write_text(writer, arms[i].pattern.span);
+            }
+            break;
+        }
+
+        case ExprKind_Let: {
+            if (not fold_bind(writer, expression->let.name)) { return false; }
+            fold_write_symbol(writer, expression->let.name);
+            break;
+        }
+
+        // calls go to what the callee was folded into
+        case ExprKind_FnCall: {
+            symbol_id name = expression->fn_call.name;
+            item_id callee = module_get_item(module, name);
+            if (callee != 0 and ast_item(ast, callee)->kind == ItemKind_FnDef) {
+                item_id folded_into = ast_item(ast, callee)->fn_definition.folded_into;
+                if (folded_into != 0) { name = ast_item(ast, folded_into)->name; }
+            }
+            fold_write(writer, name);
+            fold_write(writer, expression->fn_call.arguments.len);
+            break;
+        }
+
+        case ExprKind_IndirectCall: {
+            fold_write_symbol(writer, expression->fn_call.name);
+            fold_write(writer, expression->fn_call.arguments.len);
+            break;
+        }
+
+        case ExprKind_Asm: {
+            Asm* asm = ast_asm(ast, expression->asm);
+            AsmInput* inputs = ast_list(ast, asm->inputs, AsmInput);
+            fold_write(writer, asm->inputs.len);
+            for (usize i = 0; i < asm->inputs.len; i += 1) {
+                fold_write_text(writer, inputs[i].reg);
+            }
+
+            AstRange spans[] = { asm->clobbers, asm->outputs, asm->source };
+            for (usize i = 0; i < sizeof(spans) / sizeof(spans[0]); i += 1) {
+                AstSpan* list = ast_list(ast, spans[i], AstSpan);
+                fold_write(writer, spans[i].len);
+                for (usize j = 0; j < spans[i].len; j += 1) {
+                    fold_write_text(writer, list[j]);
+                }
+            }
+            break;
+        }
+
+        case ExprKind_Ret:
+        case ExprKind_Loop:
+        case ExprKind_Break:
+        case ExprKind_Continue:
+        case ExprKind_Unreachable: break;
+
+        default: return false;
+    }
+
+    return true;
+}
+
+// writes the fn over what out held, false when it can't be folded
+static bool write_fn(FoldWriter* writer, BodyWalk* walk, item_id fn, FoldWords* out) {
+    Ast* ast = &writer->module->ast;
+    writer->out = out;
+    out->count = 0;
+    FnDef* definition = &ast_item(ast, fn)->fn_definition;
+    FnParam* params = ast_list(ast, definition->signature.parameters, FnParam);
+
+    fold_write(writer, definition->inlining);
+    fold_write(writer, definition->purity);
+    fold_write_type(writer, definition->signature.return_type);
+    fold_write(writer, definition->signature.parameters.len);
+
+    bool foldable = true;
+    for (usize i = 0; i < definition->signature.parameters.len and foldable; i += 1) {
+        fold_write_type(writer, params[i].type);
+        fold_write(writer, params[i].alias);
+        foldable = fold_bind(writer, params[i].name);
+        if (foldable) { fold_write_symbol(writer, params[i].name); }
+    }
+
+    if (foldable) {
+        body_walk_begin(walk, definition->body);
+        Expr* expression;
+        while ((expression = body_walk_next(walk)) != null) {
+            if (not write_node(writer, expression)) {
+                foldable = false;
+                break;
+            }
+        }
+        walk->exprs.len = 0;
+    }
+    if (foldable) { number_locals(writer); }
+
+    for (usize i = 0; i < writer->bound_count; i += 1) {
+        writer->locals[writer->bound[i]] = 0;
+    }
+    writer->bound_count = 0;
+    writer->local_count = 0;
+    writer->symbol_count = 0;
+    return foldable;
+}
+
+static u64 hash_words(u32* words, usize count) {
+    u64 hash = 14695981039346656037ull;
+    for (usize i = 0; i < count; i += 1) {
+        hash ^= words[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static int compare_entries(const void* a, const void* b) {
+    const FoldEntry* left = a;
+    const FoldEntry* right = b;
+    if (left->hash != right->hash) { return left->hash < right->hash ? -1 : 1; }
+    return left->fn < right->fn ? -1 : left->fn > right->fn;
+}
+
+static bool same_words(FoldWords* a, FoldWords* b) {
+    return a->count == b->count and memcmp(a->words, b->words, sizeof(u32) * a->count) == 0;
+}
+
+// folds every fn into the first fn written out the same way, returns how
+// many were folded
+static usize fold_round(FoldWriter* writer, BodyWalk* walk, FoldWords* kept, FoldWords* other) {
+    Ast* ast = &writer->module->ast;
+
+    DynArray(FoldEntry) entries = dynarray_init();
+    for (item_id id = 1; id <= ast_item_count(ast); id += 1) {
+        Item* item = ast_item(ast, id);
+        if (not is_emitted_fn(item) or item->fn_definition.folded_into != 0) { continue; }
+        if (not write_fn(writer, walk, id, other)) { continue; }
+
+        FoldEntry entry = { hash_words(other->words, other->count), id };
+        dynarray_push(entries, &entry);
+    }
+
+    usize entry_count = dynarray_len(entries);
+    qsort(entries, entry_count, sizeof(FoldEntry), compare_entries);
+
+    // a run of equal hashes is nearly always one fn written out many
+    // times, the rest of the run is compared against its first fn
+    usize folded = 0;
+    for (usize run = 0; run < entry_count; ) {
+        usize end = run + 1;
+        while (end < entry_count and entries[end].hash == entries[run].hash) { end += 1; }
+
+        for (usize j = run; j + 1 < end; j += 1) {
+            item_id into = entries[j].fn;
+            if (ast_item(ast, into)->fn_definition.folded_into != 0) { continue; }
+
+            write_fn(writer, walk, into, kept);
+            for (usize i = j + 1; i < end; i += 1) {
+                // a fn used as a value keeps its own address
+                FnDef* definition = &ast_item(ast, entries[i].fn)->fn_definition;
+                if (definition->folded_into != 0 or definition->address_taken) { continue; }
+
+                write_fn(writer, walk, entries[i].fn, other);
+                if (same_words(kept, other)) {
+                    definition->folded_into = into;
+                    folded += 1;
+                }
+            }
+        }
+
+        run = end;
+    }
+
+    dynarray_deinit(entries);
+    return folded;
+}
+
+void callgraph_fold_duplicates(Module* module) {
+    Ast* ast = &module->ast;
+
+    FoldWriter writer = {
+        .module = module,
+        .locals = calloc(intern_count(&module->names) + 1, sizeof(u32)),
+    };
+    FoldWords kept = { 0 };
+    FoldWords other = { 0 };
+
+    BodyWalk walk;
+    body_walk_init(&walk, ast);
+
+    // fns that only differ in which of two folded fns they call are the
+    // same once those are folded, so this goes on until nothing folds
+    while (fold_round(&writer, &walk, &kept, &other) > 0) {}
+
+    body_walk_deinit(&walk);
+
+    // a fn may have been folded into one that was folded later on
+    for (item_id id = 1; id <= ast_item_count(ast); id += 1) {
+        Item* item = ast_item(ast, id);
+        if (item->kind != ItemKind_FnDef or item->fn_definition.folded_into == 0) { continue; }
+
+        item_id into = item->fn_definition.folded_into;
+        while (ast_item(ast, into)->fn_definition.folded_into != 0) {
+            into = ast_item(ast, into)->fn_definition.folded_into;
+        }
+        item->fn_definition.folded_into = into;
+    }
+
+    free(other.words);
+    free(kept.words);
+    free(writer.symbols);
+    free(writer.bound);
+    free(writer.locals);
+}
+
+
+// ----------- //
+// Stack Usage //
+// ----------- //
+typedef enum StackFlag {
+    // the fn is in a cycle of calls
+    StackFlag_Recursive = 1 << 0,
+    // a fn in a cycle of calls is reached, the depth is only a lower bound
+    StackFlag_Unbounded = 1 << 1,
+    // an extern fn is called, its frames aren't counted
+    StackFlag_Extern = 1 << 2,
+    // a frame gcc sizes at run time is reached
+    StackFlag_Dynamic = 1 << 3,
+    // gcc kept the fn, it wasn't inlined everywhere or unused
+    StackFlag_Kept = 1 << 4,
+    // a fn is called through a pointer, what it calls isn't counted
+    StackFlag_Indirect = 1 << 5,
+} StackFlag;
+
+// what a caller takes on from its callees
+#define STACK_FLAGS_REACHED (StackFlag_Unbounded | StackFlag_Extern | StackFlag_Dynamic | StackFlag_Indirect)
+
+typedef struct StackFrames {
+    // indexed by item_id, gcc's frame size for the fn in bytes. fns gcc
+    // inlined everywhere have no frame of their own.
+    u64* bytes;
+    u8* flags;
+} StackFrames;
+
+// reads gcc's lines of path:line:column:name, the frame size and its
+// qualifiers. clones gcc made of a fn (name.constprop.0 and the like) count
+// as the fn.
+static bool read_stack_usage(Module* module, const char* path, StackFrames* frames) {
+    FileView file;
+    if (not file_open(path, &file)) { return false; }
+
+    const char* text = file.contents.ptr;
+    usize len = file.contents.len;
+    usize start = 0;
+    while (start < len) {
+        usize end = start;
+        while (end < len and text[end] != '\n') { end += 1; }
+
+        usize tab = start;
+        while (tab < end and text[tab] != '\t') { tab += 1; }
+        usize name_start = tab;
+        while (name_start > start and text[name_start - 1] != ':') { name_start -= 1; }
+        usize name_end = name_start;
+        while (name_end < tab and text[name_end] != '.') { name_end += 1; }
+
+        symbol_id name = intern_find(&module->names, str_slice(text + name_start, name_end - name_start));
+        item_id id = name == 0 ? 0 : module_get_item(module, name);
+        if (id != 0 and tab < end) {
+            u64 bytes = 0;
+            usize at = tab + 1;
+            while (at < end and text[at] >= '0' and text[at] <= '9') {
+                bytes = bytes * 10 + (u64)(text[at] - '0');
+                at += 1;
+            }
+            if (bytes > frames->bytes[id]) { frames->bytes[id] = bytes; }
+            frames->flags[id] |= StackFlag_Kept;
+
+            // "dynamic,bounded" frames are sized at run time, but gcc knows
+            // the most they take
+            String qualifiers = str_slice(text + at, end - at);
+            bool dynamic = qualifiers.len >= 8 and memcmp(qualifiers.ptr + 1, "dynamic", 7) == 0;
+            bool bounded = qualifiers.len >= 8 and memcmp(qualifiers.ptr + qualifiers.len - 7, "bounded", 7) == 0;
+            if (dynamic and not bounded) { frames->flags[id] |= StackFlag_Dynamic; }
+        }
+
+        start = end + 1;
+    }
+
+    file_close(&file);
+    return true;
+}
+
+// the worst case depth of every written out fn: its own frame and the
+// deepest of the fns it calls. components are finished after every
+// component they call, so their depths are already known. a fn in a
+// recursive component recurses.
+typedef struct StackDepths {
+    EdgeIndex* callees;
+    StackFrames* frames;
+
+    u64* depth;
+    u8* flags;
+    // the callee the deepest path goes through, 0 at its end
+    item_id* deepest;
+    // a recursive fn the fn leads to, for the report
+    item_id* recursion;
+    // the component each fn ended up in, by the id of its first fn, and
+    // the next fn of that component, 0 after the last
+    item_id* component;
+    item_id* next_member;
+} StackDepths;
+
+static void finish_stack_component(void* data, item_id* members, usize count) {
+    StackDepths* depths = data;
+    EdgeIndex* callees = depths->callees;
+    StackFrames* frames = depths->frames;
+
+    item_id root = members[0];
+    for (usize i = 0; i < count; i += 1) {
+        depths->component[members[i]] = root;
+        depths->next_member[members[i]] = i + 1 < count ? members[i + 1] : 0;
+    }
+
+    bool recursive = is_recursive(callees, members, count);
+
+    for (usize i = 0; i < count; i += 1) {
+        item_id fn = members[i];
+        u64 deepest = 0;
+        u8 flags = frames->flags[fn];
+        if (recursive) {
+            flags |= StackFlag_Recursive | StackFlag_Unbounded;
+            depths->recursion[fn] = fn;
+        }
+
+        for (u32 j = callees->first[fn]; j < callees->first[fn + 1]; j += 1) {
+            item_id callee = callees->ends[j];
+            if (depths->component[callee] == root) { continue; }
+
+            flags |= depths->flags[callee] & STACK_FLAGS_REACHED;
+            if (depths->recursion[fn] == 0) { depths->recursion[fn] = depths->recursion[callee]; }
+            if (depths->deepest[fn] == 0 or depths->depth[callee] > deepest) {
+                deepest = depths->depth[callee];
+                depths->deepest[fn] = callee;
+            }
+        }
+
+        depths->depth[fn] = frames->bytes[fn] + deepest;
+        depths->flags[fn] = flags;
+    }
+}
+
+static void print_name(Module* module, item_id id) {
+    printf("%.*s", str_format(intern_get(&module->names, ast_item(&module->ast, id)->name)));
+}
+
+bool callgraph_print_stack_usage(Module* module, const char* stack_usage_path) {
+    Ast* ast = &module->ast;
+    usize item_count = ast_item_count(ast);
+
+    StackFrames frames = {
+        .bytes = calloc(item_count + 1, sizeof(u64)),
+        .flags = calloc(item_count + 1, sizeof(u8)),
+    };
+    if (not read_stack_usage(module, stack_usage_path, &frames)) {
+        printf("Could not read '%s'\n", stack_usage_path);
+        free(frames.flags);
+        free(frames.bytes);
+        return false;
+    }
+
+    // the calls between written out fns, calls to extern fns and through
+    // pointers only mark the caller. a folded fn runs as what it was folded
+    // into.
+    BodyWalk walk;
+    body_walk_init(&walk, ast);
+    DynArray(CallEdge) edges = dynarray_init();
+    DynArray(item_id) fns = dynarray_init();
+    for (item_id id = 1; id <= item_count; id += 1) {
+        if (not is_emitted_fn(ast_item(ast, id))) { continue; }
+        dynarray_push(fns, &id);
+
+        item_id folded_into = ast_item(ast, id)->fn_definition.folded_into;
+        if (folded_into != 0) {
+            CallEdge edge = { id, folded_into };
+            dynarray_push(edges, &edge);
+            frames.flags[id] |= frames.flags[folded_into] & StackFlag_Kept;
+            continue;
+        }
+
+        body_walk_begin(&walk, ast_item(ast, id)->fn_definition.body);
+        Expr* expression;
+        while ((expression = body_walk_next(&walk)) != null) {
+            if (expression->kind == ExprKind_IndirectCall) { frames.flags[id] |= StackFlag_Indirect; }
+            if (expression->kind != ExprKind_FnCall) { continue; }
+
+            item_id callee = module_get_item(module, expression->fn_call.name);
+            if (callee == 0) { continue; }
+
+            Item* item = ast_item(ast, callee);
+            if (item->kind == ItemKind_ExternFn) {
+                frames.flags[id] |= StackFlag_Extern;
+            } else if (is_emitted_fn(item)) {
+                if (item->fn_definition.folded_into != 0) { callee = item->fn_definition.folded_into; }
+                CallEdge edge = { id, callee };
+                dynarray_push(edges, &edge);
+            }
+        }
+    }
+    body_walk_deinit(&walk);
+
+    EdgeIndex callees;
+    edge_index_init(&callees, edges, dynarray_len(edges), item_count, false);
+    dynarray_deinit(edges);
+
+    StackDepths depths = {
+        .callees = &callees,
+        .frames = &frames,
+        .depth = calloc(item_count + 1, sizeof(u64)),
+        .flags = calloc(item_count + 1, sizeof(u8)),
+        .deepest = calloc(item_count + 1, sizeof(item_id)),
+        .recursion = calloc(item_count + 1, sizeof(item_id)),
+        .component = calloc(item_count + 1, sizeof(item_id)),
+        .next_member = calloc(item_count + 1, sizeof(item_id)),
+    };
+    find_components(&callees, fns, dynarray_len(fns), item_count, finish_stack_component, &depths);
+
+    usize entry_count = 0;
+    for (usize i = 0; i < dynarray_len(fns); i += 1) {
+        entry_count += callgraph_is_root(module, ast_item(ast, fns[i]));
+    }
+    printf("Stack depth of %zu entry point%s, from %s\n", entry_count, entry_count == 1 ? "" : "s", stack_usage_path);
+
+    for (usize i = 0; i < dynarray_len(fns); i += 1) {
+        item_id fn = fns[i];
+        if (not callgraph_is_root(module, ast_item(ast, fn))) { continue; }
+
+        u8 flags = depths.flags[fn];
+        printf("    ");
+        print_name(module, fn);
+        // nothing can call an entry point gcc left out, it isn't run
+        if (not (flags & StackFlag_Kept)) {
+            printf(": left out by gcc\n");
+            continue;
+        }
+        printf(": %s%llu bytes, ", flags & StackFlag_Unbounded ? "at least " : "", (unsigned long long)depths.depth[fn]);
+        for (item_id at = fn; at != 0; at = depths.deepest[at]) {
+            if (at != fn) { printf(" -> "); }
+            print_name(module, at);
+        }
+        if (flags & StackFlag_Unbounded) {
+            printf(", recursion through ");
+            print_name(module, depths.recursion[fn]);
+        }
+        if (flags & StackFlag_Dynamic) { printf(", frames sized at run time"); }
+        if (flags & StackFlag_Extern) { printf(", extern fns not counted"); }
+        if (flags & StackFlag_Indirect) { printf(", calls through fn pointers not counted"); }
+        printf("\n");
+    }
+
+    usize cycle_count = 0;
+    for (usize i = 0; i < dynarray_len(fns); i += 1) {
+        item_id fn = fns[i];
+        cycle_count += depths.component[fn] == fn and depths.flags[fn] & StackFlag_Recursive;
+    }
+    if (cycle_count > 0) {
+        printf("Recursion in %zu cycle%s\n", cycle_count, cycle_count == 1 ? "" : "s");
+    }
+    for (usize i = 0; i < dynarray_len(fns); i += 1) {
+        item_id root = fns[i];
+        if (depths.component[root] != root or not (depths.flags[root] & StackFlag_Recursive)) { continue; }
+
+        printf("    ");
+        for (item_id member = root; member != 0; member = depths.next_member[member]) {
+            if (member != root) { printf(", "); }
+            print_name(module, member);
+        }
+        printf("\n");
+    }
+
+    free(depths.next_member);
+    free(depths.component);
+    free(depths.recursion);
+    free(depths.deepest);
+    free(depths.flags);
+    free(depths.depth);
+    edge_index_deinit(&callees);
+    dynarray_deinit(fns);
+    free(frames.flags);
+    free(frames.bytes);
+    return true;
+}
+
+
+// ------- //
+// Reports //
+// ------- //
+static bool is_dropped(Module* module, Item* item) {
+    switch (item->kind) {
+        case ItemKind_FnDef:
+        case ItemKind_ExternFn: return not item->reachable;
+        case ItemKind_Const: {
+            SymEntry* entry = symtable_get(&module->symbol_table, item->name);
+            return entry != null and not entry->reachable;
+        }
+        default: return false;
+    }
+}
+
+void callgraph_print_dropped(Module* module) {
+    Ast* ast = &module->ast;
+
+    usize dropped = 0;
+    for (item_id id = 1; id <= ast_item_count(ast); id += 1) {
+        dropped += is_dropped(module, ast_item(ast, id));
+    }
+    printf("Dropped %zu unreachable item%s\n", dropped, dropped == 1 ? "" : "s");
+
+    for (item_id id = 1; id <= ast_item_count(ast); id += 1) {
+        Item* item = ast_item(ast, id);
+        if (not is_dropped(module, item)) { continue; }
+
+        const char* kind = "fn";
+        if (item->kind == ItemKind_ExternFn) { kind = "extern fn"; }
+        if (item->kind == ItemKind_Const) { kind = "const"; }
+        printf("    %s %.*s\n", kind, str_format(intern_get(&module->names, item->name)));
+    }
+}
+
+// the fn's signature is written out
+static bool is_declared_fn(Item* item) {
+    return item->reachable and (item->kind == ItemKind_ExternFn or is_emitted_fn(item));
+}
+
+void callgraph_print_noalias(Module* module) {
+    Ast* ast = &module->ast;
+
+    usize marked = 0;
+    for (item_id id = 1; id <= ast_item_count(ast); id += 1) {
+        Item* item = ast_item(ast, id);
+        if (not is_declared_fn(item)) { continue; }
+
+        FnParam* params = params_of(ast, item);
+        for (usize i = 0; i < param_count(item); i += 1) {
+            marked += params[i].alias != ParamAlias_Maybe;
+        }
+    }
+    printf("Marked %zu parameter%s restrict\n", marked, marked == 1 ? "" : "s");
+
+    for (item_id id = 1; id <= ast_item_count(ast); id += 1) {
+        Item* item = ast_item(ast, id);
+        if (not is_declared_fn(item)) { continue; }
+
+        FnParam* params = params_of(ast, item);
+        for (usize i = 0; i < param_count(item); i += 1) {
+            if (params[i].alias == ParamAlias_Maybe) { continue; }
+
+            printf(
+                "    %.*s.%.*s: %s\n",
+                str_format(intern_get(&module->names, item->name)),
+                str_format(intern_get(&module->names, params[i].name)),
+                params[i].alias == ParamAlias_Declared ? "noalias" : "inferred"
+            );
+        }
+    }
+}
+
+void callgraph_print_folded(Module* module) {
+    Ast* ast = &module->ast;
+
+    usize folded = 0;
+    for (item_id id = 1; id <= ast_item_count(ast); id += 1) {
+        Item* item = ast_item(ast, id);
+        folded += item->kind == ItemKind_FnDef and item->fn_definition.folded_into != 0;
+    }
+    printf("Folded %zu fn%s\n", folded, folded == 1 ? "" : "s");
+
+    for (item_id id = 1; id <= ast_item_count(ast); id += 1) {
+        Item* item = ast_item(ast, id);
+        if (item->kind != ItemKind_FnDef or item->fn_definition.folded_into == 0) { continue; }
+
+        printf(
+            "    %.*s: into %.*s%s\n",
+            str_format(intern_get(&module->names, item->name)),
+            str_format(intern_get(&module->names, ast_item(ast, item->fn_definition.folded_into)->name)),
+            callgraph_is_root(module, item) ? ", as an alias" : ""
+        );
+    }
+}
+
+void callgraph_print_inlining(Module* module, DynArray(InlineDecision) decisions) {
+    Ast* ast = &module->ast;
+
+    usize fn_count = 0;
+    for (usize i = 0; i < dynarray_len(decisions); i += 1) {
+        fn_count += ast_item(ast, decisions[i].fn)->fn_definition.folded_into == 0;
+    }
+    printf("Inlining %zu fn%s\n", fn_count, fn_count == 1 ? "" : "s");
+
+    const char* inlinings[] = { "auto", "inline", "noinline" };
+    for (usize i = 0; i < dynarray_len(decisions); i += 1) {
+        InlineDecision* decision = &decisions[i];
+        Item* item = ast_item(ast, decision->fn);
+        if (item->fn_definition.folded_into != 0) { continue; }
+
+        printf(
+            "    %-8s  %.*s: %s, %u nodes, %u call site%s, %u in a loop\n",
+            inlinings[item->fn_definition.inlining],
+            str_format(intern_get(&module->names, item->name)),
+            decision->reason,
+            decision->size,
+            decision->call_sites,
+            decision->call_sites == 1 ? "" : "s",
+            decision->loop_call_sites
+        );
+    }
+}
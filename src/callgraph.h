@@ -0,0 +1,85 @@
+#ifndef CALLGRAPH_H
+#define CALLGRAPH_H
+
+#include "module.h"
+
+
+// which items codegen writes out. the roots are main, _start and pub items,
+// from there every fn, extern fn and constant an analyzed body uses is
+// reachable. constants are written out as literals, so the fns their
+// initializers call aren't needed.
+bool callgraph_is_root(Module* module, Item* item);
+
+void callgraph_mark_reachable(Module* module);
+// for --keep-all, and when bodies aren't all around at once
+void callgraph_mark_all(Module* module);
+
+// works out how pure every written out fn is. volatile asm makes a fn
+// impure, so do recursion and a loop without a break or return in it. calls
+// to extern fns count as what #[pure] or #[const] say, impure without
+// either.
+void callgraph_infer_purity(Module* module);
+
+// marks the pointer parameters of fns that aren't pub as noalias when every
+// call passes an object no other argument can point to: a string literal
+// with text of its own, or a noalias parameter of the caller that no let
+// shadows. runs until marking one parameter doesn't let another be marked.
+void callgraph_infer_noalias(Module* module);
+
+// picks which reachable fns get gcc's always_inline or noinline, from their
+// size, whether they call other fns and how often they're called from
+// loops. #[inline] and #[noinline] win, #[inline] on a fn that can call
+// itself, through other fns or not, is dropped since gcc refuses it. each
+// decision is added to decisions unless it's null.
+typedef struct InlineDecision {
+    item_id fn;
+    const char* reason;
+    u32 size;
+    u32 call_sites;
+    u32 loop_call_sites;
+} InlineDecision;
+
+void callgraph_plan_inlining(Module* module, DynArray(InlineDecision)* decisions);
+
+// for when the other bodies aren't around: the fns are checked one at a
+// time in item order, and what's needed of them is remembered here
+typedef struct InlineCheck {
+    // by item_id, where the fn's calls to #[inline] fns start in callees
+    // and how many there are. only fns that kept #[inline] have any.
+    u32* first;
+    u32* count;
+    DynArray(item_id) callees;
+    // by item_id, the last check that got to the fn
+    u32* seen;
+    u32 check;
+    // the fns the check has yet to look at
+    item_id* pending;
+} InlineCheck;
+
+void callgraph_inline_check_init(InlineCheck* check, Module* module);
+void callgraph_inline_check_deinit(InlineCheck* check);
+// only drops #[inline] from the fn, if it leads back to itself through the
+// fns checked before that kept theirs
+void callgraph_check_inlining(Module* module, InlineCheck* check, item_id fn);
+
+// folds fns that would be written out the same, up to the names of their
+// parameters and lets, into the first of them: calls to the others go to
+// it and entry points become aliases of it. runs last, the signature
+// includes what the other passes decided.
+void callgraph_fold_duplicates(Module* module);
+
+// lists the items that aren't reachable, in the order they're declared
+void callgraph_print_dropped(Module* module);
+// lists the parameters that are written out with restrict
+void callgraph_print_noalias(Module* module);
+// lists the fns that were folded and what into
+void callgraph_print_folded(Module* module);
+// lists what gcc is told about inlining each fn, after folding so the fns
+// folded into others aren't in it
+void callgraph_print_inlining(Module* module, DynArray(InlineDecision) decisions);
+// lists the worst case stack depth from each entry point, going by the
+// frame sizes in the file gcc's -fstack-usage wrote for the ir, and the
+// fns that recurse. false when the file can't be read.
+bool callgraph_print_stack_usage(Module* module, const char* stack_usage_path);
+
+#endif // !CALLGRAPH_H
@@ -4,35 +4,43 @@
 #include "lexer.h"
 #include "parser.h"
 #include "analyzer.h"
+#include "callgraph.h"
 #include "c_codegen.h"
+#include "astcache.h"
+#include "scan.h"
 #include "util.h"
 #include "os.h"
 #include <chnlib/logger.h>
 #include <stdio.h>
 
 
-Module* compiler_compile_module(String path, String source, bool build, bool debug_info) {
-    Module* module = malloc(sizeof(Module));
-    module_init(module, path, source);
-
-    
+static bool lex_and_parse(Module* module, CompilerOptions* options, ParserOptions* parser_options) {
+    bool debug_info = options->debug_info;
 
     // ------ //
     // Lexing //
-    lexer_lex(module);
+    TokenStream tokens;
+    if (options->stream_tokens) {
+        // tokens are lexed as the parser asks for them
+        token_stream_init(&tokens, module);
+    } else {
+        lexer_lex(module, options->lex_threads);
 
-    if (module->has_errors) {
-        module_display_errors(module);
-        return null;
+        if (module->has_errors) {
+            module_display_errors(module);
+            return false;
+        }
+
+        token_stream_init_list(&tokens, module, &module->tokens);
     }
 
     // print tokens
-    if (debug_info) {
+    if (debug_info and not options->stream_tokens) {
         printf("Tokens\n------\n");
-        for (usize i = 0; i < dynarray_len(module->token_list); i++) {
-            Token* token = &module->token_list[i];
-            printf("%s: " YELLOW, token_string(token->kind));
-            token_print(token);
+        for (usize i = 0; i < token_list_len(&module->tokens); i++) {
+            Token token = token_list_get(&module->tokens, i);
+            printf("%s: " YELLOW, token_string(token.kind));
+            token_print(&token);
             printf(RESET "\n");
         }
     }
@@ -42,28 +50,151 @@ Module* compiler_compile_module(String path, String source, bool build, bool deb
     if (debug_info) {
         printf("Parsing...\n");
     }
-    parser_parse(module);
+    parser_parse(module, &tokens, parser_options);
+    token_stream_report_errors(&tokens);
+    token_stream_deinit(&tokens);
 
     if (module->has_errors) {
         module_display_errors(module);
-        return null;
+        return false;
     }
 
     if (debug_info) {
         printf(BOLDWHITE "Finished parsing\n---\n" RESET);
     }
 
+    return true;
+}
+
+// the ir is written next to where it goes and moved over once it's
+// complete, so a failed compile doesn't leave half of it behind
+#define IR_PATH "build/ir.c"
+#define IR_PARTIAL_PATH "build/ir.c.partial"
+
+// the ir file, with the prelude already written to it
+static FILE* open_output(void) {
+    FileView prelude;
+    bool read_success = file_open("prelude.c", &prelude);
+    if (not read_success) {
+        printf("Failed to load 'prelude.c'");
+        return null;
+    }
+
+    FILE* out_file = fopen(IR_PARTIAL_PATH, "wb");
+    if (out_file == null) {
+	    printf("Could not create ir\n");
+	    file_close(&prelude);
+	    return null;
+    }
+
+    fwrite(prelude.contents.ptr, prelude.contents.len, 1, out_file);
+    file_close(&prelude);
+
+    return out_file;
+}
+
+static void write_output(FILE* out_file, String text) {
+    fwrite(text.ptr, text.len, 1, out_file);
+    str_deinit(text);
+}
+
+static bool close_output(FILE* out_file, bool complete) {
+    fclose(out_file);
+    if (not complete) {
+        remove(IR_PARTIAL_PATH);
+        return false;
+    }
+
+    if (rename(IR_PARTIAL_PATH, IR_PATH) != 0) {
+        printf("Could not create ir\n");
+        return false;
+    }
+    return true;
+}
+
+// gcc writes the frame sizes next to the object, with the same flags as
+// --build so they're the frames that get run
+#define STACK_USAGE_COMMAND "gcc -O2 -w -fstack-usage -c build/ir.c -o build/ir.o"
+#define STACK_USAGE_PATH "build/ir.su"
+
+static void report_stack_usage(Module* module) {
+    remove(STACK_USAGE_PATH);
+    if (system(STACK_USAGE_COMMAND) != 0) {
+        printf("Could not compile the ir for the stack report\n");
+        return;
+    }
+    callgraph_print_stack_usage(module, STACK_USAGE_PATH);
+}
+
+static bool compile_whole(Module* module, CompilerOptions* options) {
+    bool debug_info = options->debug_info;
+
+    ParserOptions parser_options = {
+        .thread_count = options->parse_threads,
+        // streamed tokens are gone by the time a body would be parsed, and
+        // keep all writes out the bodies nothing calls
+        .lazy_bodies = options->lazy_bodies and not options->stream_tokens and not options->keep_all,
+    };
+
+    // an unchanged file skips straight to analysis
+    AstCache cache = { options->ast_cache, parser_options.lazy_bodies };
+    if (options->ast_cache != null and astcache_load(module, &cache)) {
+        if (debug_info) {
+            printf(BOLDWHITE "Loaded AST from cache\n---\n" RESET);
+        }
+    } else {
+        if (not lex_and_parse(module, options, &parser_options)) {
+            return false;
+        }
+
+        if (options->ast_cache != null) {
+            astcache_store(module, &cache);
+        }
+    }
+
    
     // --------- //
     // Analyzing //
     if (debug_info) {
         printf(BOLDWHITE "Analyzing AST\n" RESET);
     }
-    analyzer_analyze(module);
+    analyzer_analyze(module, options->analyze_threads);
+
+    // lazily parsed bodies can still fail to parse
+    if (module->has_errors) {
+        module_display_errors(module);
+        return false;
+    }
+
     if (debug_info) {
         printf("Analyzed AST\n");
     }
 
+    // only what the roots lead to is written out
+    if (options->keep_all) {
+        callgraph_mark_all(module);
+    } else {
+        callgraph_mark_reachable(module);
+    }
+    if (options->dead_report) {
+        callgraph_print_dropped(module);
+    }
+    callgraph_infer_purity(module);
+    callgraph_infer_noalias(module);
+    if (options->alias_report) {
+        callgraph_print_noalias(module);
+    }
+    DynArray(InlineDecision) inline_decisions = dynarray_init();
+    callgraph_plan_inlining(module, options->inline_report ? &inline_decisions : null);
+    callgraph_fold_duplicates(module);
+    if (options->fold_report) {
+        callgraph_print_folded(module);
+    }
+    if (options->inline_report) {
+        callgraph_print_inlining(module, inline_decisions);
+    }
+    dynarray_deinit(inline_decisions);
+
     // ------- //
     // Codegen //
     if (debug_info) {
@@ -72,26 +203,116 @@ Module* compiler_compile_module(String path, String source, bool build, bool deb
 
     String ir = c_codegen_generate(module);
 
-    char* prelude_text;
-    int prelude_length;
-    bool read_success = read_file("prelude.c", &prelude_text, &prelude_length);
-    if (not read_success) {
-        printf("Failed to load 'prelude.c'");
-        return null;
+    FILE* out_file = open_output();
+    if (out_file == null) {
+        return false;
+    }
+
+    write_output(out_file, ir);
+
+    if (not close_output(out_file, true)) {
+        return false;
+    }
+    if (options->stack_report) {
+        report_stack_usage(module);
+    }
+    return true;
+}
+
+// the signatures are parsed first with the bodies skipped, which is enough
+// to analyze calls and write the declarations. the bodies are then read
+// again from a second token stream, one at a time, and each one's nodes
+// and temporaries are released once its definition is written.
+static bool compile_streamed(Module* module, CompilerOptions* options) {
+    bool debug_info = options->debug_info;
+    Ast* ast = &module->ast;
+
+    if (debug_info) {
+        printf("Parsing signatures...\n");
     }
 
-    FILE* out_file = fopen("build/ir.c", "wb");
+    ParserOptions parser_options = { .thread_count = 1, .lazy_bodies = true };
+    TokenStream tokens;
+    token_stream_init(&tokens, module);
+    parser_parse(module, &tokens, &parser_options);
+    token_stream_report_errors(&tokens);
+    token_stream_deinit(&tokens);
+
+    if (module->has_errors) {
+        module_display_errors(module);
+        return false;
+    }
+
+    analyzer_register_items(module);
+
+    // the declarations go out before any body is read, so nothing is left out
+    callgraph_mark_all(module);
+    if (options->dead_report) {
+        callgraph_print_dropped(module);
+    }
+
+    FILE* out_file = open_output();
     if (out_file == null) {
-	    printf("Could not create ir\n");
-	    return null;
+        return false;
     }
 
-    fwrite(prelude_text, prelude_length, 1, out_file);
-    fwrite(ir.ptr, ir.len, 1, out_file);
+    CodegenContext codegen;
+    c_codegen_init(&codegen, module);
+    codegen.declare_unparsed = true;
+    write_output(out_file, c_codegen_declarations(&codegen));
 
-    fclose(out_file);
+    if (debug_info) {
+        printf(BOLDWHITE "Compiling fns\n" RESET);
+    }
+
+    InlineCheck inline_check;
+    callgraph_inline_check_init(&inline_check, module);
+    token_stream_init(&tokens, module);
+    for (item_id id = 1; id <= ast_item_count(ast); id += 1) {
+        if (ast_item(ast, id)->kind != ItemKind_FnDef) { continue; }
+
+        AstCounts ast_mark_before = ast_mark(ast);
+        ArenaMark arena_mark_before = arena_mark(&module->arena);
+
+        // the fns constants call were parsed and analyzed with them
+        bool analyzed = ast_item(ast, id)->fn_definition.body != 0;
+
+        // errors keep their messages in the arena, stop before releasing it
+        if (parser_parse_body_from(module, &tokens, id) == 0) { break; }
+        if (not analyzed) { analyzer_analyze_fn(module, id); }
+        callgraph_check_inlining(module, &inline_check, id);
+        write_output(out_file, c_codegen_definition(&codegen, id));
+
+        ast_item(ast, id)->fn_definition.body = 0;
+        ast_release(ast, ast_mark_before);
+        arena_release(&module->arena, arena_mark_before);
+    }
+    token_stream_deinit(&tokens);
+    callgraph_inline_check_deinit(&inline_check);
+
+    if (module->has_errors) {
+        module_display_errors(module);
+        return close_output(out_file, false);
+    }
+
+    return close_output(out_file, true);
+}
+
+Module* compiler_compile_module(String path, String source, CompilerOptions* options) {
+    bool debug_info = options->debug_info;
 
-    if (build) {
+    scan_init();
+
+    Module* module = malloc(sizeof(Module));
+    module_init(module, path, source);
+
+    bool compiled = options->stream_items ? compile_streamed(module, options) : compile_whole(module, options);
+    if (not compiled) {
+        compiler_free_module(module);
+        return null;
+    }
+
+    if (options->build) {
 	system("gcc -nostartfiles -O2 build/ir.c -o app");
     }
 
@@ -102,3 +323,8 @@ Module* compiler_compile_module(String path, String source, bool build, bool deb
 
     return module;
 }
+
+void compiler_free_module(Module* module) {
+    module_deinit(module);
+    free(module);
+}
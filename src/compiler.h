@@ -3,6 +3,49 @@
 
 #include "module.h"
 
-Module* compiler_compile_module(String path, String source, bool build, bool debug_info);
+#define VERSION_MAJOR 0
+#define VERSION_MINOR 0
+#define VERSION_PATCH 0
+
+typedef struct CompilerOptions {
+    bool build;
+    bool debug_info;
+    // 0 uses one thread per core
+    usize lex_threads;
+    usize parse_threads;
+    usize analyze_threads;
+    // lex while parsing instead of up front, tokens aren't kept around
+    bool stream_tokens;
+    // fn bodies are only parsed once something calls them, all of them are
+    // with keep all
+    bool lazy_bodies;
+    // directory parsed asts are cached in, null to always parse
+    const char* ast_cache;
+    // parse, analyze and write out one fn at a time after a pass over the
+    // signatures, memory then grows with the largest fn instead of the file.
+    // the token, thread, lazy body, cache and keep all options don't apply,
+    // only #[inline] and #[noinline] decide inlining, fns aren't marked
+    // pure or const, only declared noalias parameters get restrict, nothing
+    // is folded and there's no stack report.
+    bool stream_items;
+    // write out items nothing reachable from main, _start or a pub item uses
+    bool keep_all;
+    // list the items that were left out
+    bool dead_report;
+    // list what gcc is told about inlining each fn
+    bool inline_report;
+    // list the parameters that are written out with restrict
+    bool alias_report;
+    // list the fns written out as another fn with the same body
+    bool fold_report;
+    // compile the ir with gcc's -fstack-usage and list how deep the stack
+    // gets from each entry point
+    bool stack_report;
+} CompilerOptions;
+
+// null when it doesn't compile, the errors have been printed by then. the
+// module keeps pointing into source, which has to outlive it.
+Module* compiler_compile_module(String path, String source, CompilerOptions* options);
+void compiler_free_module(Module* module);
 
 #endif
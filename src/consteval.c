@@ -0,0 +1,584 @@
+#include "consteval.h"
+
+#include "ast.h"
+#include "util.h"
+#include <chnlib/dynarray.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <iso646.h>
+
+// evaluations taking longer than this are given up on, they likely never end
+#define CONSTEVAL_MAX_STEPS (16 * 1024 * 1024)
+#define CONSTEVAL_MAX_DEPTH 256
+#define CONSTEVAL_INITIAL_LOCALS 64
+
+// the value of a constant that is being evaluated, to catch cycles
+#define CONST_IN_PROGRESS UINT32_MAX
+
+
+// how evaluating an expression ended. everything but Value unwinds up to
+// whatever handles it (the loop, the call), Fail up to the constant.
+typedef enum EvalFlow {
+    EvalFlow_Value,
+    EvalFlow_Break,
+    EvalFlow_Continue,
+    EvalFlow_Return,
+    // it can't be done at compile time
+    EvalFlow_Fail,
+} EvalFlow;
+
+typedef struct EvalLocal {
+    symbol_id name;
+    ConstValue value;
+} EvalLocal;
+
+typedef struct EvalContext {
+    Module* module;
+    Ast* ast;
+
+    // locals of every call being run, innermost last
+    EvalLocal* locals;
+    usize local_count;
+    usize local_capacity;
+    // the first local of the call being run, the ones below it are hidden
+    usize frame;
+
+    usize depth;
+    usize steps;
+
+    // fns that were called without their body parsed, when the caller
+    // wants to know
+    DynArray(item_id)* unparsed;
+} EvalContext;
+
+static EvalFlow eval_expression(EvalContext* context, expr_id expression_id, ConstValue* out);
+
+static ConstValue void_value(void) {
+    ConstValue value;
+    value.kind = ConstValueKind_Void;
+    value.integer = 0;
+    return value;
+}
+
+static ConstValue int_value(u64 integer) {
+    ConstValue value;
+    value.kind = ConstValueKind_Int;
+    value.integer = integer;
+    return value;
+}
+
+static ConstValue bool_value(bool boolean) {
+    ConstValue value;
+    value.kind = ConstValueKind_Bool;
+    value.boolean = boolean;
+    return value;
+}
+
+static void push_local(EvalContext* context, symbol_id name, ConstValue value) {
+    if (context->local_count == context->local_capacity) {
+        context->local_capacity *= 2;
+        context->locals = realloc(context->locals, sizeof(EvalLocal) * context->local_capacity);
+    }
+
+    context->locals[context->local_count] = (EvalLocal){ name, value };
+    context->local_count += 1;
+}
+
+// the innermost local of the running call with that name
+static EvalLocal* find_local(EvalContext* context, symbol_id name) {
+    for (usize i = context->local_count; i > context->frame; i -= 1) {
+        if (context->locals[i - 1].name == name) {
+            return &context->locals[i - 1];
+        }
+    }
+    return null;
+}
+
+// the conversion C does when a value is assigned to the type
+static EvalFlow convert(EvalContext* context, ConstValue value, type_id type, ConstValue* out) {
+    TypeEntry* entry = typetable_get(&context->module->type_table, type);
+    switch (entry->kind) {
+        case TypeEntryKind_Bool: {
+            if (value.kind == ConstValueKind_Int) {
+                *out = bool_value(value.integer != 0);
+                return EvalFlow_Value;
+            }
+            if (value.kind != ConstValueKind_Bool) { return EvalFlow_Fail; }
+
+            *out = value;
+            return EvalFlow_Value;
+        }
+
+        case TypeEntryKind_Int:
+        case TypeEntryKind_Size: {
+            u64 integer;
+            if (value.kind == ConstValueKind_Int) {
+                integer = value.integer;
+            } else if (value.kind == ConstValueKind_Bool) {
+                integer = value.boolean;
+            } else {
+                return EvalFlow_Fail;
+            }
+
+            if (entry->bits < 64) {
+                u64 sign = (u64)1 << (entry->bits - 1);
+                integer &= (sign << 1) - 1;
+                if (entry->integral.is_signed and (integer & sign) != 0) {
+                    integer |= ~((sign << 1) - 1);
+                }
+            }
+
+            *out = int_value(integer);
+            return EvalFlow_Value;
+        }
+
+        // string literals are the only pointers known at compile time
+        case TypeEntryKind_Ptr: {
+            if (value.kind != ConstValueKind_Str) { return EvalFlow_Fail; }
+
+            *out = value;
+            return EvalFlow_Value;
+        }
+
+        case TypeEntryKind_Fn: {
+            if (value.kind != ConstValueKind_Fn) { return EvalFlow_Fail; }
+
+            *out = value;
+            return EvalFlow_Value;
+        }
+
+        default: return EvalFlow_Fail;
+    }
+}
+
+// like convert, but fails when the conversion changes the value. what it
+// would be at runtime isn't guessed at, the constant is left to gcc.
+static EvalFlow convert_exact(EvalContext* context, ConstValue value, type_id type, ConstValue* out) {
+    ConstValue converted;
+    EvalFlow flow = convert(context, value, type, &converted);
+    if (flow != EvalFlow_Value) { return flow; }
+    if (value.kind == ConstValueKind_Int and converted.kind == ConstValueKind_Int and converted.integer != value.integer) {
+        return EvalFlow_Fail;
+    }
+
+    *out = converted;
+    return EvalFlow_Value;
+}
+
+// the prelude does arithmetic and comparisons on i32s, whatever the types
+// of the operands. operands that don't fit an i32 and results that overflow
+// one aren't folded.
+static EvalFlow eval_bin_op_kind(EvalContext* context, Expr* expression, ConstValue left, ConstValue right, ConstValue* out) {
+    BinOpKind kind = expression->binary_operator.kind;
+    if (kind == BinOpKind_And or kind == BinOpKind_Or) {
+        ConstValue left_bool, right_bool;
+        type_id entry_bool = context->module->primitives.entry_bool;
+        if (
+            convert(context, left, entry_bool, &left_bool) != EvalFlow_Value or
+            convert(context, right, entry_bool, &right_bool) != EvalFlow_Value
+        ) {
+            return EvalFlow_Fail;
+        }
+
+        bool result = kind == BinOpKind_And ?
+            left_bool.boolean and right_bool.boolean :
+            left_bool.boolean or right_bool.boolean;
+        *out = bool_value(result);
+        return EvalFlow_Value;
+    }
+
+    ConstValue left_i32, right_i32;
+    type_id entry_i32 = context->module->primitives.entry_i32;
+    if (
+        convert_exact(context, left, entry_i32, &left_i32) != EvalFlow_Value or
+        convert_exact(context, right, entry_i32, &right_i32) != EvalFlow_Value
+    ) {
+        return EvalFlow_Fail;
+    }
+
+    // i32s can't overflow an i64
+    i64 a = (i64)left_i32.integer;
+    i64 b = (i64)right_i32.integer;
+    i64 result;
+    switch (kind) {
+        case BinOpKind_CmpEq: *out = bool_value(a == b); return EvalFlow_Value;
+        case BinOpKind_CmpNotEq: *out = bool_value(a != b); return EvalFlow_Value;
+        case BinOpKind_CmpGt: *out = bool_value(a > b); return EvalFlow_Value;
+        case BinOpKind_CmpLt: *out = bool_value(a < b); return EvalFlow_Value;
+
+        case BinOpKind_Add: result = a + b; break;
+        case BinOpKind_Sub: result = a - b; break;
+        case BinOpKind_Mul: result = a * b; break;
+
+        // these trap at runtime
+        case BinOpKind_Div: {
+            if (b == 0) { return EvalFlow_Fail; }
+            result = a / b;
+            break;
+        }
+
+        default: return EvalFlow_Fail;
+    }
+
+    // signed overflow is undefined in the prelude's C
+    if (result < INT32_MIN or result > INT32_MAX) { return EvalFlow_Fail; }
+    return convert(context, int_value((u64)result), expression->codegen.type, out);
+}
+
+// writes to a local of the running call, the prelude's wri32 stores an i32
+static EvalFlow eval_assign(EvalContext* context, Expr* expression, ConstValue* out) {
+    Expr* target = ast_expr(context->ast, expression->binary_operator.left);
+    if (target->kind != ExprKind_Symbol) { return EvalFlow_Fail; }
+
+    ConstValue value;
+    EvalFlow flow = eval_expression(context, expression->binary_operator.right, &value);
+    if (flow != EvalFlow_Value) {
+        *out = value;
+        return flow;
+    }
+
+    // constants can't be written to
+    EvalLocal* local = find_local(context, target->symbol);
+    if (local == null) { return EvalFlow_Fail; }
+
+    flow = convert_exact(context, value, context->module->primitives.entry_i32, &local->value);
+    *out = void_value();
+    return flow;
+}
+
+// left-deep chains are walked down to their first operand and evaluated on
+// the way back up, like the analyzer does
+static EvalFlow eval_bin_op(EvalContext* context, expr_id expression_id, ConstValue* out) {
+    Ast* ast = context->ast;
+
+    ExprStack chain;
+    expr_stack_init(&chain);
+
+    expr_id left = expression_id;
+    while (ast_expr(ast, left)->kind == ExprKind_BinOp and ast_expr(ast, left)->binary_operator.kind != BinOpKind_Assign) {
+        expr_stack_push(&chain, left);
+        left = ast_expr(ast, left)->binary_operator.left;
+    }
+
+    ConstValue value;
+    EvalFlow flow = eval_expression(context, left, &value);
+    while (flow == EvalFlow_Value and chain.len > 0) {
+        Expr* expression = ast_expr(ast, expr_stack_pop(&chain));
+
+        ConstValue right;
+        flow = eval_expression(context, expression->binary_operator.right, &right);
+        if (flow != EvalFlow_Value) {
+            value = right;
+            break;
+        }
+
+        flow = eval_bin_op_kind(context, expression, value, right, &value);
+    }
+
+    expr_stack_deinit(&chain);
+    *out = value;
+    return flow;
+}
+
+static EvalFlow eval_block(EvalContext* context, Block* block, ConstValue* out) {
+    Ast* ast = context->ast;
+    if (block->statements.len == 0) {
+        *out = void_value();
+        return EvalFlow_Value;
+    }
+
+    stmt_id* statements = ast_list(ast, block->statements, stmt_id);
+    usize local_count = context->local_count;
+
+    ConstValue value = void_value();
+    EvalFlow flow = EvalFlow_Value;
+    for (usize i = 0; i < block->statements.len and flow == EvalFlow_Value; i += 1) {
+        flow = eval_expression(context, ast_stmt(ast, statements[i])->expression, &value);
+    }
+
+    context->local_count = local_count;
+    if (flow != EvalFlow_Value) {
+        *out = value;
+        return flow;
+    }
+
+    // the block only has the value of its last statement when the analyzer
+    // gave it that statement's type
+    Stmt* last_stmt = ast_stmt(ast, statements[block->statements.len - 1]);
+    if (
+        last_stmt->kind == StmtKind_NakedExpr or
+        (last_stmt->kind == StmtKind_Expr and should_remove_statement_semi(ast_expr(ast, last_stmt->expression)))
+    ) {
+        *out = value;
+    } else {
+        *out = void_value();
+    }
+    return EvalFlow_Value;
+}
+
+// else if ladders are walked in a loop
+static EvalFlow eval_if(EvalContext* context, expr_id expression_id, ConstValue* out) {
+    Ast* ast = context->ast;
+    expr_id current = expression_id;
+    while (true) {
+        If* if_expr = &ast_expr(ast, current)->if_expr;
+
+        ConstValue condition;
+        EvalFlow flow = eval_expression(context, if_expr->condition, &condition);
+        if (flow != EvalFlow_Value) {
+            *out = condition;
+            return flow;
+        }
+        if (condition.kind != ConstValueKind_Bool) { return EvalFlow_Fail; }
+
+        if (condition.boolean) {
+            return eval_expression(context, if_expr->then, out);
+        }
+        if (if_expr->otherwise == 0) {
+            *out = void_value();
+            return EvalFlow_Value;
+        }
+        if (ast_expr(ast, if_expr->otherwise)->kind != ExprKind_If) {
+            return eval_expression(context, if_expr->otherwise, out);
+        }
+
+        current = if_expr->otherwise;
+    }
+}
+
+static EvalFlow eval_loop(EvalContext* context, Loop* loop, ConstValue* out) {
+    while (true) {
+        EvalFlow flow = eval_expression(context, loop->body, out);
+        switch (flow) {
+            case EvalFlow_Value:
+            case EvalFlow_Continue: break;
+            case EvalFlow_Break: {
+                *out = void_value();
+                return EvalFlow_Value;
+            }
+            default: return flow;
+        }
+    }
+}
+
+static bool eval_constant(EvalContext* context, SymEntry* entry);
+
+// locals of the running call first, constants second, fns last
+static EvalFlow eval_symbol(EvalContext* context, symbol_id name, ConstValue* out) {
+    EvalLocal* local = find_local(context, name);
+    if (local != null) {
+        *out = local->value;
+        return EvalFlow_Value;
+    }
+
+    // no scope is open, only constants are left
+    SymEntry* entry = symtable_get(&context->module->symbol_table, name);
+    if (entry == null) {
+        item_id id = module_get_item(context->module, name);
+        if (id == 0 or ast_item(context->ast, id)->kind == ItemKind_Const) { return EvalFlow_Fail; }
+
+        out->kind = ConstValueKind_Fn;
+        out->fn = id;
+        return EvalFlow_Value;
+    }
+    if (not eval_constant(context, entry)) { return EvalFlow_Fail; }
+
+    *out = *consteval_get(context->module, entry->value);
+    return EvalFlow_Value;
+}
+
+// arguments go on the locals with no name until they're all evaluated, so
+// they don't hide the caller's locals in the meantime
+static EvalFlow eval_call(EvalContext* context, item_id id, FnCall* call, ConstValue* out) {
+    Ast* ast = context->ast;
+
+    // extern fns could do anything
+    Item* item = ast_item(ast, id);
+    if (item->kind != ItemKind_FnDef) { return EvalFlow_Fail; }
+    if (item->fn_definition.body == 0) {
+        if (context->unparsed != null) { dynarray_push(*context->unparsed, &id); }
+        return EvalFlow_Fail;
+    }
+    if (call->arguments.len != item->fn_definition.signature.parameters.len) { return EvalFlow_Fail; }
+    if (context->depth >= CONSTEVAL_MAX_DEPTH) { return EvalFlow_Fail; }
+
+    usize frame = context->local_count;
+    expr_id* arguments = ast_list(ast, call->arguments, expr_id);
+    for (usize i = 0; i < call->arguments.len; i += 1) {
+        ConstValue argument;
+        EvalFlow flow = eval_expression(context, arguments[i], &argument);
+        if (flow != EvalFlow_Value) {
+            context->local_count = frame;
+            *out = argument;
+            return flow;
+        }
+        push_local(context, 0, argument);
+    }
+
+    FnDef* fn_definition = &item->fn_definition;
+    FnParam* parameters = ast_list(ast, fn_definition->signature.parameters, FnParam);
+    for (usize i = 0; i < fn_definition->signature.parameters.len; i += 1) {
+        context->locals[frame + i].name = parameters[i].name;
+    }
+
+    usize caller_frame = context->frame;
+    context->frame = frame;
+    context->depth += 1;
+
+    EvalFlow flow = eval_expression(context, fn_definition->body, out);
+
+    context->depth -= 1;
+    context->frame = caller_frame;
+    context->local_count = frame;
+
+    switch (flow) {
+        case EvalFlow_Value:
+        case EvalFlow_Return: return EvalFlow_Value;
+        // can't leave the fn
+        default: return EvalFlow_Fail;
+    }
+}
+
+static EvalFlow eval_expression(EvalContext* context, expr_id expression_id, ConstValue* out) {
+    context->steps += 1;
+    if (context->steps > CONSTEVAL_MAX_STEPS) { return EvalFlow_Fail; }
+
+    Expr* expression = ast_expr(context->ast, expression_id);
+    switch (expression->kind) {
+        case ExprKind_NumberLit: {
+            // C gives a literal a type wide enough for it, it has to fit
+            // the one it was given here
+            String digits = ast_span(context->ast, expression->number_literal.span);
+            u64 integer = 0;
+            for (usize i = 0; i < digits.len; i += 1) {
+                u64 digit = (u64)(digits.ptr[i] - '0');
+                if (integer > (UINT64_MAX - digit) / 10) { return EvalFlow_Fail; }
+                integer = integer * 10 + digit;
+            }
+            return convert_exact(context, int_value(integer), expression->codegen.type, out);
+        }
+
+        case ExprKind_BoolLit: {
+            *out = bool_value(expression->boolean);
+            return EvalFlow_Value;
+        }
+
+        case ExprKind_StringLit: {
+            out->kind = ConstValueKind_Str;
+            out->string = expression->string_literal.span;
+            return EvalFlow_Value;
+        }
+
+        case ExprKind_Symbol: return eval_symbol(context, expression->symbol, out);
+
+        case ExprKind_BinOp: {
+            if (expression->binary_operator.kind == BinOpKind_Assign) {
+                return eval_assign(context, expression, out);
+            }
+            return eval_bin_op(context, expression_id, out);
+        }
+
+        case ExprKind_Cast: {
+            ConstValue value;
+            EvalFlow flow = eval_expression(context, expression->cast.expr, &value);
+            if (flow != EvalFlow_Value) {
+                *out = value;
+                return flow;
+            }
+            return convert(context, value, expression->codegen.type, out);
+        }
+
+        case ExprKind_Let: {
+            ConstValue value;
+            EvalFlow flow = eval_expression(context, expression->let.value, &value);
+            if (flow != EvalFlow_Value) {
+                *out = value;
+                return flow;
+            }
+
+            push_local(context, expression->let.name, value);
+            *out = void_value();
+            return EvalFlow_Value;
+        }
+
+        case ExprKind_Block: return eval_block(context, &expression->block, out);
+        case ExprKind_If: return eval_if(context, expression_id, out);
+        case ExprKind_Loop: return eval_loop(context, &expression->loop, out);
+        case ExprKind_FnCall: {
+            item_id id = module_get_item(context->module, expression->fn_call.name);
+            return eval_call(context, id, &expression->fn_call, out);
+        }
+
+        // the fn is whatever the local or constant holds
+        case ExprKind_IndirectCall: {
+            ConstValue fn;
+            EvalFlow flow = eval_symbol(context, expression->fn_call.name, &fn);
+            if (flow != EvalFlow_Value or fn.kind != ConstValueKind_Fn) { return EvalFlow_Fail; }
+
+            return eval_call(context, fn.fn, &expression->fn_call, out);
+        }
+
+        case ExprKind_Ret: {
+            EvalFlow flow = eval_expression(context, expression->ret, out);
+            return flow == EvalFlow_Value ? EvalFlow_Return : flow;
+        }
+
+        case ExprKind_Break: {
+            *out = void_value();
+            return EvalFlow_Break;
+        }
+        case ExprKind_Continue: {
+            *out = void_value();
+            return EvalFlow_Continue;
+        }
+
+        // asm has side effects, unreachable code ending up here has none
+        default: return EvalFlow_Fail;
+    }
+}
+
+// a constant is evaluated the first time it's needed, in a frame of its own.
+// one that can't be gets a void value.
+static bool eval_constant(EvalContext* context, SymEntry* entry) {
+    if (entry->value == CONST_IN_PROGRESS) { return false; }
+    if (entry->value != 0) { return consteval_get(context->module, entry->value)->kind != ConstValueKind_Void; }
+
+    entry->value = CONST_IN_PROGRESS;
+    usize frame = context->frame;
+    usize local_count = context->local_count;
+    context->frame = local_count;
+
+    ConstValue value;
+    EvalFlow flow = eval_expression(context, entry->expression, &value);
+    context->frame = frame;
+    context->local_count = local_count;
+
+    if (flow != EvalFlow_Value) { value = void_value(); }
+
+    entry->value = dynarray_len(context->module->const_values);
+    dynarray_push(context->module->const_values, &value);
+    return value.kind != ConstValueKind_Void;
+}
+
+void consteval_constants(Module* module, DynArray(item_id)* unparsed) {
+    EvalContext context;
+    context.module = module;
+    context.ast = &module->ast;
+    context.local_capacity = CONSTEVAL_INITIAL_LOCALS;
+    context.locals = malloc(sizeof(EvalLocal) * context.local_capacity);
+    context.local_count = 0;
+    context.frame = 0;
+    context.depth = 0;
+    context.unparsed = unparsed;
+
+    // no scope is open, so these are all in the root scope
+    SymTable* symbol_table = &module->symbol_table;
+    for (usize i = 0; i < symbol_table->binding_count; i += 1) {
+        SymBinding* binding = &symbol_table->bindings[i];
+
+        context.steps = 0;
+        eval_constant(&context, &binding->entry);
+    }
+
+    free(context.locals);
+}
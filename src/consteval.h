@@ -0,0 +1,42 @@
+#ifndef CONSTEVAL_H
+#define CONSTEVAL_H
+
+#include "module.h"
+
+
+// compile time evaluation of analyzed expressions. constants are folded
+// into values so they can be written out as plain literals, calls to fns
+// without side effects included: their bodies are run by an interpreter.
+
+typedef enum ConstValueKind {
+    ConstValueKind_Void,
+    ConstValueKind_Int,
+    ConstValueKind_Bool,
+    ConstValueKind_Str,
+    ConstValueKind_Fn,
+} ConstValueKind;
+
+typedef struct ConstValue {
+    ConstValueKind kind;
+    union {
+        // sign extended from the width of its type when that's signed
+        u64 integer;
+        bool boolean;
+        // the literal, quotes included
+        AstSpan string;
+        // a fn or extern fn
+        item_id fn;
+    };
+} ConstValue;
+
+// evaluates every constant in the root scope, in order. the fns they call
+// have to be analyzed already. one that can't be evaluated gets a void value
+// and is written out as its expression. the fns called whose bodies weren't
+// parsed are added to unparsed, unless it's null.
+void consteval_constants(Module* module, DynArray(item_id)* unparsed);
+
+static inline ConstValue* consteval_get(Module* module, const_id value) {
+    return &module->const_values[value];
+}
+
+#endif // !CONSTEVAL_H
@@ -0,0 +1,105 @@
+#include "intern.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define INTERN_INITIAL_CAPACITY 1024
+
+
+static u32 hash_string(String string) {
+    // fnv-1a
+    u32 hash = 2166136261u;
+    for (usize i = 0; i < string.len; i += 1) {
+        hash ^= (u8)string.ptr[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void grow(InternTable* table) {
+    usize capacity = table->capacity * 2;
+    symbol_id* slots = calloc(capacity, sizeof(symbol_id));
+
+    for (usize i = 0; i < table->capacity; i += 1) {
+        symbol_id id = table->slots[i];
+        if (id == 0) { continue; }
+
+        usize slot = table->hashes[id] & (capacity - 1);
+        while (slots[slot] != 0) { slot = (slot + 1) & (capacity - 1); }
+        slots[slot] = id;
+    }
+
+    free(table->slots);
+    table->slots = slots;
+    table->capacity = capacity;
+}
+
+// returns the slot holding the string, or the empty slot it would go in
+static usize find_slot(InternTable* table, String string, u32 hash) {
+    usize slot = hash & (table->capacity - 1);
+    while (true) {
+        symbol_id id = table->slots[slot];
+        if (id == 0) { return slot; }
+
+        String existing = table->strings[id];
+        if (table->hashes[id] == hash and
+            existing.len == string.len and
+            memcmp(existing.ptr, string.ptr, string.len) == 0
+        ) {
+            return slot;
+        }
+
+        slot = (slot + 1) & (table->capacity - 1);
+    }
+}
+
+void intern_init(InternTable* table) {
+    table->strings = dynarray_init();
+    table->hashes = dynarray_init();
+    table->capacity = INTERN_INITIAL_CAPACITY;
+    table->slots = calloc(table->capacity, sizeof(symbol_id));
+
+    // symbol_id = 0 is invalid
+    String empty = { 0 };
+    u32 no_hash = 0;
+    dynarray_push(table->strings, &empty);
+    dynarray_push(table->hashes, &no_hash);
+}
+
+void intern_deinit(InternTable* table) {
+    dynarray_deinit(table->strings);
+    dynarray_deinit(table->hashes);
+    free(table->slots);
+}
+
+symbol_id intern_string(InternTable* table, String string) {
+    u32 hash = hash_string(string);
+    usize slot = find_slot(table, string, hash);
+    if (table->slots[slot] != 0) {
+        return table->slots[slot];
+    }
+
+    symbol_id id = dynarray_len(table->strings);
+    dynarray_push(table->strings, &string);
+    dynarray_push(table->hashes, &hash);
+    table->slots[slot] = id;
+
+    // keep the load factor under a half
+    if (dynarray_len(table->strings) * 2 > table->capacity) {
+        grow(table);
+    }
+
+    return id;
+}
+
+symbol_id intern_find(InternTable* table, String string) {
+    return table->slots[find_slot(table, string, hash_string(string))];
+}
+
+String intern_get(InternTable* table, symbol_id id) {
+    return table->strings[id];
+}
+
+usize intern_count(InternTable* table) {
+    return dynarray_len(table->strings);
+}
@@ -0,0 +1,33 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <chnlib/chntype.h>
+#include <chnlib/str.h>
+#include <chnlib/dynarray.h>
+
+
+// dense ids for identifiers. the lexer interns every symbol token so the
+// rest of the compiler can compare and hash names as integers.
+// symbol_id = 0 is invalid
+typedef u32 symbol_id;
+
+typedef struct InternTable {
+    // indexed by symbol_id
+    DynArray(String) strings;
+    DynArray(u32) hashes;
+
+    // open addressing, each slot holds a symbol_id or 0
+    symbol_id* slots;
+    usize capacity;
+} InternTable;
+
+
+void intern_init(InternTable* table);
+void intern_deinit(InternTable* table);
+
+symbol_id intern_string(InternTable* table, String string);
+symbol_id intern_find(InternTable* table, String string);
+String intern_get(InternTable* table, symbol_id id);
+usize intern_count(InternTable* table);
+
+#endif // !INTERN_H
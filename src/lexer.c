@@ -1,9 +1,14 @@
 #include "lexer.h"
 
 #include "token.h"
+#include "scan.h"
+#include "threadpool.h"
 #include "util.h"
 
 #include <chnlib/logger.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 #define WHITESPACE \
     ' ': \
@@ -42,198 +47,269 @@ typedef enum LexerState {
     LexerState_MultilineComment,
 } LexerState;
 
-typedef struct LexerContext {
-    Module* module;
+// sources smaller than this are never split
+#define LEXER_MIN_CHUNK_SIZE (256 * 1024)
+
+struct LexerContext {
+    String source;
+    TokenList* tokens;
+    // null when lexing a chunk, symbols are interned after the merge
+    InternTable* names;
     usize offset;
+    usize end;
     LexerState state;
-    TextPosition position;
-    Token* current_token;
-} LexerContext;
+    usize current_token;
+    // lexing pauses between tokens once this many are in the list
+    usize token_limit;
+
+    // set when an unexpected character stops the lexer
+    bool failed;
+    char failed_char;
+};
+
+typedef struct LexerChunk {
+    LexerContext context;
+    TokenList tokens;
+} LexerChunk;
+
+// keywords are classified with a perfect hash of the first two characters
+// and the length. a new keyword that collides with an existing slot trips
+// -Woverride-init (-Wextra), so pick another multiplier if that happens.
+#define KEYWORD_TABLE_SIZE 64
+#define KEYWORD_HASH(first, second, len) \
+    (((usize)(u8)(first) + (usize)(u8)(second) * 9 + (usize)(len)) & (KEYWORD_TABLE_SIZE - 1))
+#define KEYWORD(first, second, text, kind) \
+    [KEYWORD_HASH(first, second, sizeof(text) - 1)] = { text, sizeof(text) - 1, kind }
+
+typedef struct Keyword {
+    const char* text;
+    usize len;
+    TokenKind kind;
+} Keyword;
+
+static const Keyword keyword_table[KEYWORD_TABLE_SIZE] = {
+    KEYWORD('u', 'n', "unreachable", TokenKind_KeywordUnreachable),
+    KEYWORD('a', 's', "as",          TokenKind_KeywordAs),
+    KEYWORD('a', 's', "asm",         TokenKind_KeywordAsm),
+    KEYWORD('v', 'o', "volatile",    TokenKind_KeywordVolatile),
+    KEYWORD('f', 'n', "fn",          TokenKind_KeywordFn),
+    KEYWORD('r', 'e', "return",      TokenKind_KeywordReturn),
+    KEYWORD('l', 'e', "let",         TokenKind_KeywordLet),
+    KEYWORD('e', 'x', "extern",      TokenKind_KeywordExtern),
+    KEYWORD('i', 'f', "if",          TokenKind_KeywordIf),
+    KEYWORD('m', 'a', "match",       TokenKind_KeywordMatch),
+    KEYWORD('e', 'l', "else",        TokenKind_KeywordElse),
+    KEYWORD('t', 'r', "true",        TokenKind_KeywordTrue),
+    KEYWORD('f', 'a', "false",       TokenKind_KeywordFalse),
+    KEYWORD('t', 'y', "type",        TokenKind_KeywordType),
+    KEYWORD('p', 'u', "pub",         TokenKind_KeywordPub),
+    KEYWORD('c', 'o', "const",       TokenKind_KeywordConst),
+    KEYWORD('l', 'o', "loop",        TokenKind_KeywordLoop),
+    KEYWORD('b', 'r', "break",       TokenKind_KeywordBreak),
+    KEYWORD('c', 'o', "continue",    TokenKind_KeywordContinue),
+    KEYWORD('a', 'n', "and",         TokenKind_KeywordAnd),
+    KEYWORD('o', 'r', "or",          TokenKind_KeywordOr),
+    KEYWORD('n', 'o', "not",         TokenKind_KeywordNot),
+    KEYWORD('m', 'u', "mut",         TokenKind_KeywordMut),
+};
+
+static TokenKind keyword_lookup(String span) {
+    // every keyword is at least two characters long
+    if (span.len < 2) { return TokenKind_Symbol; }
+
+    const Keyword* keyword = &keyword_table[KEYWORD_HASH(span.ptr[0], span.ptr[1], span.len)];
+    if (keyword->len == span.len and memcmp(keyword->text, span.ptr, span.len) == 0) {
+        return keyword->kind;
+    }
 
-static char get_char(LexerContext* context, unsigned int offset) {
-    return *(context->module->source.ptr + offset);
+    return TokenKind_Symbol;
+}
+
+static char get_char(LexerContext* context, usize offset) {
+    // sources are not null terminated, reading past the end gives a 0
+    if (offset >= context->source.len) { return 0; }
+    return *(context->source.ptr + offset);
+}
+
+static usize find_byte(const char* ptr, usize len, char byte) {
+    const char* found = memchr(ptr, byte, len);
+    return found == null ? len : (usize)(found - ptr);
+}
+
+// consumes the bytes the current state would step over without acting on.
+// the state machine still sees the byte that ends the run.
+static void skip_run(LexerContext* context) {
+    const char* ptr = context->source.ptr + context->offset;
+    usize remaining = context->end - context->offset;
+
+    switch (context->state) {
+        case LexerState_Start: context->offset += scan_whitespace(ptr, remaining); break;
+        case LexerState_Symbol: context->offset += scan_identifier(ptr, remaining); break;
+        case LexerState_String: context->offset += find_byte(ptr, remaining, '"'); break;
+        case LexerState_Comment: context->offset += find_byte(ptr, remaining, '\n'); break;
+        case LexerState_MultilineComment: context->offset += find_byte(ptr, remaining, '*'); break;
+        default: break;
+    }
 }
 
 static void begin_token(LexerContext* context, TokenKind kind) {
-    context->current_token = dynarray_add(context->module->token_list);
+    context->current_token = token_list_push(context->tokens, kind, context->offset);
+}
 
-    Token* token = context->current_token;
-    token->kind = kind;
-    token->position = context->position;
-    token->span.ptr = context->module->source.ptr + context->offset;
+static void set_token_kind(LexerContext* context, TokenKind kind) {
+    context->tokens->kinds[context->current_token] = kind;
 }
 
 static void end_token(LexerContext* context) {
-    Token* token = context->current_token;
-    token->span.len = (context->offset - (usize)(token->span.ptr - context->module->source.ptr)) + 1;
-
-    if (token->kind == TokenKind_Symbol) {
-        if (token_compare_literal(token, "unreachable")) {
-            token->kind = TokenKind_KeywordUnreachable;
-        } else if (token_compare_literal(token, "as")) {
-            token->kind = TokenKind_KeywordAs;
-        } else if (token_compare_literal(token, "asm")) {
-            token->kind = TokenKind_KeywordAsm;
-        } else if (token_compare_literal(token, "volatile")) {
-            token->kind = TokenKind_KeywordVolatile;
-        } else if (token_compare_literal(token, "fn")) {
-            token->kind = TokenKind_KeywordFn;
-        } else if (token_compare_literal(token, "return")) {
-            token->kind = TokenKind_KeywordReturn;
-        } else if (token_compare_literal(token, "let")) {
-            token->kind = TokenKind_KeywordLet;
-        } else if (token_compare_literal(token, "extern")) {
-            token->kind = TokenKind_KeywordExtern;
-        } else if (token_compare_literal(token, "if")) {
-            token->kind = TokenKind_KeywordIf;
-	} else if (token_compare_literal(token, "match")) {
-	    token->kind = TokenKind_KeywordMatch;
-        } else if (token_compare_literal(token, "else")) {
-            token->kind = TokenKind_KeywordElse;
-        } else if (token_compare_literal(token, "true")) {
-            token->kind = TokenKind_KeywordTrue;
-        } else if (token_compare_literal(token, "false")) {
-            token->kind = TokenKind_KeywordFalse;
-        } else if (token_compare_literal(token, "type")) {
-            token->kind = TokenKind_KeywordType;
-        } else if (token_compare_literal(token, "pub")) {
-	    token->kind = TokenKind_KeywordPub;
-	} else if (token_compare_literal(token, "const")) {
-	    token->kind = TokenKind_KeywordConst;
-	} else if (token_compare_literal(token, "loop")) {
-	    token->kind = TokenKind_KeywordLoop;
-	} else if (token_compare_literal(token, "break")) {
-	    token->kind = TokenKind_KeywordBreak;
-	} else if (token_compare_literal(token, "continue")) {
-	    token->kind = TokenKind_KeywordContinue;
-        } else if (token_compare_literal(token, "and")) {
-	    token->kind = TokenKind_KeywordAnd;
-        } else if (token_compare_literal(token, "or")) {
-	    token->kind = TokenKind_KeywordOr;
-        } else if (token_compare_literal(token, "not")) {
-	    token->kind = TokenKind_KeywordNot;
-        } else if (token_compare_literal(token, "mut")) {
-            token->kind = TokenKind_KeywordMut;
+    TokenList* tokens = context->tokens;
+    usize index = context->current_token;
+    tokens->lengths[index] = (context->offset - tokens->starts[index]) + 1;
+
+    if (tokens->kinds[index] == TokenKind_Symbol) {
+        Token token = token_list_get(tokens, index);
+        tokens->kinds[index] = keyword_lookup(token.span);
+        if (tokens->kinds[index] == TokenKind_Symbol and context->names != null) {
+            tokens->symbols[index] = intern_string(context->names, token.span);
         }
     }
 }
 
-void lexer_lex(Module* module) {
-    LexerContext context;
-    context.module = module;
-    context.offset = 0;
-    context.state = LexerState_Start;
-    context.position = (TextPosition){ 1, 1};
-    context.current_token = 0;
+static void lexer_context_init(LexerContext* context, Module* module, TokenList* tokens, usize start, usize end) {
+    context->source = module->source;
+    context->tokens = tokens;
+    context->names = &module->names;
+    context->offset = start;
+    context->end = end;
+    context->state = LexerState_Start;
+    context->current_token = 0;
+    context->token_limit = SIZE_MAX;
+    context->failed = false;
+    context->failed_char = 0;
+}
+
+// lexes from the context's offset up to its end or token limit. lexing can
+// be resumed later with a larger end or limit.
+static void lex_range(LexerContext* context) {
+    for (; context->offset < context->end; context->offset++) {
+        if (context->state == LexerState_Start and token_list_len(context->tokens) >= context->token_limit) {
+            return;
+        }
 
-    context.module->token_list = dynarray_init();
+        skip_run(context);
+        if (context->offset >= context->end) { break; }
 
-    for (context.offset = 0; context.offset < module->source.len; context.offset++) {
-        char current_char = get_char(&context, context.offset);
+        char current_char = get_char(context, context->offset);
 
-        switch (context.state) {
+        switch (context->state) {
 
             case LexerState_Start:
                 switch (current_char) {
                     case WHITESPACE: break;
                     case ALPHA:
                     case '_':
-                        begin_token(&context, TokenKind_Symbol);
-                        context.state = LexerState_Symbol;
+                        begin_token(context, TokenKind_Symbol);
+                        context->state = LexerState_Symbol;
                         break;
                     case DIGIT:
-                        begin_token(&context, TokenKind_NumberLiteral);
-                        context.state = LexerState_Number;
+                        begin_token(context, TokenKind_NumberLiteral);
+                        context->state = LexerState_Number;
                         break;
                     case '"':
-                        begin_token(&context, TokenKind_StringLiteral);
-                        context.state = LexerState_String;
+                        begin_token(context, TokenKind_StringLiteral);
+                        context->state = LexerState_String;
                         break;
                     case ';':
-                        begin_token(&context, TokenKind_Semicolon);
-                        end_token(&context);
+                        begin_token(context, TokenKind_Semicolon);
+                        end_token(context);
                         break;
                     case ':':
-                        begin_token(&context, TokenKind_Colon);
-                        end_token(&context);
+                        begin_token(context, TokenKind_Colon);
+                        end_token(context);
                         break;
                     case ',':
-                        begin_token(&context, TokenKind_Comma);
-                        end_token(&context);
+                        begin_token(context, TokenKind_Comma);
+                        end_token(context);
                         break;
 		    case '.':
-			begin_token(&context, TokenKind_Dot);
-			context.state = LexerState_Dot;
+			begin_token(context, TokenKind_Dot);
+			context->state = LexerState_Dot;
 			break;
                     case '&':
-                        begin_token(&context, TokenKind_Ampersand);
-                        end_token(&context);
+                        begin_token(context, TokenKind_Ampersand);
+                        end_token(context);
                         break;
                     case '*':
-                        begin_token(&context, TokenKind_Star);
-                        end_token(&context);
+                        begin_token(context, TokenKind_Star);
+                        end_token(context);
                         break;
                     case '{':
-                        begin_token(&context, TokenKind_LBrace);
-                        end_token(&context);
+                        begin_token(context, TokenKind_LBrace);
+                        end_token(context);
                         break;
                     case '}':
-                        begin_token(&context, TokenKind_RBrace);
-                        end_token(&context);
+                        begin_token(context, TokenKind_RBrace);
+                        end_token(context);
                         break;
                     case '(':
-                        begin_token(&context, TokenKind_LParen);
-                        end_token(&context);
+                        begin_token(context, TokenKind_LParen);
+                        end_token(context);
                         break;
                     case ')':
-                        begin_token(&context, TokenKind_RParen);
-                        end_token(&context);
+                        begin_token(context, TokenKind_RParen);
+                        end_token(context);
+                        break;
+                    case '[':
+                        begin_token(context, TokenKind_LBracket);
+                        end_token(context);
+                        break;
+                    case ']':
+                        begin_token(context, TokenKind_RBracket);
+                        end_token(context);
+                        break;
+                    case '#':
+                        begin_token(context, TokenKind_Hash);
+                        end_token(context);
                         break;
                     case '~':
-                        begin_token(&context, TokenKind_Tilde);
-                        end_token(&context);
+                        begin_token(context, TokenKind_Tilde);
+                        end_token(context);
                         break;
                     case '!':
-                        begin_token(&context, TokenKind_Bang);
-                        context.state = LexerState_Bang;
+                        begin_token(context, TokenKind_Bang);
+                        context->state = LexerState_Bang;
                         break;
                     case '<':
-                        begin_token(&context, TokenKind_LessThan);
-                        end_token(&context);
+                        begin_token(context, TokenKind_LessThan);
+                        end_token(context);
                         break;
                     case '>':
-                        begin_token(&context, TokenKind_GreaterThan);
-                        end_token(&context);
+                        begin_token(context, TokenKind_GreaterThan);
+                        end_token(context);
                         break;
                     case '=':
-                        begin_token(&context, TokenKind_Equals);
-			context.state = LexerState_Equals;
+                        begin_token(context, TokenKind_Equals);
+			context->state = LexerState_Equals;
                         break;
                     case '+':
-                        begin_token(&context, TokenKind_Plus);
-                        end_token(&context);
+                        begin_token(context, TokenKind_Plus);
+                        end_token(context);
                         break;
                     case '-':
-                        begin_token(&context, TokenKind_Dash);
-                        context.state = LexerState_Dash;
+                        begin_token(context, TokenKind_Dash);
+                        context->state = LexerState_Dash;
                         break;
                     case '/':
-                        context.state = LexerState_Slash;
+                        context->state = LexerState_Slash;
                         break;
 		    case '%':
-			begin_token(&context, TokenKind_Percent);
-			end_token(&context);
+			begin_token(context, TokenKind_Percent);
+			end_token(context);
 			break;
                     default:
-                        begin_token(&context, TokenKind_Eof);
-                        end_token(&context);
-                        module_add_error(
-                            context.module,
-                            context.current_token,
-                            "Did you mean to add this?",
-                            "Unexpected character '%c'",
-                            current_char
-                        );
+                        begin_token(context, TokenKind_Eof);
+                        end_token(context);
+                        context->failed = true;
+                        context->failed_char = current_char;
                         return;
                 }
                 break;
@@ -245,10 +321,9 @@ void lexer_lex(Module* module) {
                     case '_':
                         break;
                     default:
-                        context.offset -= 1;
-                        context.position.column -= 1;
-                        end_token(&context);
-                        context.state = LexerState_Start;
+                        context->offset -= 1;
+                        end_token(context);
+                        context->state = LexerState_Start;
                         break;
                 }
                 break;
@@ -258,10 +333,9 @@ void lexer_lex(Module* module) {
                     case DIGIT:
                         break;
                     default:
-                        context.offset -= 1;
-                        context.position.column -= 1;
-                        end_token(&context);
-                        context.state = LexerState_Start;
+                        context->offset -= 1;
+                        end_token(context);
+                        context->state = LexerState_Start;
                         break;
                 }
                 break;
@@ -269,8 +343,8 @@ void lexer_lex(Module* module) {
             case LexerState_String:
                 switch (current_char) {
                     case '"':
-                        end_token(&context);
-                        context.state = LexerState_Start;
+                        end_token(context);
+                        context->state = LexerState_Start;
                         break;
                     default: break;
                 }
@@ -279,15 +353,14 @@ void lexer_lex(Module* module) {
             case LexerState_Dash:
                 switch (current_char) {
                     case '>':
-                        context.current_token->kind = TokenKind_Arrow;
-                        end_token(&context);
-                        context.state = LexerState_Start;
+                        set_token_kind(context, TokenKind_Arrow);
+                        end_token(context);
+                        context->state = LexerState_Start;
                         break;
                     default:
-                        context.offset -= 1;
-                        context.position.column -= 1;
-                        end_token(&context);
-                        context.state = LexerState_Start;
+                        context->offset -= 1;
+                        end_token(context);
+                        context->state = LexerState_Start;
                         break;
                 }
                 break;
@@ -295,14 +368,13 @@ void lexer_lex(Module* module) {
 	    case LexerState_Dot:
 		switch (current_char) {
 		    case '.':
-			context.current_token->kind = TokenKind_Range;
-			context.state = LexerState_DotDot;
+			set_token_kind(context, TokenKind_Range);
+			context->state = LexerState_DotDot;
 			break;
 		    default:
-			context.offset -= 1;
-			context.position.column -= 1;
-			end_token(&context);
-			context.state = LexerState_Start;
+			context->offset -= 1;
+			end_token(context);
+			context->state = LexerState_Start;
 			break;
 		}
 		break;
@@ -310,15 +382,14 @@ void lexer_lex(Module* module) {
 	    case LexerState_DotDot:
 		switch (current_char) {
 		    case '.':
-			context.current_token->kind = TokenKind_RangeInclusive;
-			end_token(&context);
-			context.state = LexerState_Start;
+			set_token_kind(context, TokenKind_RangeInclusive);
+			end_token(context);
+			context->state = LexerState_Start;
 			break;
 		    default:
-			context.offset -= 1;
-			context.position.column -= 1;
-			end_token(&context);
-			context.state = LexerState_Start;
+			context->offset -= 1;
+			end_token(context);
+			context->state = LexerState_Start;
 			break;
 		}
                 break;
@@ -326,81 +397,304 @@ void lexer_lex(Module* module) {
             case LexerState_Bang:
                 switch (current_char) {
                     case '=':
-                        context.current_token->kind = TokenKind_Inequality;
-                        end_token(&context);
+                        set_token_kind(context, TokenKind_Inequality);
+                        end_token(context);
                         break;
                     default:
-                        context.offset -= 1;
-                        context.position.column -= 1;
-                        end_token(&context);
+                        context->offset -= 1;
+                        end_token(context);
                         break;
                 }
-                context.state = LexerState_Start;
+                context->state = LexerState_Start;
                 break;
 
 	    case LexerState_Equals:
 		switch (current_char) {
 		    case '>':
-			context.current_token->kind = TokenKind_FatArrow;
-			end_token(&context);
-			context.state = LexerState_Start;
+			set_token_kind(context, TokenKind_FatArrow);
+			end_token(context);
+			context->state = LexerState_Start;
 			break;
 		    case '=':
-			context.current_token->kind = TokenKind_Equality;
-			end_token(&context);
-			context.state = LexerState_Start;
+			set_token_kind(context, TokenKind_Equality);
+			end_token(context);
+			context->state = LexerState_Start;
 			break;
 		    default:
-			context.offset -= 1;
-			context.position.column -= 1;
-			end_token(&context);
-			context.state = LexerState_Start;
+			context->offset -= 1;
+			end_token(context);
+			context->state = LexerState_Start;
 			break;
 		}
 		break;
 
             case LexerState_Slash:
                 if (current_char == '*') {
-                    context.state = LexerState_MultilineComment;
+                    context->state = LexerState_MultilineComment;
                 } else if (current_char == '/') {
-                    context.state = LexerState_Comment;
+                    context->state = LexerState_Comment;
                 } else {
-                    context.offset -= 1;
-                    context.position.column -= 1;
-                    begin_token(&context, TokenKind_Slash);
-                    end_token(&context);
-                    context.state = LexerState_Start;
+                    context->offset -= 1;
+                    begin_token(context, TokenKind_Slash);
+                    end_token(context);
+                    context->state = LexerState_Start;
                 }
 
                 break;
 
             case LexerState_Comment:
                 if (current_char == '\n') {
-                    context.state = LexerState_Start;
+                    context->state = LexerState_Start;
                 }
                 break;
 
             case LexerState_MultilineComment:
-                if ((current_char == '*') and (get_char(&context, context.offset + 1) == '/')) {
-                    context.offset += 1;
-                    context.position.column += 1;
-                    context.state = LexerState_Start;
+                if ((current_char == '*') and (get_char(context, context->offset + 1) == '/')) {
+                    context->offset += 1;
+                    context->state = LexerState_Start;
                 }
                 break;
 
             default:
                 sil_panic("Unknown tokenizer state");
         }
+    }
+}
+
+static void report_unexpected_char(Module* module, Token* token, char c) {
+    module_add_error(
+        module,
+        token,
+        "Did you mean to add this?",
+        "Unexpected character '%c'",
+        c
+    );
+}
+
+static void finish_lexing(Module* module, LexerContext* context, TokenList* tokens) {
+    if (context->failed) {
+        Token token = token_list_get(tokens, token_list_len(tokens) - 1);
+        report_unexpected_char(module, &token, context->failed_char);
+        return;
+    }
+
+    // end of file
+    usize index = token_list_push(tokens, TokenKind_Eof, module->source.len);
+    tokens->lengths[index] = 1;
+}
+
+static void lex_chunk(void* data, usize index) {
+    LexerChunk* chunks = data;
+    lex_range(&chunks[index].context);
+}
 
-        if (current_char == '\n') {
-            context.position.line += 1;
-            context.position.column = 1;
+// every chunk is lexed on the assumption that it starts outside of any token
+// or comment. chunks end just after a newline so that only holds if the
+// previous chunk finished in the start state; when it didn't (a string or
+// multiline comment spans the boundary) the previous chunk carries on
+// lexing over the next one and the speculative result is thrown away.
+static void lex_parallel(Module* module, usize thread_count, usize chunk_count) {
+    String source = module->source;
+    LexerChunk* chunks = malloc(sizeof(LexerChunk) * chunk_count);
+
+    usize chunk_start = 0;
+    usize actual_count = 0;
+    for (usize i = 0; i < chunk_count and chunk_start < source.len; i += 1) {
+        usize chunk_end = source.len;
+        if (i + 1 < chunk_count) {
+            usize target = source.len / chunk_count * (i + 1);
+            if (target < chunk_start) { target = chunk_start; }
+            const char* newline = memchr(source.ptr + target, '\n', source.len - target);
+            if (newline != null) { chunk_end = (usize)(newline - source.ptr) + 1; }
+        }
+
+        LexerChunk* chunk = &chunks[actual_count];
+        token_list_init(&chunk->tokens, source);
+        lexer_context_init(&chunk->context, module, &chunk->tokens, chunk_start, chunk_end);
+        chunk->context.names = null;
+
+        actual_count += 1;
+        chunk_start = chunk_end;
+    }
+
+    threadpool_run(thread_count, actual_count, lex_chunk, chunks);
+
+    // which chunks are kept is settled first, so the merge is one reserve
+    // and a copy of each kept chunk's arrays
+    TokenList** kept = malloc(sizeof(TokenList*) * actual_count);
+    usize kept_count = 0;
+    LexerContext* active = &chunks[0].context;
+    for (usize i = 1; i < actual_count and not active->failed; i += 1) {
+        LexerContext* next = &chunks[i].context;
+        if (active->state == LexerState_Start and active->offset == active->end) {
+            kept[kept_count++] = active->tokens;
+            active = next;
         } else {
-            context.position.column += 1;
+            active->end = next->end;
+            lex_range(active);
         }
     }
+    kept[kept_count++] = active->tokens;
 
-    // end of file
-    begin_token(&context, TokenKind_Eof);
-    end_token(&context);
+    usize token_count = 0;
+    for (usize i = 0; i < kept_count; i += 1) {
+        token_count += token_list_len(kept[i]);
+    }
+    token_list_reserve(&module->tokens, token_count);
+    for (usize i = 0; i < kept_count; i += 1) {
+        token_list_append(&module->tokens, kept[i]);
+    }
+    free(kept);
+
+    for (usize i = 0; i < actual_count; i += 1) {
+        token_list_deinit(&chunks[i].tokens);
+    }
+
+    // interning in token order keeps the ids the same as a sequential lex
+    TokenList* tokens = &module->tokens;
+    for (usize i = 0; i < token_list_len(tokens); i += 1) {
+        if (tokens->kinds[i] == TokenKind_Symbol) {
+            Token token = token_list_get(tokens, i);
+            tokens->symbols[i] = intern_string(&module->names, token.span);
+        }
+    }
+
+    finish_lexing(module, active, &module->tokens);
+    free(chunks);
+}
+
+void lexer_lex(Module* module, usize thread_count) {
+    LexerContext context;
+    lexer_context_init(&context, module, &module->tokens, 0, module->source.len);
+
+    // token offsets are stored in 32 bits
+    if (module->source.len > UINT32_MAX) {
+        begin_token(&context, TokenKind_Eof);
+        end_token(&context);
+        Token token = token_list_get(&module->tokens, context.current_token);
+        module_add_error(module, &token, null, "source files larger than 4 GiB are not supported");
+        return;
+    }
+
+    if (thread_count == 0) {
+        thread_count = threadpool_default_count();
+    }
+
+    usize chunk_count = module->source.len / LEXER_MIN_CHUNK_SIZE;
+    if (chunk_count > thread_count) { chunk_count = thread_count; }
+
+    if (chunk_count > 1) {
+        lex_parallel(module, thread_count, chunk_count);
+        return;
+    }
+
+    lex_range(&context);
+    finish_lexing(module, &context, &module->tokens);
+}
+
+// ------------ //
+// Token Stream //
+// ------------ //
+void token_stream_init(TokenStream* stream, Module* module) {
+    stream->module = module;
+    stream->tokens = &stream->window;
+    stream->base = 0;
+    stream->previous = (Token){ TokenKind_Eof, { null, 0 }, 0 };
+    stream->failed = false;
+    token_list_init(&stream->window, module->source);
+
+    LexerContext* lexer = malloc(sizeof(LexerContext));
+    lexer_context_init(lexer, module, &stream->window, 0, module->source.len);
+    lexer->token_limit = TOKEN_STREAM_WINDOW;
+    stream->lexer = lexer;
+
+    if (module->source.len > UINT32_MAX) {
+        begin_token(lexer, TokenKind_Eof);
+        end_token(lexer);
+        Token token = token_list_get(&stream->window, lexer->current_token);
+        module_add_error(module, &token, null, "source files larger than 4 GiB are not supported");
+        free(lexer);
+        stream->lexer = null;
+        return;
+    }
+}
+
+void token_stream_init_list(TokenStream* stream, Module* module, TokenList* tokens) {
+    stream->module = module;
+    stream->tokens = tokens;
+    stream->base = 0;
+    stream->previous = (Token){ TokenKind_Eof, { null, 0 }, 0 };
+    stream->failed = false;
+    stream->lexer = null;
+}
+
+void token_stream_deinit(TokenStream* stream) {
+    if (stream->tokens == &stream->window) {
+        token_list_deinit(&stream->window);
+    }
+    free(stream->lexer);
+}
+
+// moves the window forward. the lexer is paused between tokens, so every
+// token in the old window is complete and can be dropped.
+static void token_stream_refill(TokenStream* stream) {
+    LexerContext* lexer = stream->lexer;
+    TokenList* window = &stream->window;
+    usize len = token_list_len(window);
+
+    if (len > 0) {
+        stream->previous = token_list_get(window, len - 1);
+    }
+    stream->base += len;
+
+    token_list_deinit(window);
+    token_list_init(window, stream->module->source);
+
+    lex_range(lexer);
+    if (lexer->failed) {
+        // the window ends with an Eof token where the bad character is
+        stream->failed = true;
+        stream->failed_char = lexer->failed_char;
+        stream->failed_token = token_list_get(window, token_list_len(window) - 1);
+    } else if (lexer->offset >= lexer->end) {
+        finish_lexing(stream->module, lexer, window);
+    } else {
+        return;
+    }
+
+    free(lexer);
+    stream->lexer = null;
+}
+
+usize token_stream_fill(TokenStream* stream, usize index) {
+    while (index - stream->base >= token_list_len(stream->tokens) and stream->lexer != null) {
+        token_stream_refill(stream);
+    }
+
+    // reading past the end keeps giving the last token
+    usize len = token_list_len(stream->tokens);
+    if (index - stream->base >= len) {
+        return len - 1;
+    }
+
+    return index - stream->base;
+}
+
+void token_stream_report_errors(TokenStream* stream) {
+    if (not stream->failed) { return; }
+
+    // lexing up front would have stopped before parsing, so only the lexer
+    // error is kept. anything the parser said after running into the Eof
+    // token (or further ahead, the window runs ahead of the parser) goes.
+    module_clear_errors(stream->module);
+    report_unexpected_char(stream->module, &stream->failed_token, stream->failed_char);
+}
+
+Token token_stream_get(TokenStream* stream, usize index) {
+    if (index < stream->base) {
+        if (index + 1 == stream->base) { return stream->previous; }
+        sil_panic("token %zu has already been dropped from the stream", index);
+    }
+
+    return token_list_get(stream->tokens, token_stream_fill(stream, index));
 }
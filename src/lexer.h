@@ -3,6 +3,46 @@
 
 #include "module.h"
 
-void lexer_lex(Module* module);
+// thread_count = 0 uses one thread per core. large sources are split into
+// chunks that are lexed in parallel, the result is the same either way.
+void lexer_lex(Module* module, usize thread_count);
+
+// ------------ //
+// Token Stream //
+// ------------ //
+// the parser reads tokens through a stream. a stream either wraps a list that
+// was lexed up front or pulls tokens from the lexer into a small window as
+// they are needed, so memory stays the same whatever the file size. tokens
+// further back than the one before the current window are dropped.
+#define TOKEN_STREAM_WINDOW 1024
+
+typedef struct LexerContext LexerContext;
+
+typedef struct TokenStream {
+    Module* module;
+    TokenList* tokens;
+    // absolute index of tokens[0]
+    usize base;
+    // the last token of the previous window
+    Token previous;
+
+    // the lexer ran into an unexpected character
+    bool failed;
+    char failed_char;
+    Token failed_token;
+
+    TokenList window;
+    // null when there is nothing left to lex
+    LexerContext* lexer;
+} TokenStream;
+
+void token_stream_init(TokenStream* stream, Module* module);
+void token_stream_init_list(TokenStream* stream, Module* module, TokenList* tokens);
+void token_stream_deinit(TokenStream* stream);
+// lexes up to the token at index and returns its slot in stream->tokens
+usize token_stream_fill(TokenStream* stream, usize index);
+Token token_stream_get(TokenStream* stream, usize index);
+// reports a lexer error hit while streaming, once parsing is done
+void token_stream_report_errors(TokenStream* stream);
 
 #endif // !LEXER_H
@@ -14,21 +14,32 @@
 #include <stdlib.h>
 #include <iso646.h>
 
-#define VERSION_MAJOR 0
-#define VERSION_MINOR 0
-#define VERSION_PATCH 0
-
 
 static void print_usage(char* command) {
-    fprintf(stderr, "\nUsage: %s <code>.sil\n\nOther Options:\n--version\t\tprints version\n--output <outfile>\tsets output file\n--build\tbuild the C(IR)\n\n", command);
+    fprintf(stderr, "\nUsage: %s <code>.sil (or - for stdin)\n\nOther Options:\n--version\t\tprints version\n--output <outfile>\tsets output file\n--build\tbuild the C(IR)\n--lex-threads <n>\tlex large files on n threads (0 = one per core)\n--parse-threads <n>\tparse large files on n threads (0 = one per core)\n--analyze-threads <n>\tanalyze fn bodies on n threads (0 = one per core)\n--stream-tokens\tlex while parsing to keep token memory constant\n--lazy-bodies\tonly parse the bodies of fns that are called\n--ast-cache <dir>\treuse parsed asts of unchanged files from dir\n--stream-items\tcompile one fn at a time to keep memory bounded by the largest fn\n--keep-all\twrite out items nothing reachable uses, with every fn body parsed\n--dead-report\tlist the items that were left out\n--inline-report\tlist the inlining decision for each fn\n--alias-report\tlist the parameters written out with restrict\n--fold-report\tlist the fns written out as another fn with the same body\n--stack-report\tlist the worst case stack depth from each entry point\n\n", command);
 }
 
 int main(int argc, char** argv) {
     char* arg0 = argv[0];
     char* in_file_path = 0;
     char* out_file_path = "output";
-    bool build = false;
-    bool debug_info = false;
+    CompilerOptions options = {
+        .build = false,
+        .debug_info = false,
+        .lex_threads = 1,
+        .parse_threads = 1,
+        .analyze_threads = 1,
+        .stream_tokens = false,
+        .lazy_bodies = false,
+        .ast_cache = null,
+        .stream_items = false,
+        .keep_all = false,
+        .dead_report = false,
+        .inline_report = false,
+        .alias_report = false,
+        .fold_report = false,
+        .stack_report = false,
+    };
 
     for (int i = 1; i < argc; i++) {
         char* arg = argv[i];
@@ -41,9 +52,55 @@ int main(int argc, char** argv) {
                 i += 1;
                 out_file_path = argv[i];
 	    } else if (strcmp(arg, "--build") == 0) {
-		build = true;
+		options.build = true;
             } else if (strcmp(arg, "--debug") == 0) {
-                debug_info = true;
+                options.debug_info = true;
+            } else if (strcmp(arg, "--stream-tokens") == 0) {
+                options.stream_tokens = true;
+            } else if (strcmp(arg, "--lazy-bodies") == 0) {
+                options.lazy_bodies = true;
+            } else if (strcmp(arg, "--stream-items") == 0) {
+                options.stream_items = true;
+            } else if (strcmp(arg, "--keep-all") == 0) {
+                options.keep_all = true;
+            } else if (strcmp(arg, "--dead-report") == 0) {
+                options.dead_report = true;
+            } else if (strcmp(arg, "--inline-report") == 0) {
+                options.inline_report = true;
+            } else if (strcmp(arg, "--alias-report") == 0) {
+                options.alias_report = true;
+            } else if (strcmp(arg, "--fold-report") == 0) {
+                options.fold_report = true;
+            } else if (strcmp(arg, "--stack-report") == 0) {
+                options.stack_report = true;
+            } else if (strcmp(arg, "--lex-threads") == 0) {
+                i += 1;
+                if (i >= argc) {
+                    print_usage(arg0);
+                    return EXIT_FAILURE;
+                }
+                options.lex_threads = strtoul(argv[i], null, 10);
+            } else if (strcmp(arg, "--ast-cache") == 0) {
+                i += 1;
+                if (i >= argc) {
+                    print_usage(arg0);
+                    return EXIT_FAILURE;
+                }
+                options.ast_cache = argv[i];
+            } else if (strcmp(arg, "--parse-threads") == 0) {
+                i += 1;
+                if (i >= argc) {
+                    print_usage(arg0);
+                    return EXIT_FAILURE;
+                }
+                options.parse_threads = strtoul(argv[i], null, 10);
+            } else if (strcmp(arg, "--analyze-threads") == 0) {
+                i += 1;
+                if (i >= argc) {
+                    print_usage(arg0);
+                    return EXIT_FAILURE;
+                }
+                options.analyze_threads = strtoul(argv[i], null, 10);
             } else {
                 print_usage(arg0);
                 return EXIT_FAILURE;
@@ -61,9 +118,8 @@ int main(int argc, char** argv) {
         return EXIT_FAILURE;
     }
 
-    char* buffer;
-    int length;
-    bool read_file_success = read_file(in_file_path, &buffer, &length);
+    FileView file;
+    bool read_file_success = file_open(in_file_path, &file);
 
     if (not read_file_success) {
         fprintf(stderr, "failed to read file");
@@ -71,11 +127,14 @@ int main(int argc, char** argv) {
     }
 
     String path = str_from_lit(in_file_path);
-    String source = str_slice(buffer, length);
 
-    compiler_compile_module(path, source, build, debug_info);
+    Module* module = compiler_compile_module(path, file.contents, &options);
+    bool compiled = module != null;
+    if (compiled) {
+        compiler_free_module(module);
+    }
 
-    free(buffer);
+    file_close(&file);
 
-    return EXIT_SUCCESS;
+    return compiled ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -1,5 +1,7 @@
 #include "module.h"
 
+#include "consteval.h"
+
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
@@ -14,19 +16,72 @@ void module_init(Module* module, String path, String source) {
     module->source = source;
     module->has_errors = false;
 
+    arena_init(&module->arena);
+    intern_init(&module->names);
+    token_list_init(&module->tokens, source);
+    module->line_starts = null;
+    ast_init(&module->ast, source);
     symtable_init(&module->symbol_table);
     module->errors = dynarray_init();
     typetable_init(&module->type_table);
-    module->types = map_init();
-    module->items = map_init();
+    module->types = dynarray_init();
+    module->items = dynarray_init();
+    module->pending_fns = dynarray_init();
+    module->called_fns = dynarray_init();
+    module->taken_fns = dynarray_init();
+    module->const_calls = dynarray_init();
+
+    module->const_values = dynarray_init();
+    ConstValue none = { .kind = ConstValueKind_Void };
+    dynarray_push(module->const_values, &none);
 }
 
 void module_deinit(Module* module) {
-    symtable_deinit(&module->symbol_table);
+    token_list_deinit(&module->tokens);
+    if (module->line_starts != null) {
+        dynarray_deinit(module->line_starts);
+    }
+    ast_deinit(&module->ast);
     dynarray_deinit(module->errors);
+    symtable_deinit(&module->symbol_table);
     typetable_deinit(&module->type_table);
-    map_deinit(module->types);
-    map_deinit(module->items);
+    dynarray_deinit(module->types);
+    dynarray_deinit(module->items);
+    dynarray_deinit(module->pending_fns);
+    dynarray_deinit(module->called_fns);
+    dynarray_deinit(module->taken_fns);
+    dynarray_deinit(module->const_calls);
+    dynarray_deinit(module->const_values);
+    intern_deinit(&module->names);
+    arena_deinit(&module->arena);
+}
+
+void module_set_item(Module* module, symbol_id name, item_id item) {
+    while (dynarray_len(module->items) <= name) {
+        item_id none = 0;
+        dynarray_push(module->items, &none);
+    }
+
+    module->items[name] = item;
+}
+
+item_id module_get_item(Module* module, symbol_id name) {
+    if (name >= dynarray_len(module->items)) { return 0; }
+    return module->items[name];
+}
+
+void module_set_type(Module* module, symbol_id name, type_id type) {
+    while (dynarray_len(module->types) <= name) {
+        type_id none = 0;
+        dynarray_push(module->types, &none);
+    }
+
+    module->types[name] = type;
+}
+
+type_id module_get_type(Module* module, symbol_id name) {
+    if (name >= dynarray_len(module->types)) { return 0; }
+    return module->types[name];
 }
 
 void module_add_error(Module* module, Token* token, const char* hint, const char* message, ...) {
@@ -34,7 +89,7 @@ void module_add_error(Module* module, Token* token, const char* hint, const char
 
     // format message
     usize max_length = strlen(message) + 200;
-    char* formatted_message = malloc(max_length);
+    char* formatted_message = arena_alloc(&module->arena, max_length);
 
     va_list args;
     va_start(args, message);
@@ -49,34 +104,89 @@ void module_add_error(Module* module, Token* token, const char* hint, const char
     }
 
     // add error
-    ModuleError error = { token, ModuleErrorType_Error, formatted_message, hint, has_hint };
+    ModuleError error = { *token, ModuleErrorType_Error, formatted_message, hint, has_hint };
     dynarray_push(module->errors, &error);
 }
 
+// messages stay in the arena
+void module_clear_errors(Module* module) {
+    dynarray_deinit(module->errors);
+    module->errors = dynarray_init();
+    module->has_errors = false;
+}
+
+// the messages are copied, they live in the other module's arena
+void module_take_errors(Module* module, Module* other) {
+    for (usize i = 0; i < dynarray_len(other->errors); i += 1) {
+        ModuleError error = other->errors[i];
+        error.message = arena_format(&module->arena, "%s", error.message).ptr;
+        dynarray_push(module->errors, &error);
+        module->has_errors = true;
+    }
+}
+
+static void build_line_starts(Module* module) {
+    module->line_starts = dynarray_init();
+
+    usize start = 0;
+    dynarray_push(module->line_starts, &start);
+
+    const char* source = module->source.ptr;
+    usize length = module->source.len;
+    const char* newline = memchr(source, '\n', length);
+    while (newline != null) {
+        start = (usize)(newline - source) + 1;
+        dynarray_push(module->line_starts, &start);
+        newline = memchr(newline + 1, '\n', length - start);
+    }
+}
+
+TextPosition module_position(Module* module, usize offset) {
+    if (module->line_starts == null) {
+        build_line_starts(module);
+    }
+
+    // last line that starts at or before the offset
+    usize low = 0;
+    usize high = dynarray_len(module->line_starts);
+    while (high - low > 1) {
+        usize middle = low + (high - low) / 2;
+        if (module->line_starts[middle] <= offset) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    return (TextPosition){ low + 1, offset - module->line_starts[low] + 1 };
+}
+
 void module_display_errors(Module* module) {
     for (usize i = 0; i < dynarray_len(module->errors); i += 1) {
         ModuleError* error = &module->errors[i];
         fprintf(stderr, ERROR_RED "error:" RESET " %s\n", error->message);
 
         // TODO: absolutely hideous
-        TextPosition position = error->token->position;
+        usize offset = (usize)(error->token.span.ptr - module->source.ptr);
+        TextPosition position = module_position(module, offset);
         int line_num_width = 0;
-        for (int i = error->token->position.line; i > 0; i /= 10) { line_num_width += 1; }
+        for (usize i = position.line; i > 0; i /= 10) { line_num_width += 1; }
         // print border
-        fprintf(stderr, FADED "    ╭─[" RESET "%.*s:%d:%d" FADED "]───\n", str_format(module->path), position.line, position.column);
-        fprintf(stderr, "%.*s%.*d │ " RESET, 3 - line_num_width, "  ", line_num_width, error->token->position.line);
-        // print source
-        char* start = (char*)error->token->span.ptr - (position.column - 1);
-        while (*start != '\n' && *start != 0) {
-            if (start == error->token->span.ptr) { fprintf(stderr, ERROR_RED); }
+        fprintf(stderr, FADED "    ╭─[" RESET "%.*s:%zu:%zu" FADED "]───\n", str_format(module->path), position.line, position.column);
+        fprintf(stderr, "%.*s%.*zu │ " RESET, 3 - line_num_width, "  ", line_num_width, position.line);
+        // print source (the source isn't null terminated)
+        char* start = (char*)error->token.span.ptr - (position.column - 1);
+        char* source_end = (char*)module->source.ptr + module->source.len;
+        while (start < source_end && *start != '\n' && *start != 0) {
+            if (start == error->token.span.ptr) { fprintf(stderr, ERROR_RED); }
             putc(*start, stderr);
-            if (start == error->token->span.ptr+ error->token->span.len - 1) { fprintf(stderr, RESET); }
+            if (start == error->token.span.ptr+ error->token.span.len - 1) { fprintf(stderr, RESET); }
             start += 1;
         }
         fprintf(stderr, FADED "\n    │ ");
         for (usize i = 0; i < position.column - 1; i++) { putc(' ', stderr); }
         fprintf(stderr, ERROR_RED);
-        for (usize i = 0; i < error->token->span.len; i += 1) { fprintf(stderr, "^"); }
+        for (usize i = 0; i < error->token.span.len; i += 1) { fprintf(stderr, "^"); }
         fprintf(stderr, " %s" FADED "\n    ╰", error->hint);
         fprintf(stderr, "─────\n" RESET);
     }
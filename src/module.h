@@ -5,8 +5,9 @@
 #include "token.h"
 #include "symtable.h"
 #include "typetable.h"
+#include "intern.h"
+#include "arena.h"
 #include <chnlib/dynarray.h>
-#include <chnlib/map.h>
 
 
 typedef enum ModuleErrorType {
@@ -15,7 +16,7 @@ typedef enum ModuleErrorType {
 } ModuleErrorType;
 
 typedef struct ModuleError {
-    Token* token;
+    Token token;
     ModuleErrorType type;
     const char* message;
     const char* hint;
@@ -25,13 +26,33 @@ typedef struct ModuleError {
 typedef struct Module {
     String path;
     String source;
-    DynArray(Token) token_list;
-    AstRoot* ast;
-
-    Map(Item*) items;
-    Map(type_id) types;
+    // owns the diagnostics and codegen temporaries
+    Arena arena;
+    TokenList tokens;
+    // offset of the first byte of each line, built on the first lookup
+    DynArray(usize) line_starts;
+    Ast ast;
+
+    InternTable names;
+
+    // indexed by symbol_id, 0 when the name isn't an item/type
+    DynArray(item_id) items;
+    DynArray(type_id) types;
+    // fns lined up for the analyzer, in the order they were found
+    DynArray(item_id) pending_fns;
+    // fns called by analyzed code, lined up by the analyzer once the fns
+    // being analyzed are done. may hold duplicates and fns already lined up.
+    DynArray(item_id) called_fns;
+    // fns analyzed code uses as values, marked address_taken along with
+    // called_fns
+    DynArray(item_id) taken_fns;
+    // calls through constants, made direct calls to the fn the constant
+    // holds once the constants are evaluated
+    DynArray(expr_id) const_calls;
     SymTable symbol_table;
     TypeTable type_table;
+    // values of constants, indexed by const_id. 0 is reserved.
+    DynArray(ConstValue) const_values;
 
     struct {
         type_id entry_void;
@@ -67,6 +88,17 @@ void module_deinit(Module* module);
 __attribute__((format(printf, 4, 5)))
 void module_add_error(Module* module, Token* token, const char* hint, const char* message, ...);
 
+void module_clear_errors(Module* module);
+// moves the errors of a module used by another thread over, in order
+void module_take_errors(Module* module, Module* other);
+
+void module_set_item(Module* module, symbol_id name, item_id item);
+item_id module_get_item(Module* module, symbol_id name);
+void module_set_type(Module* module, symbol_id name, type_id type);
+type_id module_get_type(Module* module, symbol_id name);
+
+TextPosition module_position(Module* module, usize offset);
+
 void module_display_errors(Module* module);
 
 #endif //!MODULE_H
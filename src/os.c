@@ -1,39 +1,132 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "os.h"
 
-#include <stdio.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 
-bool read_file(const char* path, char** buffer, int* length) {
-    FILE* file = fopen(path, "rb");
-    if (file == NULL) {
+static bool read_all(int fd, FileView* file) {
+    usize capacity = 64 * 1024;
+    usize length = 0;
+    char* buffer = malloc(capacity);
+    if (buffer == null) {
         return false;
     }
 
-    if (fseek(file, 0, SEEK_END) != 0) {
+    while (true) {
+        if (length == capacity) {
+            capacity *= 2;
+            char* grown = realloc(buffer, capacity);
+            if (grown == null) {
+                free(buffer);
+                return false;
+            }
+            buffer = grown;
+        }
+
+        ssize_t count = read(fd, buffer + length, capacity - length);
+        if (count < 0) {
+            free(buffer);
+            return false;
+        }
+        if (count == 0) {
+            break;
+        }
+
+        length += (usize)count;
+    }
+
+    file->contents = str_slice(buffer, length);
+    file->is_mapped = false;
+
+    return true;
+}
+
+bool file_open(const char* path, FileView* file) {
+    bool is_stdin = path[0] == '-' and path[1] == 0;
+    int fd = is_stdin ? STDIN_FILENO : open(path, O_RDONLY);
+    if (fd < 0) {
         return false;
     }
 
-    long buffer_length = ftell(file);
-    if (buffer_length == -1) {
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        if (not is_stdin) { close(fd); }
         return false;
     }
 
-    *buffer = malloc(sizeof(char) * buffer_length + 1);
+    bool success;
+    if (S_ISREG(info.st_mode) and info.st_size > 0) {
+        usize length = (usize)info.st_size;
+        void* mapping = mmap(null, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            posix_madvise(mapping, length, POSIX_MADV_SEQUENTIAL);
+            file->contents = str_slice(mapping, length);
+            file->is_mapped = true;
+            success = true;
+        } else {
+            success = read_all(fd, file);
+        }
+    } else {
+        success = read_all(fd, file);
+    }
+
+    if (not is_stdin) { close(fd); }
 
-    if (fseek(file, 0, SEEK_SET) != 0) {
-        free(*buffer);
+    return success;
+}
+
+void file_close(FileView* file) {
+    if (file->is_mapped) {
+        munmap((void*)file->contents.ptr, file->contents.len);
+    } else {
+        free((void*)file->contents.ptr);
+    }
+
+    file->contents = str_slice(null, 0);
+}
+
+bool file_write(const char* path, const void* data, usize length) {
+    char tmp_path[4096];
+    int path_length = snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.tmp", path, (long)getpid());
+    if (path_length < 0 or (usize)path_length >= sizeof(tmp_path)) {
         return false;
     }
 
-    size_t file_read = fread(*buffer, sizeof(char), buffer_length, file);
-    if (ferror(file) != 0) {
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
         return false;
     }
 
-    *length = file_read;
-    (*buffer)[file_read] = 0;
+    const char* bytes = data;
+    while (length > 0) {
+        ssize_t count = write(fd, bytes, length);
+        if (count < 0) {
+            close(fd);
+            unlink(tmp_path);
+            return false;
+        }
 
-    fclose(file);
+        bytes += count;
+        length -= (usize)count;
+    }
+
+    close(fd);
+
+    if (rename(tmp_path, path) != 0) {
+        unlink(tmp_path);
+        return false;
+    }
 
     return true;
 }
+
+bool dir_create(const char* path) {
+    return mkdir(path, 0755) == 0 or errno == EEXIST;
+}
@@ -2,8 +2,24 @@
 #define IO_H
 
 #include <chnlib/chntype.h>
+#include <chnlib/str.h>
 
 
-bool read_file(const char* path, char** buffer, int* length);
+// a read-only view of a file's contents. regular files are mapped straight
+// into memory, anything else (pipes, stdin as "-") is read into a buffer.
+// contents are not guaranteed to be null terminated.
+typedef struct FileView {
+    String contents;
+    bool is_mapped;
+} FileView;
+
+bool file_open(const char* path, FileView* file);
+void file_close(FileView* file);
+
+// writes to a temporary file next to path and renames it over path, so
+// readers see either the old or the new contents
+bool file_write(const char* path, const void* data, usize length);
+// succeeds when the directory already exists
+bool dir_create(const char* path);
 
 #endif //!IO_H
@@ -2,64 +2,91 @@
 
 #include "util.h"
 #include "token.h"
+#include "lexer.h"
+#include "threadpool.h"
 #include <chnlib/maybe.h>
 #include <chnlib/logger.h>
-#include <chnlib/dynarray.h>
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+// files with fewer tokens than this per thread are parsed on one thread
+#define PARSER_MIN_CHUNK_TOKENS (64 * 1024)
 
 typedef struct ParserContext {
     Module* module;
-    unsigned int token_index;
+    Ast* ast;
+    TokenStream* tokens;
+    usize token_index;
+    bool lazy_bodies;
+
+    // child lists are collected here and copied into the ast once complete,
+    // so lists that are being built at the same time don't interleave
+    u32* scratch;
+    usize scratch_len;
+    usize scratch_capacity;
 } ParserContext;
 
-static Token* current_token(ParserContext* context) {
-    return &context->module->token_list[context->token_index];
+static usize current_slot(ParserContext* context) {
+    TokenStream* tokens = context->tokens;
+    usize slot = context->token_index - tokens->base;
+    if (slot < token_list_len(tokens->tokens)) { return slot; }
+
+    return token_stream_fill(tokens, context->token_index);
+}
+
+// the slot is looked up first, filling it can replace the window's arrays
+static TokenKind current_kind(ParserContext* context) {
+    usize slot = current_slot(context);
+    return context->tokens->tokens->kinds[slot];
+}
+
+static Token current_token(ParserContext* context) {
+    usize slot = current_slot(context);
+    return token_list_get(context->tokens->tokens, slot);
 }
 
-static Token* consume_token(ParserContext* context) {
-    Token* token = current_token(context);
+static Token consume_token(ParserContext* context) {
+    Token token = current_token(context);
     context->token_index += 1;
 
     return token;
 }
 
-static Maybe(Token*) expect_token(ParserContext* context, TokenKind kind) {
-    Token* token = consume_token(context);
-    if (token->kind != kind) {
+static Maybe(u8) expect_token(ParserContext* context, TokenKind kind) {
+    Token token = consume_token(context);
+    if (token.kind != kind) {
         module_add_error(
             context->module,
-            token,
+            &token,
             "unexpected token",
             "expected %s, found %s",
             token_string(kind),
-            token_string(token->kind)
+            token_string(token.kind)
         );
 
         return None;
     }
 
-    return Some(token);
+    return Some((u8)0);
 }
 
 static Maybe(u8) expect_semicolon(ParserContext* context) {
-    Token* token = current_token(context);
-    if (token->kind != TokenKind_Semicolon) {
-        // add the semicolon token for error
-        Token* prev_token = &context->module->token_list[context->token_index - 1];
-
-        Token* semicolon = malloc(sizeof(Token));
-        semicolon->kind = TokenKind_Semicolon;
-        semicolon->position = prev_token->position;
-        semicolon->span = prev_token->span;
-        semicolon->position.column += prev_token->span.len;
-        semicolon->span.ptr += prev_token->span.len;
-        semicolon->span.len = 1;
+    if (current_kind(context) != TokenKind_Semicolon) {
+        // point the error just past the previous token
+        Token prev_token = token_stream_get(context->tokens, context->token_index - 1);
+
+        Token semicolon;
+        semicolon.kind = TokenKind_Semicolon;
+        semicolon.span = prev_token.span;
+        semicolon.span.ptr += prev_token.span.len;
+        semicolon.span.len = 1;
 
         module_add_error(
             context->module,
-            semicolon,
+            &semicolon,
             "you fool",
             "missing semicolon"
         );
@@ -72,45 +99,102 @@ static Maybe(u8) expect_semicolon(ParserContext* context) {
     return Some((u8)0);
 }
 
-static Maybe(Ast_Type*) parse_type(ParserContext* context) {
-    Ast_Type* type = malloc(sizeof(Ast_Type));
+static AstSpan span_of(ParserContext* context, Token* token) {
+    return (AstSpan){ (u32)(token->span.ptr - context->ast->source.ptr), (u32)token->span.len };
+}
+
+static usize scratch_begin(ParserContext* context) {
+    return context->scratch_len;
+}
+
+static void scratch_push(ParserContext* context, const void* item, usize size) {
+    usize words = size / sizeof(u32);
+    if (context->scratch_len + words > context->scratch_capacity) {
+        context->scratch_capacity = context->scratch_capacity == 0 ? 256 : context->scratch_capacity * 2;
+        context->scratch = realloc(context->scratch, context->scratch_capacity * sizeof(u32));
+    }
+
+    memcpy(&context->scratch[context->scratch_len], item, size);
+    context->scratch_len += words;
+}
+
+static AstRange scratch_end(ParserContext* context, usize mark, usize size) {
+    usize count = (context->scratch_len - mark) / (size / sizeof(u32));
+    AstRange range = ast_add_extra(context->ast, &context->scratch[mark], count, size);
+    context->scratch_len = mark;
+
+    return range;
+}
+
+static Maybe(ast_type_id) parse_type(ParserContext* context) {
+    Ast_Type type;
     
-    Token* token = consume_token(context);
-    type->symbol = token->span;
-    switch (token->kind) {
+    Token token = consume_token(context);
+    type.symbol = token.symbol;
+    switch (token.kind) {
 	case TokenKind_Star: {
-	    type->kind = TypeKind_Ptr;
-            if (current_token(context)->kind == TokenKind_KeywordMut) {
+	    type.kind = TypeKind_Ptr;
+            if (current_kind(context) == TokenKind_KeywordMut) {
                 consume_token(context);
-                type->ptr.is_mut = true;
+                type.ptr.is_mut = true;
             } else {
-                type->ptr.is_mut = false;
+                type.ptr.is_mut = false;
             }
-	    type->ptr.to = try(parse_type(context));
+	    type.ptr.to = try(parse_type(context));
 
 	    break;
 	}
 
 	case TokenKind_KeywordUnreachable: {
-	    type->kind = TypeKind_Never;
+	    type.kind = TypeKind_Never;
 	    break;
 	}
 
 	case TokenKind_Symbol: {
-	    type->kind = TypeKind_Symbol;
+	    type.kind = TypeKind_Symbol;
+	    break;
+	}
+
+	case TokenKind_KeywordFn: {
+	    type.kind = TypeKind_Fn;
+	    try(expect_token(context, TokenKind_LParen));
+
+	    usize parameters = scratch_begin(context);
+	    while (current_kind(context) != TokenKind_RParen) {
+		ast_type_id parameter = try(parse_type(context));
+		scratch_push(context, &parameter, sizeof(ast_type_id));
+
+		if (current_kind(context) != TokenKind_Comma) {
+		    break;
+		}
+
+		consume_token(context);
+	    }
+
+	    try(expect_token(context, TokenKind_RParen));
+	    type.fn.parameters = scratch_end(context, parameters, sizeof(ast_type_id));
+
+	    if (current_kind(context) == TokenKind_Arrow) {
+		consume_token(context);
+		type.fn.return_type = try(parse_type(context));
+	    } else {
+		Ast_Type void_type;
+		void_type.kind = TypeKind_Void;
+		type.fn.return_type = ast_add_type(context->ast, &void_type);
+	    }
 	    break;
 	}
 
 	default: {
-	    sil_panic("Unexpected type: %s", token_string(token->kind));
+	    sil_panic("Unexpected type: %s", token_string(token.kind));
 	}
     }
 
-    return Some(type);
+    return Some(ast_add_type(context->ast, &type));
 }
 
-static Maybe(Stmt*) parse_statement(ParserContext* context);
-static Maybe(Expr*) parse_expression(ParserContext* context);
+static Maybe(stmt_id) parse_statement(ParserContext* context);
+static Maybe(expr_id) parse_expression(ParserContext* context);
 
 static void operator_precedence(TokenKind operator_kind, int* left, int* right) {
     int precedence;
@@ -133,20 +217,20 @@ static void operator_precedence(TokenKind operator_kind, int* left, int* right)
     *right = precedence * 2;
 }
 
-static Maybe(Block*) parse_block(ParserContext* context) {
-    Block* block = malloc(sizeof(Block));
-    block->statements = dynarray_init();
+static Maybe(Block) parse_block(ParserContext* context) {
+    Block block;
+    usize statements = scratch_begin(context);
 
     try(expect_token(context, TokenKind_LBrace));
     
-    while (current_token(context)->kind != TokenKind_RBrace) {
-	Stmt* statement = try(parse_statement(context));
-	dynarray_push(block->statements, &statement);
+    while (current_kind(context) != TokenKind_RBrace) {
+	stmt_id statement = try(parse_statement(context));
+	scratch_push(context, &statement, sizeof(stmt_id));
 
         // an expression without a semi indicates the end of a block
-        if (statement->kind == StmtKind_NakedExpr) {
+        if (ast_stmt(context->ast, statement)->kind == StmtKind_NakedExpr) {
             // if we're not at a '}', then we exited early and there should be a semi
-            if (current_token(context)->kind != TokenKind_RBrace) {
+            if (current_kind(context) != TokenKind_RBrace) {
                 try(expect_semicolon(context));
             }
             break;
@@ -156,50 +240,52 @@ static Maybe(Block*) parse_block(ParserContext* context) {
 
     consume_token(context);
 
+    block.statements = scratch_end(context, statements, sizeof(stmt_id));
+
     return Some(block);
 }
 
-static Maybe(NumberLit*) parse_number_literal(ParserContext* context) {
-    NumberLit* lit = malloc(sizeof(NumberLit));
+static Maybe(NumberLit) parse_number_literal(ParserContext* context) {
+    NumberLit lit;
 
-    Token* token = consume_token(context);
-    lit->span = token->span;
+    Token token = consume_token(context);
+    lit.span = span_of(context, &token);
 
     return Some(lit);
 }
 
 // TODO: maybe make this part of block
-static Maybe(Asm*) parse_asmblock(ParserContext* context) {
-    Asm* asm = malloc(sizeof(Asm));
-    asm->inputs = dynarray_init();
-    asm->outputs = dynarray_init();
-    asm->clobbers = dynarray_init();
-    asm->source = dynarray_init();
+static Maybe(asm_id) parse_asmblock(ParserContext* context) {
+    Asm asm;
+    // inputs and clobbers come mixed together, clobbers are kept as inputs
+    // without a value until they're split apart below
+    usize registers = scratch_begin(context);
 
     // consume 'asm'
     consume_token(context);
 
     try(expect_token(context, TokenKind_KeywordVolatile));
 
-    if (current_token(context)->kind == TokenKind_LParen) {
+    if (current_kind(context) == TokenKind_LParen) {
         consume_token(context);
 
         while (true) {
-            Token* reg_tok = try(expect_token(context, TokenKind_Symbol));
+            Token reg_tok = current_token(context);
+            try(expect_token(context, TokenKind_Symbol));
 
-            if (current_token(context)->kind == TokenKind_Equals) {
-                consume_token(context);
+            AsmInput param;
+            param.reg = span_of(context, &reg_tok);
+            param.val = 0;
 
-                AsmInput* param = dynarray_add(asm->inputs);
-                param->reg = reg_tok->span;
+            if (current_kind(context) == TokenKind_Equals) {
+                consume_token(context);
 
-                param->val = try(parse_expression(context));
-            } else {
-                String* clobber = dynarray_add(asm->clobbers);
-                *clobber = reg_tok->span;
+                param.val = try(parse_expression(context));
             }
 
-            if (current_token(context)->kind != TokenKind_Comma) {
+            scratch_push(context, &param, sizeof(AsmInput));
+
+            if (current_kind(context) != TokenKind_Comma) {
                 break;
             }
 
@@ -211,77 +297,106 @@ static Maybe(Asm*) parse_asmblock(ParserContext* context) {
         consume_token(context);
     }
 
-    if (current_token(context)->kind == TokenKind_Arrow) {
+    usize registers_end = context->scratch_len;
+    usize register_words = sizeof(AsmInput) / sizeof(u32);
+
+    usize inputs = scratch_begin(context);
+    for (usize i = registers; i < registers_end; i += register_words) {
+        AsmInput param;
+        memcpy(&param, &context->scratch[i], sizeof(AsmInput));
+        if (param.val != 0) { scratch_push(context, &param, sizeof(AsmInput)); }
+    }
+    asm.inputs = scratch_end(context, inputs, sizeof(AsmInput));
+
+    usize clobbers = scratch_begin(context);
+    for (usize i = registers; i < registers_end; i += register_words) {
+        AsmInput param;
+        memcpy(&param, &context->scratch[i], sizeof(AsmInput));
+        if (param.val == 0) { scratch_push(context, &param.reg, sizeof(AstSpan)); }
+    }
+    asm.clobbers = scratch_end(context, clobbers, sizeof(AstSpan));
+
+    context->scratch_len = registers;
+
+    usize outputs = scratch_begin(context);
+    if (current_kind(context) == TokenKind_Arrow) {
         consume_token(context);
 
-        Token* reg_tok = try(expect_token(context, TokenKind_Symbol));
-        String* output = dynarray_add(asm->outputs);
+        Token reg_tok = current_token(context);
+        try(expect_token(context, TokenKind_Symbol));
+        AstSpan output = span_of(context, &reg_tok);
 
-        *output = reg_tok->span;
+        scratch_push(context, &output, sizeof(AstSpan));
     }
+    asm.outputs = scratch_end(context, outputs, sizeof(AstSpan));
 
     try(expect_token(context, TokenKind_LBrace));
 
-    while (current_token(context)->kind != TokenKind_RBrace) {
-        Token* line_tok = try(expect_token(context, TokenKind_StringLiteral));
-        StringLit* line = dynarray_add(asm->source);
-        line->span = line_tok->span;
+    usize source = scratch_begin(context);
+    while (current_kind(context) != TokenKind_RBrace) {
+        Token line_tok = current_token(context);
+        try(expect_token(context, TokenKind_StringLiteral));
+        AstSpan line = span_of(context, &line_tok);
+        scratch_push(context, &line, sizeof(AstSpan));
     }
+    asm.source = scratch_end(context, source, sizeof(AstSpan));
 
     consume_token(context);
 
-    return Some(asm);
+    return Some(ast_add_asm(context->ast, &asm));
 }
 
-static Maybe(Expr*) parse_primary_expression(ParserContext* context) {
-    Expr* expression = malloc(sizeof(Expr)); 
+static Maybe(expr_id) parse_primary_expression(ParserContext* context) {
+    Expr expression;
+    expression.codegen.type = 0;
 
-    switch (current_token(context)->kind) {
+    switch (current_kind(context)) {
         case TokenKind_KeywordAsm: {
-            expression->kind = ExprKind_Asm;
-            expression->asm = try(parse_asmblock(context));
+            expression.kind = ExprKind_Asm;
+            expression.asm = try(parse_asmblock(context));
 
             break;
         }
 
         case TokenKind_LParen: {
             consume_token(context);
-            expression = try(parse_expression(context));
+            expr_id inner = try(parse_expression(context));
 
             try(expect_token(context, TokenKind_RParen));
 
-            break;
+            return Some(inner);
        }
 
 	case TokenKind_KeywordReturn: {
-	    expression->kind = ExprKind_Ret;
+	    expression.kind = ExprKind_Ret;
 	    consume_token(context);
 
-	    expression->ret = try(parse_expression(context));
+	    expression.ret = try(parse_expression(context));
 
 	    break;
 	}
 
 	case TokenKind_NumberLiteral: {
-	    expression->kind = ExprKind_NumberLit;
-	    expression->number_literal = try(parse_number_literal(context));
+	    expression.kind = ExprKind_NumberLit;
+	    expression.number_literal = try(parse_number_literal(context));
 
 	    break;
 	}
 
 	case TokenKind_StringLiteral: {
-	    expression->kind = ExprKind_StringLit;
-	    expression->string_literal.span = consume_token(context)->span;
+	    expression.kind = ExprKind_StringLit;
+	    Token token = consume_token(context);
+	    expression.string_literal.span = span_of(context, &token);
 
 	    break;
 	}
 
         case TokenKind_KeywordTrue:
         case TokenKind_KeywordFalse: {
-            Token* boolean = consume_token(context);
+            Token boolean = consume_token(context);
 
-            expression->kind = ExprKind_BoolLit;
-            expression->boolean = boolean->kind == TokenKind_KeywordTrue;
+            expression.kind = ExprKind_BoolLit;
+            expression.boolean = boolean.kind == TokenKind_KeywordTrue;
 
             break;
         }
@@ -289,50 +404,48 @@ static Maybe(Expr*) parse_primary_expression(ParserContext* context) {
 	case TokenKind_KeywordLet: {
 	    consume_token(context);
 
-	    expression->kind = ExprKind_Let;
+	    expression.kind = ExprKind_Let;
 
-	    Token* name_token = try(expect_token(context, TokenKind_Symbol));
-	    expression->let = malloc(sizeof(Let));
-	    expression->let->name = name_token->span;
+	    Token name_token = current_token(context);
+	    try(expect_token(context, TokenKind_Symbol));
+	    expression.let.name = name_token.symbol;
 
-            Token* maybe_colon = current_token(context);
-            if (maybe_colon->kind == TokenKind_Colon) {
+            Token maybe_colon = current_token(context);
+            if (maybe_colon.kind == TokenKind_Colon) {
                 consume_token(context);
 
-                expression->let->type = try(parse_type(context));
+                expression.let.type = try(parse_type(context));
             } else {
-                expression->let->type = null;
+                expression.let.type = 0;
             }
 
 	    try(expect_token(context, TokenKind_Equals));
 
-	    expression->let->value = try(parse_expression(context));
+	    expression.let.value = try(parse_expression(context));
 
 	    break;
 	}
 
 	case TokenKind_Symbol: {
-	    Token* symbol_token = consume_token(context);
-	    if (current_token(context)->kind != TokenKind_LParen) {
-		expression->kind = ExprKind_Symbol;
-		expression->symbol = symbol_token->span;
+	    Token symbol_token = consume_token(context);
+	    if (current_kind(context) != TokenKind_LParen) {
+		expression.kind = ExprKind_Symbol;
+		expression.symbol = symbol_token.symbol;
 
 		break;
 	    }
 
-	    expression->kind = ExprKind_FnCall;
-
-	    expression->fn_call = malloc(sizeof(FnCall));
-	    expression->fn_call->name = symbol_token->span;
+	    expression.kind = ExprKind_FnCall;
+	    expression.fn_call.name = symbol_token.symbol;
 
 	    try(expect_token(context, TokenKind_LParen));
 
-	    expression->fn_call->arguments = dynarray_init();
-	    while (current_token(context)->kind != TokenKind_RParen) {
-		Expr* arg = try(parse_expression(context));
-		dynarray_push(expression->fn_call->arguments, &arg);
+	    usize arguments = scratch_begin(context);
+	    while (current_kind(context) != TokenKind_RParen) {
+		expr_id arg = try(parse_expression(context));
+		scratch_push(context, &arg, sizeof(expr_id));
 
-		if (current_token(context)->kind != TokenKind_Comma) {
+		if (current_kind(context) != TokenKind_Comma) {
 		    break;
 		}
 
@@ -341,84 +454,100 @@ static Maybe(Expr*) parse_primary_expression(ParserContext* context) {
 
 	    try(expect_token(context, TokenKind_RParen));
 
+	    expression.fn_call.arguments = scratch_end(context, arguments, sizeof(expr_id));
+
 	    break;
 	}
 
 	case TokenKind_LBrace: {
-	    expression->kind = ExprKind_Block;
-	    expression->block = try(parse_block(context));
+	    expression.kind = ExprKind_Block;
+	    expression.block = try(parse_block(context));
 
 	    break;
 	}
 
         case TokenKind_KeywordBreak: {
             consume_token(context);
-            expression->kind = ExprKind_Break;
+            expression.kind = ExprKind_Break;
             break;
         }
 
         case TokenKind_KeywordContinue: {
             consume_token(context);
-            expression->kind = ExprKind_Continue;
+            expression.kind = ExprKind_Continue;
             break;
         }
 
         case TokenKind_KeywordUnreachable: {
             consume_token(context);
-            expression->kind = ExprKind_Unreachable;
+            expression.kind = ExprKind_Unreachable;
             break;
         }
 
 	case TokenKind_KeywordIf: {
-	    consume_token(context);
-	    expression->kind = ExprKind_If;
-	    expression->if_expr = malloc(sizeof(If));
-	    expression->if_expr->condition = try(parse_expression(context));
+	    // else if ladders are parsed in a loop. conditions and branches go on
+	    // the scratch stack and the ifs are built from the last one back,
+	    // each one the else of the one before it.
+	    usize ladder = scratch_begin(context);
+	    expr_id otherwise = 0;
 
-	    if (current_token(context)->kind != TokenKind_LBrace) {
-		sil_panic("Expected block after if");
-	    }
-	    expression->if_expr->then = try(parse_expression(context));
-	   
-	    // else (if) branch
-	    if (current_token(context)->kind == TokenKind_KeywordElse) {
+	    while (true) {
+		consume_token(context);
+		expr_id condition = try(parse_expression(context));
+
+		if (current_kind(context) != TokenKind_LBrace) {
+		    sil_panic("Expected block after if");
+		}
+		expr_id then = try(parse_expression(context));
+
+		scratch_push(context, &condition, sizeof(expr_id));
+		scratch_push(context, &then, sizeof(expr_id));
+
+		// else (if) branch
+		if (current_kind(context) != TokenKind_KeywordElse) { break; }
 		consume_token(context);
 
-		Token* next_token = current_token(context);
-		if (next_token->kind != TokenKind_KeywordIf &&
-		    next_token->kind != TokenKind_LBrace
-                ) {
+		Token next_token = current_token(context);
+		if (next_token.kind == TokenKind_KeywordIf) { continue; }
+		if (next_token.kind != TokenKind_LBrace) {
 		    sil_panic("Expected 'if' or '{' after an else");
 		}
 
-		expression->if_expr->otherwise = try(parse_expression(context));
-	    } else {
-		expression->if_expr->otherwise = null;
+		otherwise = try(parse_expression(context));
+		break;
 	    }
 
-	    break;
+	    for (usize i = context->scratch_len; i > ladder; i -= 2) {
+		expression.kind = ExprKind_If;
+		expression.if_expr.condition = context->scratch[i - 2];
+		expression.if_expr.then = context->scratch[i - 1];
+		expression.if_expr.otherwise = otherwise;
+		otherwise = ast_add_expr(context->ast, &expression);
+	    }
+	    context->scratch_len = ladder;
+
+	    return Some(otherwise);
 	}
 
 	case TokenKind_KeywordMatch: {
 	    consume_token(context);
-	    expression->kind = ExprKind_Match;
-	    expression->match = malloc(sizeof(Match));
-	    expression->match->arms = dynarray_init();
+	    expression.kind = ExprKind_Match;
 
-	    expression->match->condition = try(parse_expression(context));
+	    expression.match.condition = try(parse_expression(context));
 
 	    try(expect_token(context, TokenKind_LBrace));
 	   
-	    while (current_token(context)->kind != TokenKind_RBrace) {
-		MatchArm* arm = malloc(sizeof(MatchArm));
-		arm->pattern = try(parse_number_literal(context));
+	    usize arms = scratch_begin(context);
+	    while (current_kind(context) != TokenKind_RBrace) {
+		MatchArm arm;
+		arm.pattern = try(parse_number_literal(context));
 
 		try(expect_token(context, TokenKind_FatArrow));
-		arm->then = try(parse_expression(context));
+		arm.then = try(parse_expression(context));
 
-		dynarray_push(expression->match->arms, &arm);
+		scratch_push(context, &arm, sizeof(MatchArm));
 
-		if (current_token(context)->kind != TokenKind_RBrace) {
+		if (current_kind(context) != TokenKind_RBrace) {
 		    try(expect_token(context, TokenKind_Comma));
 		}
 
@@ -426,55 +555,58 @@ static Maybe(Expr*) parse_primary_expression(ParserContext* context) {
 
 	    try(expect_token(context, TokenKind_RBrace));
 
+	    expression.match.arms = scratch_end(context, arms, sizeof(MatchArm));
+
 	    break;
 	}
 
         case TokenKind_KeywordLoop: {
             consume_token(context);
-            expression->kind = ExprKind_Loop;
+            expression.kind = ExprKind_Loop;
 
-            if (current_token(context)->kind != TokenKind_LBrace) {
-                module_add_error(context->module, current_token(context), "expected '{'", "loop body must be a block");
-                return null;
+            if (current_kind(context) != TokenKind_LBrace) {
+                Token token = current_token(context);
+                module_add_error(context->module, &token, "expected '{'", "loop body must be a block");
+                return None;
             }
 
-            expression->loop = malloc(sizeof(Loop));
-            expression->loop->body = try(parse_primary_expression(context));
+            expression.loop.body = try(parse_primary_expression(context));
 
             break;
         }
 
 	default: {
-            module_add_error(context->module, current_token(context), "expected expression", "expression cannot start with %s", token_string(current_token(context)->kind));
+            Token token = current_token(context);
+            module_add_error(context->module, &token, "expected expression", "expression cannot start with %s", token_string(token.kind));
             return None;
 	}
     }
 
-    return Some(expression);
+    return Some(ast_add_expr(context->ast, &expression));
 }
 
-static Maybe(Expr*) parse_expression_prec(ParserContext* context, int precedence) {
-    Expr* left_expression = try(parse_primary_expression(context));
+static Maybe(expr_id) parse_expression_prec(ParserContext* context, int precedence) {
+    expr_id left_expression = try(parse_primary_expression(context));
 
     while (1) {
-	Token* operator_token = current_token(context);
+	TokenKind operator_kind = current_kind(context);
 
         // special cases
         // casting
-        if (operator_token->kind == TokenKind_KeywordAs) {
+        if (operator_kind == TokenKind_KeywordAs) {
             consume_token(context);
 
-            Expr* cast = malloc(sizeof(Expr));
-            cast->kind = ExprKind_Cast;
-            cast->cast = malloc(sizeof(Cast));
-            cast->cast->expr = left_expression;
-            cast->cast->to = try(parse_type(context));
-            left_expression = cast;
+            Expr cast;
+            cast.kind = ExprKind_Cast;
+            cast.codegen.type = 0;
+            cast.cast.expr = left_expression;
+            cast.cast.to = try(parse_type(context));
+            left_expression = ast_add_expr(context->ast, &cast);
             continue;
         }
 
 	int left, right;
-	operator_precedence(operator_token->kind, &left, &right);
+	operator_precedence(operator_kind, &left, &right);
 
 	if (left == -1) { break; }
 
@@ -482,86 +614,103 @@ static Maybe(Expr*) parse_expression_prec(ParserContext* context, int precedence
 
 	consume_token(context);
 
-	Expr* right_expression = try(parse_expression_prec(context, right));
-
-	Expr* operator = malloc(sizeof(Expr));
-	operator->kind = ExprKind_BinOp;
-	operator->binary_operator = malloc(sizeof(BinOp));
-
-	switch (operator_token->kind) {
-            case TokenKind_KeywordAnd: operator->binary_operator->kind = BinOpKind_And; break;
-            case TokenKind_KeywordOr: operator->binary_operator->kind = BinOpKind_Or; break;
-            case TokenKind_LessThan: operator->binary_operator->kind = BinOpKind_CmpLt; break;
-            case TokenKind_GreaterThan: operator->binary_operator->kind = BinOpKind_CmpGt; break;
-            case TokenKind_Equality: operator->binary_operator->kind = BinOpKind_CmpEq; break;
-            case TokenKind_Inequality: operator->binary_operator->kind = BinOpKind_CmpNotEq; break;
-	    case TokenKind_Equals: operator->binary_operator->kind = BinOpKind_Assign; break;
-	    case TokenKind_Plus: operator->binary_operator->kind = BinOpKind_Add; break;
-	    case TokenKind_Dash: operator->binary_operator->kind = BinOpKind_Sub; break;
-	    case TokenKind_Star: operator->binary_operator->kind = BinOpKind_Mul; break;
-	    case TokenKind_Slash: operator->binary_operator->kind = BinOpKind_Div; break;
+	expr_id right_expression = try(parse_expression_prec(context, right));
+
+	Expr operator;
+	operator.kind = ExprKind_BinOp;
+	operator.codegen.type = 0;
+
+	switch (operator_kind) {
+            case TokenKind_KeywordAnd: operator.binary_operator.kind = BinOpKind_And; break;
+            case TokenKind_KeywordOr: operator.binary_operator.kind = BinOpKind_Or; break;
+            case TokenKind_LessThan: operator.binary_operator.kind = BinOpKind_CmpLt; break;
+            case TokenKind_GreaterThan: operator.binary_operator.kind = BinOpKind_CmpGt; break;
+            case TokenKind_Equality: operator.binary_operator.kind = BinOpKind_CmpEq; break;
+            case TokenKind_Inequality: operator.binary_operator.kind = BinOpKind_CmpNotEq; break;
+	    case TokenKind_Equals: operator.binary_operator.kind = BinOpKind_Assign; break;
+	    case TokenKind_Plus: operator.binary_operator.kind = BinOpKind_Add; break;
+	    case TokenKind_Dash: operator.binary_operator.kind = BinOpKind_Sub; break;
+	    case TokenKind_Star: operator.binary_operator.kind = BinOpKind_Mul; break;
+	    case TokenKind_Slash: operator.binary_operator.kind = BinOpKind_Div; break;
 	    default: sil_panic("Unhandled operator");
 	}
 
-	operator->binary_operator->left = left_expression;
-	operator->binary_operator->right = right_expression;
+	operator.binary_operator.left = left_expression;
+	operator.binary_operator.right = right_expression;
 
-	left_expression = operator;
+	left_expression = ast_add_expr(context->ast, &operator);
     }
 
     return Some(left_expression);
 }
 
-static Maybe(Expr*) parse_expression(ParserContext* context) {
+static Maybe(expr_id) parse_expression(ParserContext* context) {
     return parse_expression_prec(context, 0);
 }
 
-static Maybe(Stmt*) parse_statement(ParserContext* context) {
-    Stmt* statement = malloc(sizeof(Stmt));
+static Maybe(stmt_id) parse_statement(ParserContext* context) {
+    Stmt statement;
 
-    switch (current_token(context)->kind) {
+    switch (current_kind(context)) {
 	default: {
-	    statement->kind = StmtKind_Expr;
-	    statement->expression = try(parse_expression(context));
+	    statement.kind = StmtKind_Expr;
+	    statement.expression = try(parse_expression(context));
 	   
-	    if (not should_remove_statement_semi(statement->expression)) {
-                if (current_token(context)->kind == TokenKind_Semicolon) {
+	    if (not should_remove_statement_semi(ast_expr(context->ast, statement.expression))) {
+                if (current_kind(context) == TokenKind_Semicolon) {
                     consume_token(context);
                 } else {
-                    statement->kind = StmtKind_NakedExpr;
+                    statement.kind = StmtKind_NakedExpr;
                 }
 	    }
 
 	    break;
 	}
     }
-    return Some(statement);
+    return Some(ast_add_stmt(context->ast, &statement));
 }
 
-static Maybe(FnSig*) parse_fn_signature(ParserContext* context, String* name) {
-    FnSig* fn_sig = malloc(sizeof(FnSig));
-
+static Maybe(u8) parse_fn_signature(ParserContext* context, FnSig* fn_sig, symbol_id* name) {
     try(expect_token(context, TokenKind_KeywordFn));
 
-    Token* name_token = try(expect_token(context, TokenKind_Symbol));
-    *name = name_token->span;
+    Token name_token = current_token(context);
+    try(expect_token(context, TokenKind_Symbol));
+    *name = name_token.symbol;
 
     try(expect_token(context, TokenKind_LParen));
 
-    fn_sig->parameters = dynarray_init();
-    while (current_token(context)->kind != TokenKind_RParen) {
-	FnParam* parameter = malloc(sizeof(FnParam));
+    usize parameters = scratch_begin(context);
+    while (current_kind(context) != TokenKind_RParen) {
+	FnParam parameter;
 
-	Token* name_token = try(expect_token(context, TokenKind_Symbol));
-	parameter->name = name_token->span;
+	Token name_token = current_token(context);
+	try(expect_token(context, TokenKind_Symbol));
+	parameter.name = name_token.symbol;
 
 	try(expect_token(context, TokenKind_Colon));
 
-	parameter->type = try(parse_type(context));
+	// noalias isn't a keyword, it can only come before a pointer type
+	parameter.alias = ParamAlias_Maybe;
+	Token qualifier = current_token(context);
+	if (qualifier.kind == TokenKind_Symbol and token_compare_literal(&qualifier, "noalias")) {
+	    consume_token(context);
+	    if (current_kind(context) != TokenKind_Star) {
+		module_add_error(
+		    context->module,
+		    &qualifier,
+		    "the parameter isn't a pointer",
+		    "noalias only applies to pointers"
+		);
+		return None;
+	    }
+	    parameter.alias = ParamAlias_Declared;
+	}
 
-	dynarray_push(fn_sig->parameters, &parameter);
+	parameter.type = try(parse_type(context));
 
-	if (current_token(context)->kind != TokenKind_Comma) {
+	scratch_push(context, &parameter, sizeof(FnParam));
+
+	if (current_kind(context) != TokenKind_Comma) {
 	    break;
 	}
 
@@ -570,86 +719,244 @@ static Maybe(FnSig*) parse_fn_signature(ParserContext* context, String* name) {
 
     try(expect_token(context, TokenKind_RParen));
 
-    if (current_token(context)->kind == TokenKind_Arrow) {
+    fn_sig->parameters = scratch_end(context, parameters, sizeof(FnParam));
+
+    if (current_kind(context) == TokenKind_Arrow) {
 	consume_token(context);
 	fn_sig->return_type = try(parse_type(context));
     } else {
-	Ast_Type* void_type = malloc(sizeof(Ast_Type));
-	void_type->kind = TypeKind_Void;
-	fn_sig->return_type = void_type;
+	Ast_Type void_type;
+	void_type.kind = TypeKind_Void;
+	fn_sig->return_type = ast_add_type(context->ast, &void_type);
     }
 
-    return Some(fn_sig);
+    return Some((u8)0);
 }
 
-static Maybe(FnDef*) parse_fn_definition(ParserContext* context, String* name) {
-    FnDef* fn_decl = malloc(sizeof(FnDef));
+// moves past the brace that closes the block at the current token. false
+// when the file ends first, the current token is then the Eof. the kinds
+// are scanned a window (or the whole list) at a time.
+static bool skip_block(ParserContext* context) {
+    TokenStream* tokens = context->tokens;
+    usize depth = 0;
+
+    while (true) {
+        usize slot = current_slot(context);
+        u8* kinds = tokens->tokens->kinds;
+        usize len = token_list_len(tokens->tokens);
+
+        for (; slot < len; slot += 1) {
+            switch (kinds[slot]) {
+                case TokenKind_LBrace: depth += 1; break;
+                case TokenKind_RBrace: {
+                    depth -= 1;
+                    if (depth == 0) {
+                        context->token_index = tokens->base + slot + 1;
+                        return true;
+                    }
+                    break;
+                }
+                case TokenKind_Eof: {
+                    context->token_index = tokens->base + slot;
+                    return false;
+                }
+                default: break;
+            }
+        }
+
+        context->token_index = tokens->base + len;
+    }
+}
 
-    fn_decl->signature = try(parse_fn_signature(context, name));
+static Maybe(u8) parse_fn_definition(ParserContext* context, FnDef* fn_decl, symbol_id* name) {
+    try(parse_fn_signature(context, &fn_decl->signature, name));
 
     // TODO: Make block expression
-    if (current_token(context)->kind != TokenKind_LBrace) {
-        module_add_error(context->module, current_token(context), "expected '{'", "Function body must be a block");
-        return null;
+    if (current_kind(context) != TokenKind_LBrace) {
+        Token token = current_token(context);
+        module_add_error(context->module, &token, "expected '{'", "Function body must be a block");
+        return None;
+    }
+
+    fn_decl->body = 0;
+    fn_decl->body_start = context->token_index;
+    fn_decl->queued = false;
+
+    if (context->lazy_bodies) {
+        if (skip_block(context)) { return Some((u8)0); }
+
+        // an unclosed body is parsed right away so the error is the same.
+        // streamed tokens are gone by now, the body is left to fail when
+        // it's parsed on its own.
+        if (context->tokens->tokens == &context->tokens->window) { return Some((u8)0); }
+        context->token_index = fn_decl->body_start;
     }
 
     fn_decl->body = try(parse_primary_expression(context));
 
-    return Some(fn_decl);
+    return Some((u8)0);
 }
 
-static Maybe(Constant*) parse_constant(ParserContext* context, String* name) {
-    Constant* constant = malloc(sizeof(Constant));
-
-    Token* ident = try(expect_token(context, TokenKind_Symbol));
-    *name = ident->span;
+static Maybe(u8) parse_constant(ParserContext* context, Constant* constant, symbol_id* name) {
+    Token ident = current_token(context);
+    try(expect_token(context, TokenKind_Symbol));
+    *name = ident.symbol;
 
-    if (current_token(context)->kind == TokenKind_Colon) {
+    if (current_kind(context) == TokenKind_Colon) {
         consume_token(context);
 
         constant->type = try(parse_type(context));
     } else {
-        constant->type = null;
+        constant->type = 0;
     }
 
     try(expect_token(context, TokenKind_Equals));
 
     constant->value = try(parse_expression(context));
 
-    return Some(constant);
+    return Some((u8)0);
+}
+
+typedef struct ItemAttributes {
+    // where the attributes start, for errors about what they're on
+    Token first;
+    FnInline inlining;
+    // from #[pure] or #[const], extern fns only, the rest is inferred
+    bool has_purity;
+    FnPurity purity;
+} ItemAttributes;
+
+// #[inline], #[noinline], #[pure] and #[const]. what they're allowed on is
+// checked by parse_item once it knows what follows.
+static Maybe(u8) parse_attributes(ParserContext* context, ItemAttributes* attributes) {
+    attributes->first = current_token(context);
+    attributes->inlining = FnInline_Auto;
+    attributes->has_purity = false;
+    attributes->purity = FnPurity_Impure;
+
+    while (current_kind(context) == TokenKind_Hash) {
+        consume_token(context);
+        try(expect_token(context, TokenKind_LBracket));
+
+        // const is a keyword
+        Token attribute = current_token(context);
+        if (attribute.kind == TokenKind_KeywordConst) {
+            consume_token(context);
+        } else {
+            try(expect_token(context, TokenKind_Symbol));
+        }
+
+        if (token_compare_literal(&attribute, "inline") or token_compare_literal(&attribute, "noinline")) {
+            FnInline found = token_compare_literal(&attribute, "inline") ? FnInline_Always : FnInline_Never;
+            if (attributes->inlining != FnInline_Auto and attributes->inlining != found) {
+                module_add_error(
+                    context->module,
+                    &attribute,
+                    "only one of them can apply",
+                    "#[inline] and #[noinline] on the same fn"
+                );
+                return None;
+            }
+            attributes->inlining = found;
+        } else if (token_compare_literal(&attribute, "pure") or token_compare_literal(&attribute, "const")) {
+            FnPurity found = token_compare_literal(&attribute, "pure") ? FnPurity_Pure : FnPurity_Const;
+            if (attributes->has_purity and attributes->purity != found) {
+                module_add_error(
+                    context->module,
+                    &attribute,
+                    "only one of them can apply",
+                    "#[pure] and #[const] on the same fn"
+                );
+                return None;
+            }
+            attributes->has_purity = true;
+            attributes->purity = found;
+        } else {
+            module_add_error(
+                context->module,
+                &attribute,
+                "expected inline, noinline, pure or const",
+                "unknown attribute '%.*s'",
+                str_format(attribute.span)
+            );
+            return None;
+        }
+
+        try(expect_token(context, TokenKind_RBracket));
+    }
+
+    return Some((u8)0);
 }
 
-static Maybe(Item*) parse_item(ParserContext* context) {
-    Item* item = malloc(sizeof(Item));
+static Maybe(item_id) parse_item(ParserContext* context) {
+    Item item;
+    item.reachable = false;
 
-    if (current_token(context)->kind == TokenKind_KeywordPub) {
+    ItemAttributes attributes;
+    try(parse_attributes(context, &attributes));
+
+    if (current_kind(context) == TokenKind_KeywordPub) {
 	consume_token(context);
-	item->visibility.is_pub = true;
+	item.visibility.is_pub = true;
     } else {
-	item->visibility.is_pub = false;
+	item.visibility.is_pub = false;
     }
 
-    switch (current_token(context)->kind) {
+    switch (current_kind(context)) {
 	case TokenKind_KeywordFn: {
-	    item->kind = ItemKind_FnDef;
-	    item->fn_definition = try(parse_fn_definition(context, &item->name));
+	    if (attributes.has_purity) {
+		module_add_error(
+		    context->module,
+		    &attributes.first,
+		    "it's worked out from the body",
+		    "#[pure] and #[const] only apply to extern fns"
+		);
+		return None;
+	    }
+
+	    item.kind = ItemKind_FnDef;
+	    try(parse_fn_definition(context, &item.fn_definition, &item.name));
+	    item.fn_definition.inlining = attributes.inlining;
+	    item.fn_definition.purity = FnPurity_Impure;
+	    item.fn_definition.folded_into = 0;
+	    item.fn_definition.address_taken = false;
 	    break;
 	}
 
 	case TokenKind_KeywordExtern: {
-	    item->kind = ItemKind_ExternFn;
+	    if (attributes.inlining != FnInline_Auto) {
+		module_add_error(
+		    context->module,
+		    &attributes.first,
+		    "an extern fn has no body to inline",
+		    "#[inline] and #[noinline] only apply to fns"
+		);
+		return None;
+	    }
+
+	    item.kind = ItemKind_ExternFn;
+	    item.extern_fn.purity = attributes.purity;
 	    consume_token(context);
-	    item->extern_fn = malloc(sizeof(ExternFn));
-	    item->extern_fn->signature = try(parse_fn_signature(context, &item->name));
+	    try(parse_fn_signature(context, &item.extern_fn.signature, &item.name));
 	    try(expect_token(context, TokenKind_Semicolon));
 	    break;
 	}
 
 	case TokenKind_KeywordConst: {
-	    item->kind = ItemKind_Const;
+	    if (attributes.first.kind == TokenKind_Hash) {
+		module_add_error(
+		    context->module,
+		    &attributes.first,
+		    "constants are written out as literals",
+		    "attributes only apply to fns"
+		);
+		return None;
+	    }
+
+	    item.kind = ItemKind_Const;
             consume_token(context);
 
-	    item->constant = try(parse_constant(context, &item->name));
+	    try(parse_constant(context, &item.constant, &item.name));
 
             try(expect_semicolon(context));
 
@@ -657,42 +964,242 @@ static Maybe(Item*) parse_item(ParserContext* context) {
 	}
 	
 	default: {
+            Token token = current_token(context);
             module_add_error(
                 context->module,
-                current_token(context),
+                &token,
                 "expected item (e.g. fn, struct)",
                 "expected item, found %s",
-                token_string(current_token(context)->kind)
+                token_string(token.kind)
             );
             return None;
 	}
     }
 
-    return Some(item);
+    return Some(ast_add_item(context->ast, &item));
 }
 
-static Maybe(AstRoot*) parse_root(ParserContext* context) {
-    AstRoot* root = malloc(sizeof(AstRoot));
+// parses items until the one that reaches end (or the Eof token)
+static Maybe(u8) parse_root(ParserContext* context, usize end) {
+    while (context->token_index < end and current_kind(context) != TokenKind_Eof) {
+	try(parse_item(context));
+    }
 
-    root->items = dynarray_init();
+    return Some((u8)0);
+}
 
-    while (current_token(context)->kind != TokenKind_Eof) {
-	Item* item = try(parse_item(context));
+static void parser_context_init(ParserContext* context, Module* module, Ast* ast, TokenStream* tokens, usize start) {
+    context->module = module;
+    context->ast = ast;
+    context->tokens = tokens;
+    context->token_index = start;
+    context->lazy_bodies = false;
+    context->scratch = null;
+    context->scratch_len = 0;
+    context->scratch_capacity = 0;
+}
 
-	dynarray_push(root->items, &item);
+static void parser_context_deinit(ParserContext* context) {
+    free(context->scratch);
+}
+
+
+// ---------------- //
+// Parallel Parsing //
+// ---------------- //
+typedef struct ParserChunk {
+    // the tokens [start, end) should hold whole items
+    usize start;
+    usize end;
+    // where parsing stopped, past end when the last item ran over it
+    usize stop;
+    TokenList* tokens;
+    bool lazy_bodies;
+
+    // a copy of the module with errors of its own, the parser only touches
+    // the module to report errors. nodes go into a private ast.
+    Module module;
+    Ast ast;
+} ParserChunk;
+
+// guesses where the item at index ends from the braces alone. fns end with
+// the brace that closes their body, everything else with a semicolon.
+static usize skip_item(TokenList* tokens, usize index) {
+    u8* kinds = tokens->kinds;
+    usize len = token_list_len(tokens);
+
+    usize i = index;
+    // attributes, #[name] each
+    while (i + 3 < len and kinds[i] == TokenKind_Hash) { i += 4; }
+    if (i < len and kinds[i] == TokenKind_KeywordPub) { i += 1; }
+    bool ends_with_brace = i < len and kinds[i] == TokenKind_KeywordFn;
+
+    usize depth = 0;
+    for (; i < len; i += 1) {
+        switch (kinds[i]) {
+            case TokenKind_Eof: return i;
+            case TokenKind_LBrace: depth += 1; break;
+            case TokenKind_RBrace: {
+                if (depth > 0) { depth -= 1; }
+                if (depth == 0 and ends_with_brace) { return i + 1; }
+                break;
+            }
+            case TokenKind_Semicolon: {
+                if (depth == 0) { return i + 1; }
+                break;
+            }
+            default: break;
+        }
     }
 
-    return Some(root);
+    return len;
 }
 
-void parser_parse(Module* module) {
+static void parse_chunk(void* data, usize index) {
+    ParserChunk* chunk = &((ParserChunk*)data)[index];
+
+    TokenStream stream;
+    token_stream_init_list(&stream, &chunk->module, chunk->tokens);
+
     ParserContext context;
-    context.module = module;
-    context.token_index = 0;
+    parser_context_init(&context, &chunk->module, &chunk->ast, &stream, chunk->start);
+    context.lazy_bodies = chunk->lazy_bodies;
+    parse_root(&context, chunk->end);
+    chunk->stop = context.token_index;
 
-    Maybe(AstRoot*) root = parse_root(&context);
-    if (root != None) {
-        module->ast = unwrap(root);
+    parser_context_deinit(&context);
+    token_stream_deinit(&stream);
+}
+
+// items are split into chunks by skip_item and each chunk is parsed into an
+// ast of its own on the thread pool. the chunks are then appended in order,
+// which gives the same ids a sequential parse would. a chunk only lines up
+// if the one before it stopped where it starts, from the first one that
+// doesn't the rest of the file is parsed again sequentially. only the errors
+// of the first chunk that failed are kept, a sequential parse stops there.
+static void parse_parallel(Module* module, TokenStream* tokens, bool lazy_bodies, usize thread_count, usize chunk_count) {
+    TokenList* list = tokens->tokens;
+    usize len = token_list_len(list);
+    ParserChunk* chunks = malloc(sizeof(ParserChunk) * chunk_count);
+
+    usize chunk_start = 0;
+    usize actual_count = 0;
+    for (usize i = 0; i < chunk_count and list->kinds[chunk_start] != TokenKind_Eof; i += 1) {
+        usize chunk_end = len;
+        if (i + 1 < chunk_count) {
+            usize target = len / chunk_count * (i + 1);
+            chunk_end = chunk_start;
+            while (chunk_end < target and list->kinds[chunk_end] != TokenKind_Eof) {
+                chunk_end = skip_item(list, chunk_end);
+            }
+        }
+
+        ParserChunk* chunk = &chunks[actual_count];
+        chunk->start = chunk_start;
+        chunk->end = chunk_end;
+        chunk->tokens = list;
+        chunk->lazy_bodies = lazy_bodies;
+        chunk->module = *module;
+        arena_init(&chunk->module.arena);
+        chunk->module.errors = dynarray_init();
+        chunk->module.has_errors = false;
+        ast_init(&chunk->ast, module->source);
+
+        actual_count += 1;
+        chunk_start = chunk_end;
     }
+
+    threadpool_run(thread_count, actual_count, parse_chunk, chunks);
+
+    usize position = 0;
+    bool lined_up = true;
+    for (usize i = 0; i < actual_count; i += 1) {
+        ParserChunk* chunk = &chunks[i];
+        if (chunk->start != position) {
+            lined_up = false;
+            break;
+        }
+
+        ast_append(&module->ast, &chunk->ast);
+        if (chunk->module.has_errors) {
+            module_take_errors(module, &chunk->module);
+            break;
+        }
+
+        position = chunk->stop;
+    }
+
+    if (not lined_up) {
+        ParserContext context;
+        parser_context_init(&context, module, &module->ast, tokens, position);
+        context.lazy_bodies = lazy_bodies;
+        parse_root(&context, SIZE_MAX);
+        parser_context_deinit(&context);
+    }
+
+    for (usize i = 0; i < actual_count; i += 1) {
+        ast_deinit(&chunks[i].ast);
+        dynarray_deinit(chunks[i].module.errors);
+        arena_deinit(&chunks[i].module.arena);
+    }
+    free(chunks);
 }
 
+void parser_parse(Module* module, TokenStream* tokens, ParserOptions* options) {
+    usize thread_count = options->thread_count;
+    if (thread_count == 0) {
+        thread_count = threadpool_default_count();
+    }
+
+    // streamed tokens aren't all there up front, they're parsed in one go
+    bool streaming = tokens->tokens == &tokens->window;
+    bool lazy_bodies = options->lazy_bodies;
+
+    if (not streaming) {
+        usize chunk_count = token_list_len(tokens->tokens) / PARSER_MIN_CHUNK_TOKENS;
+        if (chunk_count > thread_count) { chunk_count = thread_count; }
+
+        if (chunk_count > 1) {
+            parse_parallel(module, tokens, lazy_bodies, thread_count, chunk_count);
+            return;
+        }
+    }
+
+    ParserContext context;
+    parser_context_init(&context, module, &module->ast, tokens, 0);
+    context.lazy_bodies = lazy_bodies;
+    parse_root(&context, SIZE_MAX);
+    parser_context_deinit(&context);
+}
+
+static Maybe(u8) parse_body(ParserContext* context, expr_id* body) {
+    *body = try(parse_primary_expression(context));
+
+    return Some((u8)0);
+}
+
+expr_id parser_parse_body_from(Module* module, TokenStream* tokens, item_id item) {
+    FnDef* fn_definition = &ast_item(&module->ast, item)->fn_definition;
+    if (fn_definition->body != 0) { return fn_definition->body; }
+
+    ParserContext context;
+    parser_context_init(&context, module, &module->ast, tokens, fn_definition->body_start);
+
+    expr_id body = 0;
+    parse_body(&context, &body);
+
+    parser_context_deinit(&context);
+
+    // parsing adds nodes, but never items, so the pointer still holds
+    fn_definition->body = body;
+    return body;
+}
+
+expr_id parser_parse_body(Module* module, item_id item) {
+    TokenStream tokens;
+    token_stream_init_list(&tokens, module, &module->tokens);
+    expr_id body = parser_parse_body_from(module, &tokens, item);
+    token_stream_deinit(&tokens);
+
+    return body;
+}
@@ -2,7 +2,24 @@
 #define PARSER_H
 
 #include "module.h"
+#include "lexer.h"
 
-void parser_parse(Module* module);
+typedef struct ParserOptions {
+    // 0 uses one thread per core. items of large files are parsed in
+    // parallel when the tokens were lexed up front, the ast is the same
+    // either way.
+    usize thread_count;
+    // only find where fn bodies end, they're parsed by parser_parse_body
+    // when they're needed. with streamed tokens they have to be parsed in
+    // source order from a second stream, see parser_parse_body_from.
+    bool lazy_bodies;
+} ParserOptions;
+
+void parser_parse(Module* module, TokenStream* tokens, ParserOptions* options);
+// parses the body of a fn that was skipped by a lazy parse, returns 0 (and
+// adds an error) when it doesn't parse
+expr_id parser_parse_body(Module* module, item_id item);
+// the same, reading the tokens from a stream that hasn't passed the body yet
+expr_id parser_parse_body_from(Module* module, TokenStream* tokens, item_id item);
 
 #endif // PARSER_H
@@ -0,0 +1,161 @@
+#include "scan.h"
+
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCAN_X86
+#include <immintrin.h>
+#endif
+
+
+typedef usize (*ScanFn)(const char* ptr, usize len);
+
+typedef struct Scanner {
+    ScanFn whitespace;
+    ScanFn identifier;
+} Scanner;
+
+
+// ------ //
+// Scalar //
+// ------ //
+static bool is_whitespace(char c) {
+    return c == ' ' or (c >= '\t' and c <= '\r');
+}
+
+static bool is_identifier(char c) {
+    return (
+        (c >= 'a' and c <= 'z') or
+        (c >= 'A' and c <= 'Z') or
+        (c >= '0' and c <= '9') or
+        c == '_'
+    );
+}
+
+static usize scalar_whitespace(const char* ptr, usize len) {
+    usize i = 0;
+    while (i < len and is_whitespace(ptr[i])) { i += 1; }
+    return i;
+}
+
+static usize scalar_identifier(const char* ptr, usize len) {
+    usize i = 0;
+    while (i < len and is_identifier(ptr[i])) { i += 1; }
+    return i;
+}
+
+
+#ifdef SCAN_X86
+// ---- //
+// SSE2 //
+// ---- //
+// bytes >= 0x80 compare as negative, so they never land inside a range
+__attribute__((target("sse2")))
+static inline __m128i sse2_in_range(__m128i v, char lo, char hi) {
+    return _mm_and_si128(
+        _mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)),
+        _mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1))
+    );
+}
+
+__attribute__((target("sse2")))
+static usize sse2_whitespace(const char* ptr, usize len) {
+    usize i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(ptr + i));
+        __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), sse2_in_range(v, '\t', '\r'));
+        u32 mask = ~(u32)_mm_movemask_epi8(ws) & 0xffff;
+        if (mask != 0) { return i + __builtin_ctz(mask); }
+    }
+
+    return i + scalar_whitespace(ptr + i, len - i);
+}
+
+__attribute__((target("sse2")))
+static usize sse2_identifier(const char* ptr, usize len) {
+    usize i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(ptr + i));
+        // folding case with 0x20 only maps letters onto 'a'..'z'
+        __m128i alpha = sse2_in_range(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+        __m128i digit = sse2_in_range(v, '0', '9');
+        __m128i under = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+        __m128i ident = _mm_or_si128(_mm_or_si128(alpha, digit), under);
+        u32 mask = ~(u32)_mm_movemask_epi8(ident) & 0xffff;
+        if (mask != 0) { return i + __builtin_ctz(mask); }
+    }
+
+    return i + scalar_identifier(ptr + i, len - i);
+}
+
+// ---- //
+// AVX2 //
+// ---- //
+__attribute__((target("avx2")))
+static inline __m256i avx2_in_range(__m256i v, char lo, char hi) {
+    return _mm256_and_si256(
+        _mm256_cmpgt_epi8(v, _mm256_set1_epi8(lo - 1)),
+        _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), v)
+    );
+}
+
+__attribute__((target("avx2")))
+static usize avx2_whitespace(const char* ptr, usize len) {
+    usize i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(ptr + i));
+        __m256i ws = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), avx2_in_range(v, '\t', '\r'));
+        u32 mask = ~(u32)_mm256_movemask_epi8(ws);
+        if (mask != 0) { return i + __builtin_ctz(mask); }
+    }
+
+    return i + sse2_whitespace(ptr + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static usize avx2_identifier(const char* ptr, usize len) {
+    usize i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(ptr + i));
+        __m256i alpha = avx2_in_range(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z');
+        __m256i digit = avx2_in_range(v, '0', '9');
+        __m256i under = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+        __m256i ident = _mm256_or_si256(_mm256_or_si256(alpha, digit), under);
+        u32 mask = ~(u32)_mm256_movemask_epi8(ident);
+        if (mask != 0) { return i + __builtin_ctz(mask); }
+    }
+
+    return i + sse2_identifier(ptr + i, len - i);
+}
+#endif // SCAN_X86
+
+
+static Scanner scanner = {
+    .whitespace = scalar_whitespace,
+    .identifier = scalar_identifier,
+};
+
+static pthread_once_t scanner_picked = PTHREAD_ONCE_INIT;
+
+static void pick_scanner(void) {
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        scanner = (Scanner){ avx2_whitespace, avx2_identifier };
+    } else if (__builtin_cpu_supports("sse2")) {
+        scanner = (Scanner){ sse2_whitespace, sse2_identifier };
+    }
+#endif
+}
+
+void scan_init(void) {
+    pthread_once(&scanner_picked, pick_scanner);
+}
+
+usize scan_whitespace(const char* ptr, usize len) {
+    return scanner.whitespace(ptr, len);
+}
+
+usize scan_identifier(const char* ptr, usize len) {
+    return scanner.identifier(ptr, len);
+}
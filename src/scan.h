@@ -0,0 +1,19 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <chnlib/chntype.h>
+
+
+// byte-run scanners used by the lexer. each one is picked once at runtime
+// (avx2, sse2 or scalar) and returns how many leading bytes of the input
+// belong to the run.
+
+// picks the scanners the first time it's called, later calls wait for that.
+// lexers only read them, so it's called before anything is lexed. until
+// then the scalar ones are used.
+void scan_init(void);
+
+usize scan_whitespace(const char* ptr, usize len);
+usize scan_identifier(const char* ptr, usize len);
+
+#endif // !SCAN_H
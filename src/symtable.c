@@ -1,62 +1,166 @@
 #include "symtable.h"
 
+#include <stdlib.h>
 
-static void scope_init(Scope* scope, Scope* parent) {
-    scope->parent = parent;
-    scope->children = dynarray_init();
-    scope->symbols = map_init();
+#define SYMTABLE_INITIAL_CAPACITY 64
+#define SYMTABLE_INITIAL_BINDINGS 64
+#define SYMTABLE_INITIAL_SCOPES 16
+
+
+static usize hash_symbol(symbol_id name, usize capacity) {
+    return (name * 2654435761u) & (capacity - 1);
 }
 
-static void scope_deinit(Scope* scope) {
-    dynarray_deinit(scope->children);
-    map_deinit(scope->symbols);
+static void* grow_array(void* array, u32* capacity, u32 initial, usize size) {
+    *capacity = *capacity == 0 ? initial : *capacity * 2;
+    array = realloc(array, *capacity * size);
+    if (array == null) {
+        sil_panic("out of memory");
+    }
+    return array;
 }
 
-void symtable_init(SymTable* symtable) {
-    scope_init(&symtable->root_scope, null);
-    symtable->current_scope = &symtable->root_scope;
+// returns the slot holding the name, or the empty slot it would go in
+static usize find_slot(SymTable* symtable, symbol_id name) {
+    usize slot = hash_symbol(name, symtable->capacity);
+    while (symtable->slots[slot] != 0) {
+        if (symtable->bindings[symtable->slots[slot] - 1].name == name) {
+            return slot;
+        }
+
+        slot = (slot + 1) & (symtable->capacity - 1);
+    }
+
+    return slot;
 }
 
-void symtable_deinit(SymTable* symtable) {
-    Scope* current = symtable->current_scope;
-    while (current != null) {
-        scope_deinit(current);
-        current = current->parent;
+static void grow_slots(SymTable* symtable) {
+    usize capacity = symtable->capacity * 2;
+    u32* slots = calloc(capacity, sizeof(u32));
+
+    for (usize i = 0; i < symtable->capacity; i += 1) {
+        u32 binding = symtable->slots[i];
+        if (binding == 0) { continue; }
+
+        usize slot = hash_symbol(symtable->bindings[binding - 1].name, capacity);
+        while (slots[slot] != 0) { slot = (slot + 1) & (capacity - 1); }
+        slots[slot] = binding;
     }
+
+    free(symtable->slots);
+    symtable->slots = slots;
+    symtable->capacity = capacity;
 }
 
-void symtable_enter_scope(SymTable* const symtable) {
-    Scope* current_scope = symtable->current_scope;
+// empties a slot and moves later names of the same probe run back into the
+// gap, so lookups never need tombstones
+static void remove_slot(SymTable* symtable, usize slot) {
+    usize mask = symtable->capacity - 1;
+    usize hole = slot;
+    usize next = (hole + 1) & mask;
 
-    Scope* scope = dynarray_add(current_scope->children);
-    scope_init(scope, current_scope);
+    while (symtable->slots[next] != 0) {
+        usize home = hash_symbol(symtable->bindings[symtable->slots[next] - 1].name, symtable->capacity);
+        // a name can only move back if the hole is between its home and it
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            symtable->slots[hole] = symtable->slots[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
 
-    symtable->current_scope = scope;
+    symtable->slots[hole] = 0;
 }
 
-void symtable_exit_scope(SymTable* const symtable) {
-    symtable->current_scope = symtable->current_scope->parent;
+void symtable_init(SymTable* symtable) {
+    symtable->bindings = null;
+    symtable->binding_count = 0;
+    symtable->binding_capacity = 0;
+
+    symtable->scope_starts = null;
+    symtable->depth = 0;
+    symtable->scope_capacity = 0;
+
+    symtable->capacity = SYMTABLE_INITIAL_CAPACITY;
+    symtable->name_count = 0;
+    symtable->slots = calloc(symtable->capacity, sizeof(u32));
+}
+
+void symtable_deinit(SymTable* symtable) {
+    free(symtable->bindings);
+    free(symtable->scope_starts);
+    free(symtable->slots);
 }
 
-void symtable_insert(SymTable* const symtable, String const name, SymEntry* const entry) {
-    map_insert(symtable->current_scope->symbols, name, entry);
+void symtable_enter_scope(SymTable* const symtable) {
+    if (symtable->depth == symtable->scope_capacity) {
+        symtable->scope_starts = grow_array(
+            symtable->scope_starts, &symtable->scope_capacity, SYMTABLE_INITIAL_SCOPES, sizeof(u32)
+        );
+    }
+
+    symtable->scope_starts[symtable->depth] = symtable->binding_count;
+    symtable->depth += 1;
 }
 
-SymEntry* symtable_get(SymTable* const symtable, String const name) {
-    Scope* scope = symtable->current_scope;
-    while (scope != null) {
-        SymEntry* entry = map_get_ref(scope->symbols, name);
-        if (entry != null) {
-            return entry;
+void symtable_exit_scope(SymTable* const symtable) {
+    symtable->depth -= 1;
+    u32 start = symtable->scope_starts[symtable->depth];
+
+    // innermost first, so every name goes back to the binding it hid
+    for (u32 i = symtable->binding_count; i > start; i -= 1) {
+        SymBinding* binding = &symtable->bindings[i - 1];
+        usize slot = find_slot(symtable, binding->name);
+        if (binding->shadowed != 0) {
+            symtable->slots[slot] = binding->shadowed;
+        } else {
+            remove_slot(symtable, slot);
+            symtable->name_count -= 1;
         }
+    }
+
+    symtable->binding_count = start;
+}
 
-        scope = scope->parent;
+void symtable_insert(SymTable* const symtable, symbol_id const name, SymEntry* const entry) {
+    usize slot = find_slot(symtable, name);
+    u32 shadowed = symtable->slots[slot];
+
+    // bound twice in the same scope, the last one wins
+    if (shadowed != 0 and symtable->bindings[shadowed - 1].depth == symtable->depth) {
+        symtable->bindings[shadowed - 1].entry = *entry;
+        return;
+    }
+
+    if (symtable->binding_count == symtable->binding_capacity) {
+        symtable->bindings = grow_array(
+            symtable->bindings, &symtable->binding_capacity, SYMTABLE_INITIAL_BINDINGS, sizeof(SymBinding)
+        );
+    }
+
+    symtable->bindings[symtable->binding_count] = (SymBinding){ name, symtable->depth, shadowed, *entry };
+    symtable->binding_count += 1;
+    symtable->slots[slot] = symtable->binding_count;
+
+    // keep the load factor under a half
+    if (shadowed == 0) {
+        symtable->name_count += 1;
+        if (symtable->name_count * 2 > symtable->capacity) {
+            grow_slots(symtable);
+        }
     }
+}
 
-    return null;
+SymEntry* symtable_get(SymTable* const symtable, symbol_id const name) {
+    u32 binding = symtable->slots[find_slot(symtable, name)];
+    if (binding == 0) { return null; }
+
+    return &symtable->bindings[binding - 1].entry;
 }
 
-SymEntry* symtable_get_local(SymTable* const symtable, String const name) {
-    SymEntry* entry = map_get_ref(symtable->current_scope->symbols, name);
-    return entry;
+SymEntry* symtable_get_local(SymTable* const symtable, symbol_id const name) {
+    u32 binding = symtable->slots[find_slot(symtable, name)];
+    if (binding == 0 or symtable->bindings[binding - 1].depth != symtable->depth) { return null; }
+
+    return &symtable->bindings[binding - 1].entry;
 }
@@ -2,20 +2,22 @@
 #define SYMTABLE_H
 
 #include "ast.h"
-
-#include <chnlib/str.h>
+#include "intern.h"
 
 
 // SymTable defined in ast.h
 
+// a lookup is one hash probe however deep the scopes are nested, leaving a
+// scope only touches the names bound in it. entries are good until the next
+// insert.
 void symtable_init(SymTable* symtable);
 void symtable_deinit(SymTable* symtable);
 
 void symtable_enter_scope(SymTable* const symtable);
 void symtable_exit_scope(SymTable* const symtable);
 
-void symtable_insert(SymTable* const symtable, String const name, SymEntry* const entry);
-SymEntry* symtable_get(SymTable* const symtable, String const name);
-SymEntry* symtable_get_local(SymTable* const symtable, String const name);
+void symtable_insert(SymTable* const symtable, symbol_id const name, SymEntry* const entry);
+SymEntry* symtable_get(SymTable* const symtable, symbol_id const name);
+SymEntry* symtable_get_local(SymTable* const symtable, symbol_id const name);
 
 #endif
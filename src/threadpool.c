@@ -0,0 +1,66 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "threadpool.h"
+
+#include "util.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+
+typedef struct ThreadPool {
+    ThreadTask task;
+    void* data;
+    usize task_count;
+    atomic_size_t next_task;
+} ThreadPool;
+
+static void* worker(void* arg) {
+    ThreadPool* pool = arg;
+    while (true) {
+        usize index = atomic_fetch_add(&pool->next_task, 1);
+        if (index >= pool->task_count) { break; }
+
+        pool->task(pool->data, index);
+    }
+
+    return null;
+}
+
+void threadpool_run(usize thread_count, usize task_count, ThreadTask task, void* data) {
+    ThreadPool pool;
+    pool.task = task;
+    pool.data = data;
+    pool.task_count = task_count;
+    atomic_init(&pool.next_task, 0);
+
+    if (thread_count > task_count) { thread_count = task_count; }
+    if (thread_count <= 1) {
+        worker(&pool);
+        return;
+    }
+
+    // the calling thread is one of the workers
+    usize spawned_count = thread_count - 1;
+    pthread_t* threads = malloc(sizeof(pthread_t) * spawned_count);
+    for (usize i = 0; i < spawned_count; i += 1) {
+        if (pthread_create(&threads[i], null, worker, &pool) != 0) {
+            sil_panic("failed to spawn worker thread");
+        }
+    }
+
+    worker(&pool);
+
+    for (usize i = 0; i < spawned_count; i += 1) {
+        pthread_join(threads[i], null);
+    }
+
+    free(threads);
+}
+
+usize threadpool_default_count(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count < 1 ? 1 : (usize)count;
+}
@@ -0,0 +1,16 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <chnlib/chntype.h>
+
+
+typedef void (*ThreadTask)(void* data, usize index);
+
+// runs task(data, i) for every i in [0, task_count) on up to thread_count
+// threads (the calling thread included) and returns once all have finished.
+// tasks are handed out in index order but may finish in any order.
+void threadpool_run(usize thread_count, usize task_count, ThreadTask task, void* data);
+
+usize threadpool_default_count(void);
+
+#endif // !THREADPOOL_H
@@ -3,6 +3,78 @@
 #include "util.h"
 #include "string.h"
 #include <stdio.h>
+#include <stdlib.h>
+
+#define TOKEN_LIST_INITIAL_CAPACITY 256
+
+void token_list_init(TokenList* list, String source) {
+    list->source = source;
+    list->kinds = null;
+    list->starts = null;
+    list->lengths = null;
+    list->symbols = null;
+    list->len = 0;
+    list->capacity = 0;
+}
+
+void token_list_deinit(TokenList* list) {
+    free(list->kinds);
+    free(list->starts);
+    free(list->lengths);
+    free(list->symbols);
+}
+
+void token_list_reserve(TokenList* list, usize count) {
+    if (list->len + count <= list->capacity) { return; }
+
+    usize capacity = list->capacity == 0 ? TOKEN_LIST_INITIAL_CAPACITY : list->capacity;
+    while (capacity < list->len + count) { capacity *= 2; }
+
+    list->kinds = realloc(list->kinds, sizeof(u8) * capacity);
+    list->starts = realloc(list->starts, sizeof(u32) * capacity);
+    list->lengths = realloc(list->lengths, sizeof(u32) * capacity);
+    list->symbols = realloc(list->symbols, sizeof(symbol_id) * capacity);
+    if (list->kinds == null or list->starts == null or list->lengths == null or list->symbols == null) {
+        sil_panic("out of memory");
+    }
+    list->capacity = capacity;
+}
+
+usize token_list_push(TokenList* list, TokenKind kind, usize start) {
+    token_list_reserve(list, 1);
+
+    usize index = list->len;
+    list->kinds[index] = kind;
+    list->starts[index] = start;
+    list->lengths[index] = 0;
+    list->symbols[index] = 0;
+    list->len += 1;
+    return index;
+}
+
+usize token_list_len(TokenList* list) {
+    return list->len;
+}
+
+Token token_list_get(TokenList* list, usize index) {
+    return (Token){
+        .kind = list->kinds[index],
+        .span = str_slice(list->source.ptr + list->starts[index], list->lengths[index]),
+        .symbol = list->symbols[index],
+    };
+}
+
+// a whole array at a time, the chunks of a parallel lex are stitched back
+// together with it
+void token_list_append(TokenList* list, TokenList* other) {
+    token_list_reserve(list, other->len);
+
+    memcpy(list->kinds + list->len, other->kinds, sizeof(u8) * other->len);
+    memcpy(list->starts + list->len, other->starts, sizeof(u32) * other->len);
+    memcpy(list->lengths + list->len, other->lengths, sizeof(u32) * other->len);
+    memcpy(list->symbols + list->len, other->symbols, sizeof(symbol_id) * other->len);
+    list->len += other->len;
+}
 
 int token_compare_literal(Token* token, char* literal) {
     size_t const literal_length = strlen(literal);
@@ -21,6 +93,8 @@ char* token_string(TokenKind kind) {
         case TokenKind_RBrace: return "'{'";
         case TokenKind_LParen: return "'('";
         case TokenKind_RParen: return "')'";
+        case TokenKind_LBracket: return "'['";
+        case TokenKind_RBracket: return "']'";
         case TokenKind_Colon: return "':'";
         case TokenKind_Semicolon: return "';'";
         case TokenKind_Comma: return "','";
@@ -42,6 +116,7 @@ char* token_string(TokenKind kind) {
         case TokenKind_Bang: return "'!'";
         case TokenKind_Dot: return "'.'";
 	case TokenKind_Percent: return "'%'";
+        case TokenKind_Hash: return "'#'";
         case TokenKind_KeywordAsm: return "keyword 'asm'";
         case TokenKind_KeywordUnreachable: return "keyword 'unreachable'";
         case TokenKind_KeywordVolatile: return "keyword 'volatile'";
@@ -2,6 +2,8 @@
 #define TOKEN_H
 
 #include <chnlib/str.h>
+#include <chnlib/dynarray.h>
+#include "intern.h"
 
 
 typedef enum TokenKind {
@@ -16,6 +18,9 @@ typedef enum TokenKind {
 
     TokenKind_LParen,
     TokenKind_RParen,
+
+    TokenKind_LBracket,
+    TokenKind_RBracket,
     
     TokenKind_Colon,
     TokenKind_Semicolon,
@@ -39,6 +44,7 @@ typedef enum TokenKind {
     TokenKind_Plus,
     TokenKind_Dash,
     TokenKind_Percent,
+    TokenKind_Hash,
 
     TokenKind_KeywordAsm,
     TokenKind_KeywordUnreachable,
@@ -66,16 +72,40 @@ typedef enum TokenKind {
 } TokenKind;
 
 typedef struct TextPosition {
-    unsigned int line;
-    unsigned int column;
+    usize line;
+    usize column;
 } TextPosition;
 
+// a view of one token, built on demand from a TokenList
 typedef struct Token {
     TokenKind kind;
-    TextPosition position;
     String span;
+    // set for TokenKind_Symbol
+    symbol_id symbol;
 } Token;
 
+// tokens are stored as parallel arrays so the parser, which mostly looks at
+// kinds, only touches one byte per token. offsets are relative to source.
+// the arrays grow together, each has room for capacity tokens.
+typedef struct TokenList {
+    String source;
+    u8* kinds;
+    u32* starts;
+    u32* lengths;
+    symbol_id* symbols;
+    usize len;
+    usize capacity;
+} TokenList;
+
+void token_list_init(TokenList* list, String source);
+void token_list_deinit(TokenList* list);
+// makes room for count more tokens
+void token_list_reserve(TokenList* list, usize count);
+usize token_list_push(TokenList* list, TokenKind kind, usize start);
+usize token_list_len(TokenList* list);
+Token token_list_get(TokenList* list, usize index);
+void token_list_append(TokenList* list, TokenList* other);
+
 char* token_string(TokenKind type);
 int token_compare_literal(Token* token, char* symbol);
 void token_print(Token* token);
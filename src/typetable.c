@@ -1,61 +1,149 @@
 #include "typetable.h"
 
-void typetable_init(TypeTable* table) {
-    table->types = dynarray_init();
-    // type_id = 0 is invalid
-    TypeEntry* entry = dynarray_add(table->types);
-    entry->kind = TypeEntryKind_Invalid;
+#include "util.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define TYPETABLE_INITIAL_CAPACITY 64
+
+
+static u32 hash_entry(TypeEntry* entry) {
+    // fnv-1a
+    const u8* bytes = (const u8*)entry;
+    u32 hash = 2166136261u;
+    for (usize i = 0; i < sizeof(TypeEntry); i += 1) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
 }
 
-void typetable_deinit(TypeTable* table) {
-    dynarray_deinit(table->types);
+static void grow(TypeTable* table) {
+    usize capacity = table->capacity * 2;
+    type_id* slots = calloc(capacity, sizeof(type_id));
+
+    for (usize i = 0; i < table->capacity; i += 1) {
+        type_id id = table->slots[i];
+        if (id == 0) { continue; }
+
+        usize slot = table->hashes[id] & (capacity - 1);
+        while (slots[slot] != 0) { slot = (slot + 1) & (capacity - 1); }
+        slots[slot] = id;
+    }
+
+    free(table->slots);
+    table->slots = slots;
+    table->capacity = capacity;
 }
 
-type_id typetable_new_type(TypeTable* table, TypeEntryKind kind, size_t bits) {
-    TypeEntry* entry = dynarray_add(table->types);
-    entry->parent_ptr = 0;
-    entry->parent_ptr_mut = 0;
-    entry->kind = kind;
-    entry->bits = bits;
+// returns the slot holding the type, or the empty slot it would go in
+static usize find_slot(TypeTable* table, TypeEntry* entry, u32 hash) {
+    usize slot = hash & (table->capacity - 1);
+    while (true) {
+        type_id id = table->slots[slot];
+        if (id == 0) { return slot; }
+
+        if (table->hashes[id] == hash and memcmp(&table->types[id], entry, sizeof(TypeEntry)) == 0) {
+            return slot;
+        }
 
-    return dynarray_len(table->types) - 1;
+        slot = (slot + 1) & (table->capacity - 1);
+    }
 }
 
-type_id typetable_new_ptr(TypeTable* table, type_id to, bool is_mut) {
-    type_id new = typetable_new_type(table, TypeEntryKind_Ptr, 64);
+// the entry has to have been zeroed before it was filled in
+static type_id intern_entry(TypeTable* table, TypeEntry* entry) {
+    u32 hash = hash_entry(entry);
+    usize slot = find_slot(table, entry, hash);
+    if (table->slots[slot] != 0) {
+        return table->slots[slot];
+    }
+    if (table->frozen) {
+        sil_panic("Analyzer Error: new type in a frozen type table");
+    }
 
-    TypeEntry* new_entry = &table->types[new];
-    new_entry->ptr.to = to;
-    new_entry->ptr.is_mut = is_mut;
+    type_id id = dynarray_len(table->types);
+    memcpy(dynarray_add(table->types), entry, sizeof(TypeEntry));
+    dynarray_push(table->hashes, &hash);
+    table->slots[slot] = id;
 
-    TypeEntry* to_entry = &table->types[to];
-    if (is_mut) {
-        to_entry->parent_ptr_mut = new;
-    } else {
-        to_entry->parent_ptr = new;
+    // keep the load factor under a half
+    if (dynarray_len(table->types) * 2 > table->capacity) {
+        grow(table);
     }
 
-    return new;
+    return id;
 }
 
-type_id typetable_new_int(TypeTable* table, usize bits, bool is_signed) {
-    type_id new = typetable_new_type(table, TypeEntryKind_Int, bits);
+static TypeEntry new_entry(TypeEntryKind kind, usize bits) {
+    TypeEntry entry;
+    memset(&entry, 0, sizeof(TypeEntry));
+    entry.kind = kind;
+    entry.bits = bits;
+    return entry;
+}
+
+void typetable_init(TypeTable* table) {
+    table->types = dynarray_init();
+    table->hashes = dynarray_init();
+    table->capacity = TYPETABLE_INITIAL_CAPACITY;
+    table->slots = calloc(table->capacity, sizeof(type_id));
+    table->frozen = false;
+
+    // type_id = 0 is invalid, it's never looked up
+    TypeEntry invalid = new_entry(TypeEntryKind_Invalid, 0);
+    u32 no_hash = 0;
+    memcpy(dynarray_add(table->types), &invalid, sizeof(TypeEntry));
+    dynarray_push(table->hashes, &no_hash);
+}
+
+void typetable_deinit(TypeTable* table) {
+    dynarray_deinit(table->types);
+    dynarray_deinit(table->hashes);
+    free(table->slots);
+}
 
-    TypeEntry* new_entry = &table->types[new];
-    new_entry->integral.is_signed = is_signed;
+type_id typetable_new_type(TypeTable* table, TypeEntryKind kind, usize bits) {
+    TypeEntry entry = new_entry(kind, bits);
+    return intern_entry(table, &entry);
+}
 
-    return new;
+type_id typetable_new_ptr(TypeTable* table, type_id to, bool is_mut) {
+    TypeEntry entry = new_entry(TypeEntryKind_Ptr, 64);
+    entry.ptr.to = to;
+    entry.ptr.is_mut = is_mut;
+    return intern_entry(table, &entry);
+}
+
+type_id typetable_new_int(TypeTable* table, usize bits, bool is_signed) {
+    TypeEntry entry = new_entry(TypeEntryKind_Int, bits);
+    entry.integral.is_signed = is_signed;
+    return intern_entry(table, &entry);
 }
 
 type_id typetable_new_size(TypeTable* table, bool is_signed) {
-    type_id new = typetable_new_type(table, TypeEntryKind_Size, 64);
+    TypeEntry entry = new_entry(TypeEntryKind_Size, 64);
+    entry.integral.is_signed = is_signed;
+    return intern_entry(table, &entry);
+}
 
-    TypeEntry* new_entry = &table->types[new];
-    new_entry->integral.is_signed = is_signed;
+type_id typetable_new_fn(TypeTable* table, type_id* parameters, usize count, type_id returns) {
+    // built from the last parameter back, each one points at the rest
+    type_id next = 0;
+    for (usize i = count; i > 0; i -= 1) {
+        TypeEntry entry = new_entry(TypeEntryKind_FnParam, 0);
+        entry.fn_param.type = parameters[i - 1];
+        entry.fn_param.next = next;
+        next = intern_entry(table, &entry);
+    }
 
-    return new;
+    TypeEntry entry = new_entry(TypeEntryKind_Fn, 64);
+    entry.fn.parameters = next;
+    entry.fn.returns = returns;
+    return intern_entry(table, &entry);
 }
 
-TypeEntry typetable_get(TypeTable* table, type_id id) {
-    return table->types[id];
+usize typetable_count(TypeTable* table) {
+    return dynarray_len(table->types);
 }
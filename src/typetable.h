@@ -5,7 +5,9 @@
 #include <stdbool.h>
 
 
-typedef usize type_id;
+// types are hash consed: a type is only ever added once, so two types are
+// the same exactly when their ids are. type_id = 0 is invalid.
+typedef u32 type_id;
 
 typedef struct TypeEntry TypeEntry;
 typedef enum TypeEntryKind {
@@ -16,6 +18,9 @@ typedef enum TypeEntryKind {
     TypeEntryKind_Int,
     TypeEntryKind_Size,
     TypeEntryKind_Bool,
+    TypeEntryKind_Fn,
+    // one parameter of a fn type, never the type of anything
+    TypeEntryKind_FnParam,
 } TypeEntryKind;
 
 typedef struct TypePtr {
@@ -27,31 +32,66 @@ typedef struct TypeIntegral {
     bool is_signed;
 } TypeIntegral;
 
+typedef struct TypeFn {
+    // the first TypeFnParam, 0 when there are none
+    type_id parameters;
+    type_id returns;
+} TypeFn;
+
+// the parameters of a fn type are a list of entries of their own, so fn
+// types with the same parameters share them
+typedef struct TypeFnParam {
+    type_id type;
+    // 0 on the last one
+    type_id next;
+} TypeFnParam;
+
+// an entry is its own key, every byte of it (padding too) takes part in the
+// hash and the compare. types made of a list of others (fns, structs) should
+// keep the list out of the entry and point at it, so entries stay small.
 typedef struct TypeEntry {
-    TypeEntryKind kind;
-    size_t bits;
-    type_id parent_ptr_mut;
-    type_id parent_ptr;
+    // a TypeEntryKind
+    u8 kind;
+    u16 bits;
 
     union {
         TypePtr ptr;
         TypeIntegral integral;
+        TypeFn fn;
+        TypeFnParam fn_param;
     };
 } TypeEntry;
 
 typedef struct TypeTable {
+    // indexed by type_id
     DynArray(TypeEntry) types;
+    DynArray(u32) hashes;
+
+    // open addressing, each slot holds a type_id or 0
+    type_id* slots;
+    usize capacity;
+
+    // set on copies shared between threads, which may only find types that
+    // are already there
+    bool frozen;
 } TypeTable;
 
 
 void typetable_init(TypeTable* table);
 void typetable_deinit(TypeTable* table);
 
-type_id typetable_new_type(TypeTable* table, TypeEntryKind kind, size_t bits);
+// each of these returns the id the type already has, if it has one
+type_id typetable_new_type(TypeTable* table, TypeEntryKind kind, usize bits);
 type_id typetable_new_ptr(TypeTable* table, type_id to, bool is_mut);
 type_id typetable_new_int(TypeTable* table, usize bits, bool is_signed);
 type_id typetable_new_size(TypeTable* table, bool is_signed);
+type_id typetable_new_fn(TypeTable* table, type_id* parameters, usize count, type_id returns);
+
+usize typetable_count(TypeTable* table);
 
-TypeEntry typetable_get(TypeTable* table, type_id id);
+// good until the next type is added
+static inline TypeEntry* typetable_get(TypeTable* table, type_id id) {
+    return &table->types[id];
+}
 
 #endif
@@ -4,9 +4,30 @@
 #include <stdarg.h>
 #include <stdlib.h>
 
+static _Thread_local PanicCatch* panic_catch = 0;
+
+void sil_catch_panics(PanicCatch* catch) {
+    panic_catch = catch;
+}
 
 void sil_panic(const char* format, ...) {
     va_list args;
+    if (panic_catch != 0) {
+        va_start(args, format);
+        int len = vsnprintf(0, 0, format, args);
+        va_end(args);
+
+        char* message = malloc((size_t)len + 1);
+        va_start(args, format);
+        vsnprintf(message, (size_t)len + 1, format, args);
+        va_end(args);
+
+        PanicCatch* catch = panic_catch;
+        panic_catch = 0;
+        catch->message = message;
+        longjmp(catch->jump, 1);
+    }
+
     va_start(args, format);
     vfprintf(stderr, format, args);
     fprintf(stderr, "\n");
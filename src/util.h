@@ -1,6 +1,8 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <setjmp.h>
+
 #define RESET   "\033[0m"
 #define BLACK   "\033[30m"      /* Black */
 #define RED     "\033[31m"      /* Red */
@@ -25,6 +27,16 @@ void sil_panic(const char* format, ...)
     __attribute__((format(printf, 1, 2)))
     __attribute__((noreturn));
 
+// lets a thread outlive its own panics. while a catch is set (per thread)
+// sil_panic keeps the message in it and longjmps to jump instead of exiting.
+typedef struct PanicCatch {
+    jmp_buf jump;
+    // malloced, null until a panic
+    char* message;
+} PanicCatch;
+
+void sil_catch_panics(PanicCatch* catch);
+
 #endif // !UTIL_H
 
 